@@ -0,0 +1,270 @@
+/*
+ * Vulkan Samples
+ *
+ * Copyright (C) 2015-2020 Valve Corporation
+ * Copyright (C) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+VULKAN_SAMPLE_SHORT_DESCRIPTION
+Draw many frames and capture every one without waiting for the readback.
+*/
+
+/* This sample draws the cube of 15-draw_cube for FRAME_COUNT frames, with */
+/* two frames in flight.  With --save-images, each frame's command buffer  */
+/* also copies the swapchain image into a slot of a capture ring; a        */
+/* background thread writes capture_frames-NNN.ppm once the slot's fence   */
+/* signals, so the frame loop never waits on a readback.                   */
+
+#include <util_init.hpp>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <cstdlib>
+#include "cube_data.h"
+
+#define FRAME_COUNT 120
+#define FRAMES_IN_FLIGHT 2
+#define CAPTURE_SLOTS 4
+
+int sample_main(int argc, char *argv[]) {
+    VkResult U_ASSERT_ONLY res;
+    struct sample_info info = {};
+    char sample_title[] = "Capture Frames";
+    const bool depthPresent = true;
+
+    process_command_line_args(info, argc, argv);
+    init_global_layer_properties(info);
+    init_instance_extension_names(info);
+    init_device_extension_names(info);
+    init_instance(info, sample_title);
+    init_enumerate_device(info);
+    init_window_size(info, 500, 500);
+    init_connection(info);
+    init_window(info);
+    init_swapchain_extension(info);
+    init_device(info);
+
+    init_command_pool(info);
+    init_command_buffer(info);
+    execute_begin_command_buffer(info);
+    init_device_queue(info);
+    init_swap_chain(info);
+    init_depth_buffer(info);
+    init_uniform_buffer(info);
+    init_descriptor_and_pipeline_layouts(info, false);
+    init_renderpass(info, depthPresent);
+#include "capture_frames.vert.h"
+#include "capture_frames.frag.h"
+    VkShaderModuleCreateInfo vert_info = {};
+    VkShaderModuleCreateInfo frag_info = {};
+    vert_info.sType = frag_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    vert_info.codeSize = sizeof(capture_frames_vert);
+    vert_info.pCode = capture_frames_vert;
+    frag_info.codeSize = sizeof(capture_frames_frag);
+    frag_info.pCode = capture_frames_frag;
+    init_shaders(info, &vert_info, &frag_info);
+    init_framebuffers(info, depthPresent);
+    init_vertex_buffer(info, g_vb_solid_face_colors_Data, sizeof(g_vb_solid_face_colors_Data),
+                       sizeof(g_vb_solid_face_colors_Data[0]), false);
+    init_descriptor_pool(info, false);
+    init_descriptor_set(info, false);
+    init_pipeline_cache(info);
+    init_pipeline(info, depthPresent);
+
+    /* Fill in info.viewport and info.scissor for the frames below, and run
+     * the setup commands recorded so far */
+    init_viewports(info);
+    init_scissors(info);
+    execute_end_command_buffer(info);
+    execute_queue_command_buffer(info);
+
+    /* VULKAN_KEY_START */
+
+    capture_ring *ring = NULL;
+    if (info.save_images) ring = init_capture_ring(info, CAPTURE_SLOTS);
+
+    /* Each frame in flight has its own command buffer, semaphores and fence */
+    VkCommandBuffer frame_cmds[FRAMES_IN_FLIGHT];
+    VkCommandBufferAllocateInfo cmd_alloc = {};
+    cmd_alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmd_alloc.pNext = NULL;
+    cmd_alloc.commandPool = info.cmd_pool;
+    cmd_alloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_alloc.commandBufferCount = FRAMES_IN_FLIGHT;
+    res = vkAllocateCommandBuffers(info.device, &cmd_alloc, frame_cmds);
+    assert(res == VK_SUCCESS);
+
+    VkSemaphore imageAcquiredSemaphores[FRAMES_IN_FLIGHT];
+    VkSemaphore drawCompleteSemaphores[FRAMES_IN_FLIGHT];
+    VkFence drawFences[FRAMES_IN_FLIGHT];
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+        VkSemaphoreCreateInfo semaphoreCreateInfo;
+        semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreCreateInfo.pNext = NULL;
+        semaphoreCreateInfo.flags = 0;
+        res = vkCreateSemaphore(info.device, &semaphoreCreateInfo, NULL, &imageAcquiredSemaphores[i]);
+        assert(res == VK_SUCCESS);
+        res = vkCreateSemaphore(info.device, &semaphoreCreateInfo, NULL, &drawCompleteSemaphores[i]);
+        assert(res == VK_SUCCESS);
+
+        /* Signaled, so the first wait on each one returns at once */
+        VkFenceCreateInfo fenceInfo;
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.pNext = NULL;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        res = vkCreateFence(info.device, &fenceInfo, NULL, &drawFences[i]);
+        assert(res == VK_SUCCESS);
+    }
+
+    for (uint32_t frame = 0; frame < FRAME_COUNT; frame++) {
+        const uint32_t f = frame % FRAMES_IN_FLIGHT;
+        VkCommandBuffer cmd = frame_cmds[f];
+
+        /* Wait for the frame that last used these objects.  Captures are
+         * waited for by the capture ring's own thread, never here. */
+        do {
+            res = vkWaitForFences(info.device, 1, &drawFences[f], VK_TRUE, FENCE_TIMEOUT);
+        } while (res == VK_TIMEOUT);
+        assert(res == VK_SUCCESS);
+        res = vkResetFences(info.device, 1, &drawFences[f]);
+        assert(res == VK_SUCCESS);
+
+        res = vkAcquireNextImageKHR(info.device, info.swap_chain, UINT64_MAX, imageAcquiredSemaphores[f], VK_NULL_HANDLE,
+                                    &info.current_buffer);
+        // TODO: Deal with the VK_SUBOPTIMAL_KHR and VK_ERROR_OUT_OF_DATE_KHR
+        // return codes
+        assert(res == VK_SUCCESS);
+
+        VkCommandBufferBeginInfo cmd_buf_info = {};
+        cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cmd_buf_info.pNext = NULL;
+        cmd_buf_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        cmd_buf_info.pInheritanceInfo = NULL;
+        res = vkBeginCommandBuffer(cmd, &cmd_buf_info);
+        assert(res == VK_SUCCESS);
+
+        /* Fade the background so that every captured frame differs */
+        const float fade = (float)frame / (FRAME_COUNT - 1);
+        VkClearValue clear_values[2];
+        clear_values[0].color.float32[0] = 0.2f;
+        clear_values[0].color.float32[1] = 0.2f + 0.6f * fade;
+        clear_values[0].color.float32[2] = 0.8f - 0.6f * fade;
+        clear_values[0].color.float32[3] = 1.0f;
+        clear_values[1].depthStencil.depth = 1.0f;
+        clear_values[1].depthStencil.stencil = 0;
+
+        VkRenderPassBeginInfo rp_begin;
+        rp_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        rp_begin.pNext = NULL;
+        rp_begin.renderPass = info.render_pass;
+        rp_begin.framebuffer = info.framebuffers[info.current_buffer];
+        rp_begin.renderArea.offset.x = 0;
+        rp_begin.renderArea.offset.y = 0;
+        rp_begin.renderArea.extent.width = info.width;
+        rp_begin.renderArea.extent.height = info.height;
+        rp_begin.clearValueCount = 2;
+        rp_begin.pClearValues = clear_values;
+
+        vkCmdBeginRenderPass(cmd, &rp_begin, VK_SUBPASS_CONTENTS_INLINE);
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, info.pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, info.pipeline_layout, 0, NUM_DESCRIPTOR_SETS,
+                                info.desc_set.data(), 0, NULL);
+
+        const VkDeviceSize offsets[1] = {0};
+        vkCmdBindVertexBuffers(cmd, 0, 1, &info.vertex_buffer.buf, offsets);
+
+        vkCmdSetViewport(cmd, 0, NUM_VIEWPORTS, &info.viewport);
+        vkCmdSetScissor(cmd, 0, NUM_SCISSORS, &info.scissor);
+
+        vkCmdDraw(cmd, 12 * 3, 1, 0, 0);
+        vkCmdEndRenderPass(cmd);
+
+        /* Copy the finished image into a free slot of the ring; the frame
+         * is dropped from the capture when every slot is still busy */
+        if (ring) {
+            char basename[64];
+            snprintf(basename, sizeof(basename), "capture_frames-%03u", frame);
+            cmd_capture_image(ring, cmd, info.buffers[info.current_buffer].image, basename);
+        }
+
+        res = vkEndCommandBuffer(cmd);
+        assert(res == VK_SUCCESS);
+
+        VkPipelineStageFlags pipe_stage_flags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        VkSubmitInfo submit_info[1] = {};
+        submit_info[0].pNext = NULL;
+        submit_info[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info[0].waitSemaphoreCount = 1;
+        submit_info[0].pWaitSemaphores = &imageAcquiredSemaphores[f];
+        submit_info[0].pWaitDstStageMask = &pipe_stage_flags;
+        submit_info[0].commandBufferCount = 1;
+        submit_info[0].pCommandBuffers = &cmd;
+        submit_info[0].signalSemaphoreCount = 1;
+        submit_info[0].pSignalSemaphores = &drawCompleteSemaphores[f];
+
+        res = vkQueueSubmit(info.graphics_queue, 1, submit_info, drawFences[f]);
+        assert(res == VK_SUCCESS);
+
+        /* Hand the slot to the encoder thread behind a fence of its own */
+        if (ring) submit_capture(ring, info.graphics_queue);
+
+        VkPresentInfoKHR present;
+        present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present.pNext = NULL;
+        present.swapchainCount = 1;
+        present.pSwapchains = &info.swap_chain;
+        present.pImageIndices = &info.current_buffer;
+        present.pWaitSemaphores = &drawCompleteSemaphores[f];
+        present.waitSemaphoreCount = 1;
+        present.pResults = NULL;
+
+        res = vkQueuePresentKHR(info.present_queue, &present);
+        assert(res == VK_SUCCESS);
+    }
+
+    /* Only at the end; destroy_capture_ring then waits for the encoder to
+     * write the captures still queued */
+    res = vkDeviceWaitIdle(info.device);
+    assert(res == VK_SUCCESS);
+    destroy_capture_ring(ring);
+
+    /* VULKAN_KEY_END */
+
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+        vkDestroySemaphore(info.device, imageAcquiredSemaphores[i], NULL);
+        vkDestroySemaphore(info.device, drawCompleteSemaphores[i], NULL);
+        vkDestroyFence(info.device, drawFences[i], NULL);
+    }
+    vkFreeCommandBuffers(info.device, info.cmd_pool, FRAMES_IN_FLIGHT, frame_cmds);
+    destroy_pipeline(info);
+    destroy_pipeline_cache(info);
+    destroy_descriptor_pool(info);
+    destroy_vertex_buffer(info);
+    destroy_framebuffers(info);
+    destroy_shaders(info);
+    destroy_renderpass(info);
+    destroy_descriptor_and_pipeline_layouts(info);
+    destroy_uniform_buffer(info);
+    destroy_depth_buffer(info);
+    destroy_swap_chain(info);
+    destroy_command_buffer(info);
+    destroy_command_pool(info);
+    destroy_device(info);
+    destroy_window(info);
+    destroy_instance(info);
+    return 0;
+}
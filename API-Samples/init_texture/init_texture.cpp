@@ -74,10 +74,15 @@ int sample_main(int argc, char *argv[]) {
     }
 #endif
 
-    if (!read_ppm(filename.c_str(), texObj.tex_width, texObj.tex_height, 0, NULL)) {
+    /* Map the file and parse its header; the pixels are copied once we know
+     * where they go */
+    ppm_file ppm;
+    if (!open_ppm(filename.c_str(), ppm)) {
         std::cout << "Could not read texture file lunarg.ppm\n";
         exit(-1);
     }
+    texObj.tex_width = ppm.width;
+    texObj.tex_height = ppm.height;
 
     VkFormatProperties formatProps;
     vkGetPhysicalDeviceFormatProperties(info.gpus[0], VK_FORMAT_R8G8B8A8_UNORM, &formatProps);
@@ -190,12 +195,9 @@ int sample_main(int argc, char *argv[]) {
     res = vkMapMemory(info.device, mapped_memory, 0, mem_reqs.size, 0, &data);
     assert(res == VK_SUCCESS);
 
-    /* Read the ppm file into the mappable image's memory */
-    if (!read_ppm(filename.c_str(), texObj.tex_width, texObj.tex_height,
-                  texObj.needs_staging ? (texObj.tex_width * 4) : layout.rowPitch, (unsigned char *)data)) {
-        std::cout << "Could not load texture file lunarg.ppm\n";
-        exit(-1);
-    }
+    /* Copy the ppm pixels into the mappable image's memory */
+    copy_ppm_rgba(ppm, texObj.needs_staging ? (texObj.tex_width * 4) : layout.rowPitch, (unsigned char *)data);
+    close_ppm(ppm);
 
     vkUnmapMemory(info.device, mapped_memory);
 
@@ -81,6 +81,7 @@ do
     fi
     if test -z $SAVEIMAGES; then
         rm ${RNAME}.ppm > /dev/null 2>&1
+        rm ${RNAME}-[0-9]*.ppm > /dev/null 2>&1
 	    rm ${RNAME}-diff.ppm > /dev/null 2>&1
     fi
 done
@@ -78,11 +78,14 @@ int sample_main(int argc, char *argv[]) {
     // we have to set up a couple of things by hand, but this
     // isn't any different to other examples
 
-    // get two different textures
-    init_texture(info, "green.ppm");
+    // get two different textures, loaded together
+    const std::vector<const char *> textureNames = {"green.ppm", "lunarg.ppm"};
+    init_textures(info, textureNames);
+
     VkDescriptorImageInfo greenTex = info.texture_data.image_info;
+    greenTex.imageView = info.textures[0].view;
+    greenTex.sampler = info.textures[0].sampler;
 
-    init_texture(info, "lunarg.ppm");
     VkDescriptorImageInfo lunargTex = info.texture_data.image_info;
 
     // create two identical descriptor sets, each with a different texture but
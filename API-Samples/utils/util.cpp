@@ -24,13 +24,19 @@ samples utility functions
 */
 
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <cstdlib>
 #include <iomanip>
 #include <fstream>
 #include <iostream>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include "util.hpp"
 
 #ifdef __ANDROID__
@@ -54,6 +60,14 @@ static android_app *Android_application = nullptr;
 #include <sys/time.h>
 #endif
 
+// For mapping files
+#if !defined(_WIN32) && !defined(__ANDROID__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 
 #if !(defined(__ANDROID__) || defined(VK_USE_PLATFORM_METAL_EXT))
@@ -191,83 +205,319 @@ void set_image_layout(struct sample_info &info, VkImage image, VkImageAspectFlag
     vkCmdPipelineBarrier(info.cmd, src_stages, dest_stages, 0, 0, NULL, 0, NULL, 1, &image_memory_barrier);
 }
 
-bool read_ppm(char const *const filename, int &width, int &height, uint64_t rowPitch, unsigned char *dataPtr) {
-    // PPM format expected from http://netpbm.sourceforge.net/doc/ppm.html
-    //  1. magic number
-    //  2. whitespace
-    //  3. width
-    //  4. whitespace
-    //  5. height
-    //  6. whitespace
-    //  7. max color value
-    //  8. whitespace
-    //  7. data
+// Map a whole file for reading.  Android assets cannot be mapped and are
+// read into a heap buffer instead.
+static bool map_file(char const *const filename, const unsigned char *&data, size_t &size) {
+#if defined(__ANDROID__)
+    FILE *fPtr = AndroidFopen(filename, "rb");
+    if (!fPtr) return false;
 
-    // Comments are not supported, but are detected and we kick out
-    // Only 8 bits per channel is supported
-    // If dataPtr is nullptr, only width and height are returned
+    std::vector<unsigned char> contents;
+    unsigned char buf[65536];
+    size_t count;
+    while ((count = fread(buf, 1, sizeof(buf), fPtr)) > 0) contents.insert(contents.end(), buf, buf + count);
+    fclose(fPtr);
+    if (contents.empty()) return false;
 
-    // Read in values from the PPM file as characters to check for comments
-    char magicStr[3] = {}, heightStr[6] = {}, widthStr[6] = {}, formatStr[6] = {};
+    unsigned char *copy = (unsigned char *)malloc(contents.size());
+    if (!copy) return false;
+    memcpy(copy, contents.data(), contents.size());
 
-#ifndef __ANDROID__
-    FILE *fPtr = fopen(filename, "rb");
+    data = copy;
+    size = contents.size();
+    return true;
+#elif defined(_WIN32)
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // the view keeps the mapping alive
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return false;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) return false;
+
+    data = (const unsigned char *)view;
+    size = (size_t)fileSize.QuadPart;
+    return true;
 #else
-    FILE *fPtr = AndroidFopen(filename, "rb");
-#endif
-    if (!fPtr) {
-        printf("Bad filename in read_ppm: %s\n", filename);
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
         return false;
     }
 
-    // Read the four values from file, accounting with any and all whitepace
-    int U_ASSERT_ONLY count = fscanf(fPtr, "%s %s %s %s ", magicStr, widthStr, heightStr, formatStr);
-    assert(count == 4);
+    void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+
+    // the pixels are read once, front to back
+    madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
 
-    // Kick out if comments present
-    if (magicStr[0] == '#' || widthStr[0] == '#' || heightStr[0] == '#' || formatStr[0] == '#') {
-        printf("Unhandled comment in PPM file\n");
+    data = (const unsigned char *)view;
+    size = (size_t)st.st_size;
+    return true;
+#endif
+}
+
+static void unmap_file(const unsigned char *data, size_t size) {
+#if defined(__ANDROID__)
+    free((void *)data);
+#elif defined(_WIN32)
+    UnmapViewOfFile(data);
+#else
+    munmap((void *)data, size);
+#endif
+}
+
+// Skip whitespace and comments, then read a decimal number.  Returns the
+// position after the number, or NULL.
+static const unsigned char *read_ppm_number(const unsigned char *pos, const unsigned char *end, int &value) {
+    while (pos < end) {
+        if (*pos == '#') {
+            while (pos < end && *pos != '\n' && *pos != '\r') pos++;
+        } else if (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r' || *pos == '\v' || *pos == '\f') {
+            pos++;
+        } else {
+            break;
+        }
+    }
+
+    if (pos == end || *pos < '0' || *pos > '9') return NULL;
+
+    int64_t val = 0;
+    while (pos < end && *pos >= '0' && *pos <= '9') {
+        val = val * 10 + (*pos++ - '0');
+        if (val > INT32_MAX) return NULL;
+    }
+
+    value = (int)val;
+    return pos;
+}
+
+bool open_ppm(char const *const filename, ppm_file &ppm) {
+    // PPM format expected from http://netpbm.sourceforge.net/doc/ppm.html
+    //  1. magic number
+    //  2. whitespace and comments
+    //  3. width
+    //  4. whitespace and comments
+    //  5. height
+    //  6. whitespace and comments
+    //  7. max color value, below 65536
+    //  8. a single whitespace character
+    //  9. data, with 2 big endian bytes per sample when maxval > 255
+    ppm = ppm_file();
+
+    if (!map_file(filename, ppm.file_data, ppm.file_size)) {
+        printf("Bad filename in read_ppm: %s\n", filename);
         return false;
     }
 
+    const unsigned char *end = ppm.file_data + ppm.file_size;
+    const unsigned char *pos = ppm.file_data;
+
     // Only one magic value is valid
-    if (strncmp(magicStr, "P6", sizeof(magicStr))) {
-        printf("Unhandled PPM magic number: %s\n", magicStr);
+    if (ppm.file_size < 2 || pos[0] != 'P' || pos[1] != '6') {
+        printf("Unhandled PPM magic number in %s\n", filename);
+        close_ppm(ppm);
         return false;
     }
-
-    width = atoi(widthStr);
-    height = atoi(heightStr);
+    pos += 2;
+
+    pos = read_ppm_number(pos, end, ppm.width);
+    if (pos) pos = read_ppm_number(pos, end, ppm.height);
+    if (pos) pos = read_ppm_number(pos, end, ppm.maxval);
+    if (!pos || pos == end) {
+        printf("Truncated PPM header in %s\n", filename);
+        close_ppm(ppm);
+        return false;
+    }
+    // exactly one whitespace character separates maxval from the data
+    if (!isspace(*pos)) {
+        printf("Bad PPM header in %s: no whitespace after max color value\n", filename);
+        close_ppm(ppm);
+        return false;
+    }
+    pos++;
 
     // Ensure we got something sane for width/height
     static const int saneDimension = 32768;  //??
-    if (width <= 0 || width > saneDimension) {
-        printf("Width seems wrong.  Update read_ppm if not: %u\n", width);
+    if (ppm.width <= 0 || ppm.width > saneDimension || ppm.height <= 0 || ppm.height > saneDimension) {
+        printf("Dimensions seem wrong.  Update read_ppm if not: %d x %d\n", ppm.width, ppm.height);
+        close_ppm(ppm);
         return false;
     }
-    if (height <= 0 || height > saneDimension) {
-        printf("Height seems wrong.  Update read_ppm if not: %u\n", height);
+    if (ppm.maxval <= 0 || ppm.maxval > 65535) {
+        printf("Unhandled PPM max color value: %d\n", ppm.maxval);
+        close_ppm(ppm);
         return false;
     }
 
-    if (dataPtr == nullptr) {
-        // If no destination pointer, caller only wanted dimensions
-        return true;
+    const size_t sampleSize = (ppm.maxval > 255) ? 2 : 1;
+    if ((size_t)(end - pos) < sampleSize * 3 * ppm.width * ppm.height) {
+        printf("Truncated PPM data in %s\n", filename);
+        close_ppm(ppm);
+        return false;
     }
 
-    // Now read the data
-    for (int y = 0; y < height; y++) {
-        unsigned char *rowPtr = dataPtr;
-        for (int x = 0; x < width; x++) {
-            count = fread(rowPtr, 3, 1, fPtr);
-            assert(count == 1);
-            rowPtr[3] = 255; /* Alpha of 1 */
-            rowPtr += 4;
+    ppm.pixels = pos;
+    return true;
+}
+
+void close_ppm(ppm_file &ppm) {
+    if (ppm.file_data) unmap_file(ppm.file_data, ppm.file_size);
+    ppm = ppm_file();
+}
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define UTIL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC compiles intrinsics for any instruction set
+#define UTIL_TARGET(isa)
+#else
+#define UTIL_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+enum simd_level { SIMD_NONE, SIMD_SSSE3, SIMD_AVX2 };
+
+static simd_level detect_simd_level() {
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    const int maxLeaf = regs[0];
+
+    __cpuid(regs, 1);
+    const bool ssse3 = (regs[2] & (1 << 9)) != 0;
+    // AVX state must be enabled by the OS
+    const bool osAvx = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osAvx) {
+        __cpuidex(regs, 7, 0);
+        avx2 = (regs[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    const bool ssse3 = __builtin_cpu_supports("ssse3");
+    const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    return avx2 ? SIMD_AVX2 : ssse3 ? SIMD_SSSE3 : SIMD_NONE;
+}
+
+static simd_level get_simd_level() {
+    static const simd_level level = detect_simd_level();
+    return level;
+}
+
+// Each expands count pixels and returns how many it did; the rest are left
+// to the scalar loop.  They read at most 3 * count bytes.
+UTIL_TARGET("ssse3") static int expand_rgb_ssse3(const unsigned char *src, unsigned char *dst, int count) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+
+    // a 16 byte load covers 4 pixels and a third
+    int x = 0;
+    for (; x + 6 <= count; x += 4) {
+        const __m128i rgb = _mm_loadu_si128((const __m128i *)(src + 3 * x));
+        _mm_storeu_si128((__m128i *)(dst + 4 * x), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+    }
+
+    return x;
+}
+
+UTIL_TARGET("avx2") static int expand_rgb_avx2(const unsigned char *src, unsigned char *dst, int count) {
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,  //
+                                             0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+
+    // 4 pixels per lane; the upper load ends 4 bytes past the 8th pixel
+    int x = 0;
+    for (; x + 10 <= count; x += 8) {
+        const __m128i lo = _mm_loadu_si128((const __m128i *)(src + 3 * x));
+        const __m128i hi = _mm_loadu_si128((const __m128i *)(src + 3 * x + 12));
+        const __m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_si256((__m256i *)(dst + 4 * x), _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha));
+    }
+
+    return x;
+}
+#endif  // x86
+
+void copy_ppm_rgba(const ppm_file &ppm, uint64_t rowPitch, unsigned char *dataPtr) {
+    const unsigned char *src = ppm.pixels;
+
+    if (ppm.maxval != 255) {
+        // rescale through a table; rare enough not to bother with SIMD
+        std::vector<unsigned char> scale(ppm.maxval + 1);
+        for (int v = 0; v <= ppm.maxval; v++) scale[v] = (unsigned char)((v * 255 + ppm.maxval / 2) / ppm.maxval);
+
+        const bool wide = (ppm.maxval > 255);
+        for (int y = 0; y < ppm.height; y++) {
+            unsigned char *rowPtr = dataPtr + rowPitch * y;
+            for (int x = 0; x < ppm.width; x++) {
+                for (int c = 0; c < 3; c++) {
+                    int v = wide ? ((src[0] << 8) | src[1]) : src[0];
+                    src += wide ? 2 : 1;
+                    // out of range samples are clamped
+                    rowPtr[c] = scale[v > ppm.maxval ? ppm.maxval : v];
+                }
+                rowPtr[3] = 255; /* Alpha of 1 */
+                rowPtr += 4;
+            }
         }
-        dataPtr += rowPitch;
+        return;
     }
-    fclose(fPtr);
 
+#ifdef UTIL_X86
+    const simd_level level = get_simd_level();
+#endif
+
+    for (int y = 0; y < ppm.height; y++) {
+        unsigned char *rowPtr = dataPtr + rowPitch * y;
+        int x = 0;
+
+#ifdef UTIL_X86
+        if (level == SIMD_AVX2)
+            x = expand_rgb_avx2(src, rowPtr, ppm.width);
+        else if (level == SIMD_SSSE3)
+            x = expand_rgb_ssse3(src, rowPtr, ppm.width);
+#endif
+
+        for (; x < ppm.width; x++) {
+            rowPtr[4 * x + 0] = src[3 * x + 0];
+            rowPtr[4 * x + 1] = src[3 * x + 1];
+            rowPtr[4 * x + 2] = src[3 * x + 2];
+            rowPtr[4 * x + 3] = 255; /* Alpha of 1 */
+        }
+
+        src += 3 * ppm.width;
+    }
+}
+
+bool read_ppm(char const *const filename, int &width, int &height, uint64_t rowPitch, unsigned char *dataPtr) {
+    // If dataPtr is nullptr, only width and height are returned
+    ppm_file ppm;
+    if (!open_ppm(filename, ppm)) return false;
+
+    width = ppm.width;
+    height = ppm.height;
+    if (dataPtr) copy_ppm_rgba(ppm, rowPitch, dataPtr);
+
+    close_ppm(ppm);
     return true;
 }
 
@@ -386,11 +636,232 @@ void process_command_line_args(struct sample_info &info, int argc, char *argv[])
     }
 }
 
+// Row converters for write_ppm.  Each packs width pixels to RGB8.
+typedef void (*ppm_row_writer)(const unsigned char *src, unsigned char *dst, int width);
+
+#ifdef UTIL_X86
+// The vector loops store 16 or 32 bytes for 12 or 24 bytes of output, so
+// they stop early enough to stay within the row.
+UTIL_TARGET("ssse3") static int pack_rgb_ssse3(const unsigned char *src, unsigned char *dst, int width, bool swap) {
+    const __m128i shuffle = swap ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+                                 : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    int x = 0;
+    for (; x + 6 <= width; x += 4) {
+        const __m128i px = _mm_loadu_si128((const __m128i *)(src + 4 * x));
+        _mm_storeu_si128((__m128i *)(dst + 3 * x), _mm_shuffle_epi8(px, shuffle));
+    }
+
+    return x;
+}
+
+UTIL_TARGET("avx2") static int pack_rgb_avx2(const unsigned char *src, unsigned char *dst, int width, bool swap) {
+    // shuffle each lane to 12 bytes, then close the gap between the lanes
+    const __m256i lane_shuffle = _mm256_broadcastsi128_si256(
+        swap ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+             : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+    const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    int x = 0;
+    for (; x + 11 <= width; x += 8) {
+        const __m256i px = _mm256_loadu_si256((const __m256i *)(src + 4 * x));
+        const __m256i rgb = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(px, lane_shuffle), pack);
+        _mm256_storeu_si256((__m256i *)(dst + 3 * x), rgb);
+    }
+
+    return x;
+}
+
+// A2B10G10R10 to R8G8B8X8, keeping the top 8 bits of each channel
+UTIL_TARGET("ssse3") static inline __m128i unpack_a2b10g10r10(__m128i px) {
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i r = _mm_and_si128(_mm_srli_epi32(px, 2), mask);
+    const __m128i g = _mm_and_si128(_mm_srli_epi32(px, 12), mask);
+    const __m128i b = _mm_and_si128(_mm_srli_epi32(px, 22), mask);
+    return _mm_or_si128(r, _mm_or_si128(_mm_slli_epi32(g, 8), _mm_slli_epi32(b, 16)));
+}
+
+UTIL_TARGET("ssse3") static int pack_a2b10g10r10_ssse3(const unsigned char *src, unsigned char *dst, int width) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    int x = 0;
+    for (; x + 6 <= width; x += 4) {
+        const __m128i px = unpack_a2b10g10r10(_mm_loadu_si128((const __m128i *)(src + 4 * x)));
+        _mm_storeu_si128((__m128i *)(dst + 3 * x), _mm_shuffle_epi8(px, shuffle));
+    }
+
+    return x;
+}
+
+UTIL_TARGET("avx2") static int pack_a2b10g10r10_avx2(const unsigned char *src, unsigned char *dst, int width) {
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,  //
+                                             0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    int x = 0;
+    for (; x + 11 <= width; x += 8) {
+        const __m256i px = _mm256_loadu_si256((const __m256i *)(src + 4 * x));
+        const __m256i r = _mm256_and_si256(_mm256_srli_epi32(px, 2), mask);
+        const __m256i g = _mm256_and_si256(_mm256_srli_epi32(px, 12), mask);
+        const __m256i b = _mm256_and_si256(_mm256_srli_epi32(px, 22), mask);
+        const __m256i rgbx = _mm256_or_si256(r, _mm256_or_si256(_mm256_slli_epi32(g, 8), _mm256_slli_epi32(b, 16)));
+        const __m256i rgb = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(rgbx, shuffle), pack);
+        _mm256_storeu_si256((__m256i *)(dst + 3 * x), rgb);
+    }
+
+    return x;
+}
+#endif  // UTIL_X86
+
+static void write_row_bgra8(const unsigned char *src, unsigned char *dst, int width) {
+    int x = 0;
+#ifdef UTIL_X86
+    if (get_simd_level() == SIMD_AVX2)
+        x = pack_rgb_avx2(src, dst, width, true);
+    else if (get_simd_level() == SIMD_SSSE3)
+        x = pack_rgb_ssse3(src, dst, width, true);
+#endif
+
+    for (; x < width; x++) {
+        dst[3 * x + 0] = src[4 * x + 2];
+        dst[3 * x + 1] = src[4 * x + 1];
+        dst[3 * x + 2] = src[4 * x + 0];
+    }
+}
+
+static void write_row_rgba8(const unsigned char *src, unsigned char *dst, int width) {
+    int x = 0;
+#ifdef UTIL_X86
+    if (get_simd_level() == SIMD_AVX2)
+        x = pack_rgb_avx2(src, dst, width, false);
+    else if (get_simd_level() == SIMD_SSSE3)
+        x = pack_rgb_ssse3(src, dst, width, false);
+#endif
+
+    for (; x < width; x++) {
+        dst[3 * x + 0] = src[4 * x + 0];
+        dst[3 * x + 1] = src[4 * x + 1];
+        dst[3 * x + 2] = src[4 * x + 2];
+    }
+}
+
+static void write_row_a2b10g10r10(const unsigned char *src, unsigned char *dst, int width) {
+    int x = 0;
+#ifdef UTIL_X86
+    if (get_simd_level() == SIMD_AVX2)
+        x = pack_a2b10g10r10_avx2(src, dst, width);
+    else if (get_simd_level() == SIMD_SSSE3)
+        x = pack_a2b10g10r10_ssse3(src, dst, width);
+#endif
+
+    for (; x < width; x++) {
+        uint32_t px;
+        memcpy(&px, src + 4 * x, sizeof(px));
+        dst[3 * x + 0] = (px >> 2) & 0xff;
+        dst[3 * x + 1] = (px >> 12) & 0xff;
+        dst[3 * x + 2] = (px >> 22) & 0xff;
+    }
+}
+
+static float half_to_float(uint16_t h) {
+    const int exponent = (h >> 10) & 0x1f;
+    const int mantissa = h & 0x3ff;
+    const float sign = (h & 0x8000) ? -1.0f : 1.0f;
+
+    if (exponent == 0) return sign * ldexpf((float)mantissa, -24);
+    if (exponent == 31) return mantissa ? NAN : sign * INFINITY;
+    return sign * ldexpf((float)(mantissa | 0x400), exponent - 25);
+}
+
+// Every half maps to one output byte, so the tonemapping is a table lookup
+static std::vector<unsigned char> build_half_tonemap_table() {
+    std::vector<unsigned char> table(65536);
+    for (uint32_t h = 0; h < 65536; h++) {
+        float v = half_to_float((uint16_t)h);
+        if (!(v > 0.0f)) {
+            table[h] = 0;
+            continue;
+        }
+
+        // Reinhard, then the sRGB transfer function
+        v = isinf(v) ? 1.0f : v / (1.0f + v);
+        v = (v <= 0.0031308f) ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+        table[h] = (unsigned char)(v * 255.0f + 0.5f);
+    }
+
+    return table;
+}
+
+static const unsigned char *get_half_tonemap_table() {
+    static const std::vector<unsigned char> table = build_half_tonemap_table();
+    return table.data();
+}
+
+static void write_row_rgba16f(const unsigned char *src, unsigned char *dst, int width) {
+    const unsigned char *table = get_half_tonemap_table();
+
+    for (int x = 0; x < width; x++) {
+        uint16_t px[4];
+        memcpy(px, src + 8 * x, sizeof(px));
+        dst[3 * x + 0] = table[px[0]];
+        dst[3 * x + 1] = table[px[1]];
+        dst[3 * x + 2] = table[px[2]];
+    }
+}
+
+static ppm_row_writer get_ppm_row_writer(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            return write_row_bgra8;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            return write_row_rgba8;
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+            return write_row_a2b10g10r10;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return write_row_rgba16f;
+        default:
+            return NULL;
+    }
+}
+
+// Bytes per pixel of the formats get_ppm_row_writer accepts
+static uint32_t get_ppm_pixel_size(VkFormat format) { return (format == VK_FORMAT_R16G16B16A16_SFLOAT) ? 8 : 4; }
+
+// Convert the whole image after the header and write it at once
+static void write_ppm_file(const std::string &filename, ppm_row_writer write_row, int width, int height,
+                           const unsigned char *pixels, uint64_t rowPitch) {
+    std::ostringstream header;
+    header << "P6\n" << width << " " << height << "\n" << 255 << "\n";
+    const std::string headerStr = header.str();
+
+    const size_t rowSize = (size_t)width * 3;
+    std::vector<unsigned char> staging(headerStr.size() + rowSize * height);
+    memcpy(staging.data(), headerStr.data(), headerStr.size());
+
+    unsigned char *dataPtr = staging.data() + headerStr.size();
+    for (int y = 0; y < height; y++) {
+        write_row(pixels, dataPtr, width);
+        pixels += rowPitch;
+        dataPtr += rowSize;
+    }
+
+    ofstream file(filename.c_str(), ios::binary);
+    file.write((const char *)staging.data(), staging.size());
+}
+
 void write_ppm(struct sample_info &info, const char *basename) {
     string filename;
-    int x, y;
     VkResult res;
 
+    const ppm_row_writer write_row = get_ppm_row_writer(info.format);
+    if (!write_row) {
+        printf("Unrecognized image format - will not write image files\n");
+        return;
+    }
+
     VkImageCreateInfo image_create_info = {};
     image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     image_create_info.pNext = NULL;
@@ -529,40 +1000,286 @@ void write_ppm(struct sample_info &info, const char *basename) {
     assert(res == VK_SUCCESS);
 
     ptr += sr_layout.offset;
-    ofstream file(filename.c_str(), ios::binary);
+    write_ppm_file(filename, write_row, info.width, info.height, (const unsigned char *)ptr, sr_layout.rowPitch);
 
-    file << "P6\n";
-    file << info.width << " ";
-    file << info.height << "\n";
-    file << 255 << "\n";
+    vkUnmapMemory(info.device, mappableMemory);
+    vkDestroyImage(info.device, mappableImage, NULL);
+    vkFreeMemory(info.device, mappableMemory, NULL);
+}
 
-    for (y = 0; y < info.height; y++) {
-        const int *row = (const int *)ptr;
-        int swapped;
+struct capture_ring {
+    enum slot_state { SLOT_FREE, SLOT_RECORDED, SLOT_PENDING };
 
-        if (info.format == VK_FORMAT_B8G8R8A8_UNORM || info.format == VK_FORMAT_B8G8R8A8_SRGB) {
-            for (x = 0; x < info.width; x++) {
-                swapped = (*row & 0xff00ff00) | (*row & 0x000000ff) << 16 | (*row & 0x00ff0000) >> 16;
-                file.write((char *)&swapped, 3);
-                row++;
-            }
-        } else if (info.format == VK_FORMAT_R8G8B8A8_UNORM) {
-            for (x = 0; x < info.width; x++) {
-                file.write((char *)row, 3);
-                row++;
+    struct slot {
+        VkBuffer buffer;
+        VkDeviceMemory memory;
+        const unsigned char *pixels;
+        VkFence fence;
+        slot_state state;
+        std::string filename;
+    };
+
+    VkDevice device;
+    int width;
+    int height;
+    ppm_row_writer write_row;
+    uint32_t pixel_size;
+
+    std::vector<slot> slots;
+    uint32_t next_slot;
+    // the slot recorded since the last submit_capture, if any
+    int recorded_slot;
+    uint32_t captured;
+    uint32_t dropped;
+
+    std::thread encoder;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<uint32_t> pending;
+    bool quit;
+};
+
+static void capture_encoder_loop(capture_ring *ring) {
+    while (true) {
+        uint32_t index;
+        {
+            std::unique_lock<std::mutex> lock(ring->mutex);
+            ring->cond.wait(lock, [ring] { return ring->quit || !ring->pending.empty(); });
+            // drain the queue before quitting
+            if (ring->pending.empty()) return;
+            index = ring->pending.front();
+            ring->pending.pop_front();
+        }
+
+        capture_ring::slot &slot = ring->slots[index];
+
+        VkResult U_ASSERT_ONLY res;
+        do {
+            res = vkWaitForFences(ring->device, 1, &slot.fence, VK_TRUE, FENCE_TIMEOUT);
+        } while (res == VK_TIMEOUT);
+        assert(res == VK_SUCCESS);
+
+        write_ppm_file(slot.filename, ring->write_row, ring->width, ring->height, slot.pixels,
+                       (uint64_t)ring->width * ring->pixel_size);
+
+        res = vkResetFences(ring->device, 1, &slot.fence);
+        assert(res == VK_SUCCESS);
+
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        slot.state = capture_ring::SLOT_FREE;
+    }
+}
+
+capture_ring *init_capture_ring(struct sample_info &info, uint32_t slot_count) {
+    const ppm_row_writer write_row = get_ppm_row_writer(info.format);
+    if (!write_row) {
+        printf("Unrecognized image format - will not capture images\n");
+        return NULL;
+    }
+
+    VkResult U_ASSERT_ONLY res;
+    bool U_ASSERT_ONLY pass;
+
+    capture_ring *ring = new capture_ring();
+    ring->device = info.device;
+    ring->width = info.width;
+    ring->height = info.height;
+    ring->write_row = write_row;
+    ring->pixel_size = get_ppm_pixel_size(info.format);
+    ring->next_slot = 0;
+    ring->recorded_slot = -1;
+    ring->captured = 0;
+    ring->dropped = 0;
+    ring->quit = false;
+
+    /* Each slot is a buffer that stays mapped for its whole life */
+    ring->slots.resize(slot_count);
+    for (uint32_t i = 0; i < slot_count; i++) {
+        capture_ring::slot &slot = ring->slots[i];
+
+        VkBufferCreateInfo buf_info = {};
+        buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buf_info.pNext = NULL;
+        buf_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        buf_info.size = (VkDeviceSize)ring->width * ring->height * ring->pixel_size;
+        buf_info.queueFamilyIndexCount = 0;
+        buf_info.pQueueFamilyIndices = NULL;
+        buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        buf_info.flags = 0;
+        res = vkCreateBuffer(info.device, &buf_info, NULL, &slot.buffer);
+        assert(res == VK_SUCCESS);
+
+        VkMemoryRequirements mem_reqs;
+        vkGetBufferMemoryRequirements(info.device, slot.buffer, &mem_reqs);
+
+        VkMemoryAllocateInfo mem_alloc = {};
+        mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        mem_alloc.pNext = NULL;
+        mem_alloc.allocationSize = mem_reqs.size;
+
+        /* Prefer cached memory; the encoder reads every byte */
+        pass = memory_type_from_properties(
+            info, mem_reqs.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+            &mem_alloc.memoryTypeIndex);
+        if (!pass)
+            pass = memory_type_from_properties(info, mem_reqs.memoryTypeBits,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                               &mem_alloc.memoryTypeIndex);
+        assert(pass && "No mappable, coherent memory");
+
+        res = vkAllocateMemory(info.device, &mem_alloc, NULL, &slot.memory);
+        assert(res == VK_SUCCESS);
+
+        res = vkBindBufferMemory(info.device, slot.buffer, slot.memory, 0);
+        assert(res == VK_SUCCESS);
+
+        void *data;
+        res = vkMapMemory(info.device, slot.memory, 0, mem_reqs.size, 0, &data);
+        assert(res == VK_SUCCESS);
+        slot.pixels = (const unsigned char *)data;
+
+        VkFenceCreateInfo fenceInfo;
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.pNext = NULL;
+        fenceInfo.flags = 0;
+        res = vkCreateFence(info.device, &fenceInfo, NULL, &slot.fence);
+        assert(res == VK_SUCCESS);
+
+        slot.state = capture_ring::SLOT_FREE;
+    }
+
+    ring->encoder = std::thread(capture_encoder_loop, ring);
+
+    return ring;
+}
+
+bool cmd_capture_image(capture_ring *ring, VkCommandBuffer cmd, VkImage image, const char *basename) {
+    assert(ring->recorded_slot < 0 && "submit_capture was not called after the last capture");
+
+    /* Never wait for the encoder; drop the frame if every slot is busy */
+    int index = -1;
+    {
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        for (uint32_t i = 0; i < ring->slots.size(); i++) {
+            const uint32_t candidate = (ring->next_slot + i) % ring->slots.size();
+            if (ring->slots[candidate].state == capture_ring::SLOT_FREE) {
+                index = candidate;
+                break;
             }
-        } else {
-            printf("Unrecognized image format - will not write image files");
-            break;
         }
+        if (index < 0) {
+            ring->dropped++;
+            return false;
+        }
+        ring->slots[index].state = capture_ring::SLOT_RECORDED;
+    }
+
+    capture_ring::slot &slot = ring->slots[index];
+    slot.filename = basename;
+    slot.filename.append(".ppm");
+    ring->next_slot = (index + 1) % ring->slots.size();
+    ring->recorded_slot = index;
+
+    /* The image is expected to be ready for presenting, and is left that way */
+    VkImageMemoryBarrier image_barrier = {};
+    image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    image_barrier.pNext = NULL;
+    image_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.image = image;
+    image_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_barrier.subresourceRange.baseMipLevel = 0;
+    image_barrier.subresourceRange.levelCount = 1;
+    image_barrier.subresourceRange.baseArrayLayer = 0;
+    image_barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         1, &image_barrier);
+
+    VkBufferImageCopy copy_region = {};
+    copy_region.bufferOffset = 0;
+    copy_region.bufferRowLength = 0;
+    copy_region.bufferImageHeight = 0;
+    copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy_region.imageSubresource.mipLevel = 0;
+    copy_region.imageSubresource.baseArrayLayer = 0;
+    copy_region.imageSubresource.layerCount = 1;
+    copy_region.imageOffset.x = 0;
+    copy_region.imageOffset.y = 0;
+    copy_region.imageOffset.z = 0;
+    copy_region.imageExtent.width = ring->width;
+    copy_region.imageExtent.height = ring->height;
+    copy_region.imageExtent.depth = 1;
+    vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &copy_region);
+
+    image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    image_barrier.dstAccessMask = 0;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    /* Make the copy visible to the encoder once the fence signals */
+    VkBufferMemoryBarrier buffer_barrier = {};
+    buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buffer_barrier.pNext = NULL;
+    buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.buffer = slot.buffer;
+    buffer_barrier.offset = 0;
+    buffer_barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 0, NULL, 1, &buffer_barrier, 1, &image_barrier);
+
+    return true;
+}
+
+void submit_capture(capture_ring *ring, VkQueue queue) {
+    if (ring->recorded_slot < 0) return;
 
-        ptr += sr_layout.rowPitch;
+    capture_ring::slot &slot = ring->slots[ring->recorded_slot];
+    ring->recorded_slot = -1;
+
+    /* An empty submit signals its fence once all earlier work on the queue
+     * is done, so the frame's own submit and fence are left alone */
+    VkResult U_ASSERT_ONLY res = vkQueueSubmit(queue, 0, NULL, slot.fence);
+    assert(res == VK_SUCCESS);
+
+    {
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        slot.state = capture_ring::SLOT_PENDING;
+        ring->pending.push_back((uint32_t)(&slot - ring->slots.data()));
     }
+    ring->cond.notify_one();
+    ring->captured++;
+}
 
-    file.close();
-    vkUnmapMemory(info.device, mappableMemory);
-    vkDestroyImage(info.device, mappableImage, NULL);
-    vkFreeMemory(info.device, mappableMemory, NULL);
+void destroy_capture_ring(capture_ring *ring) {
+    if (!ring) return;
+
+    {
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        ring->quit = true;
+    }
+    ring->cond.notify_one();
+    ring->encoder.join();
+
+    if (ring->dropped) printf("Capture dropped %u of %u frames\n", ring->dropped, ring->captured + ring->dropped);
+
+    for (uint32_t i = 0; i < ring->slots.size(); i++) {
+        capture_ring::slot &slot = ring->slots[i];
+        /* A slot recorded but never submitted has no work to wait for */
+        vkUnmapMemory(ring->device, slot.memory);
+        vkDestroyBuffer(ring->device, slot.buffer, NULL);
+        vkFreeMemory(ring->device, slot.memory, NULL);
+        vkDestroyFence(ring->device, slot.fence, NULL);
+    }
+
+    delete ring;
 }
 
 std::string get_file_directory() {
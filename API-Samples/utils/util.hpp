@@ -268,9 +268,39 @@ void set_image_layout(struct sample_info &demo, VkImage image,
                       VkPipelineStageFlags src_stages,
                       VkPipelineStageFlags dest_stages);
 
+// A PPM file mapped into memory, with its header parsed and validated
+struct ppm_file {
+    int width;
+    int height;
+    int maxval;
+    // the first sample
+    const unsigned char *pixels;
+
+    const unsigned char *file_data;
+    size_t file_size;
+};
+bool open_ppm(char const *const filename, ppm_file &ppm);
+// Expand the pixels to RGBA8 rows rowPitch bytes apart
+void copy_ppm_rgba(const ppm_file &ppm, uint64_t rowPitch,
+                   unsigned char *dataPtr);
+void close_ppm(ppm_file &ppm);
+
 bool read_ppm(char const *const filename, int &width, int &height,
               uint64_t rowPitch, unsigned char *dataPtr);
 void write_ppm(struct sample_info &info, const char *basename);
+
+// Asynchronous capture to PPM files.  Each slot is a host-visible readback
+// buffer; a background thread encodes the slots whose copies have finished.
+struct capture_ring;
+capture_ring *init_capture_ring(struct sample_info &info, uint32_t slot_count);
+// Record a copy of a presentable image into a free slot.  Returns false,
+// and drops the frame, when all slots are still being encoded.
+bool cmd_capture_image(capture_ring *ring, VkCommandBuffer cmd, VkImage image,
+                       const char *basename);
+// Call after the command buffer passed to cmd_capture_image is submitted
+void submit_capture(capture_ring *ring, VkQueue queue);
+// Waits for the queued captures to be written
+void destroy_capture_ring(capture_ring *ring);
 void extract_version(uint32_t version, uint32_t &major, uint32_t &minor,
                      uint32_t &patch);
 bool GLSLtoSPV(const VkShaderStageFlagBits shader_type, const char *pshader,
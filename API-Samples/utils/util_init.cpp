@@ -26,6 +26,8 @@ samples "init" utility functions
 #include <cstdlib>
 #include <assert.h>
 #include <string.h>
+#include <atomic>
+#include <thread>
 #include "util_init.hpp"
 #include "cube_data.h"
 
@@ -1750,18 +1752,22 @@ void init_image(struct sample_info &info, texture_object &texObj, const char *te
     else
         filename.append(textureName);
 
-    if (!read_ppm(filename.c_str(), texObj.tex_width, texObj.tex_height, 0, NULL)) {
+    /* The file stays mapped until its pixels are copied below */
+    ppm_file ppm;
+    if (!open_ppm(filename.c_str(), ppm)) {
         std::cout << "Try relative path\n";
         filename = "../../API-Samples/data/";
         if (textureName == nullptr)
             filename.append("lunarg.ppm");
         else
             filename.append(textureName);
-        if (!read_ppm(filename.c_str(), texObj.tex_width, texObj.tex_height, 0, NULL)) {
+        if (!open_ppm(filename.c_str(), ppm)) {
             std::cout << "Could not read texture file " << filename;
             exit(-1);
         }
     }
+    texObj.tex_width = ppm.width;
+    texObj.tex_height = ppm.height;
 
     VkFormatProperties formatProps;
     vkGetPhysicalDeviceFormatProperties(info.gpus[0], VK_FORMAT_R8G8B8A8_UNORM, &formatProps);
@@ -1878,12 +1884,9 @@ void init_image(struct sample_info &info, texture_object &texObj, const char *te
     }
     assert(res == VK_SUCCESS);
 
-    /* Read the ppm file into the mappable image's memory */
-    if (!read_ppm(filename.c_str(), texObj.tex_width, texObj.tex_height,
-                  texObj.needs_staging ? (texObj.tex_width * 4) : layout.rowPitch, (unsigned char *)data)) {
-        std::cout << "Could not load texture file lunarg.ppm\n";
-        exit(-1);
-    }
+    /* Copy the ppm pixels into the mappable image's memory */
+    copy_ppm_rgba(ppm, texObj.needs_staging ? (texObj.tex_width * 4) : layout.rowPitch, (unsigned char *)data);
+    close_ppm(ppm);
 
     vkUnmapMemory(info.device, texObj.needs_staging ? texObj.buffer_memory : texObj.image_memory);
 
@@ -1973,6 +1976,292 @@ void init_texture(struct sample_info &info, const char *textureName, VkImageUsag
     info.texture_data.image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 }
 
+/* Run fn(0) .. fn(count - 1) on up to one thread per core */
+template <typename Fn>
+static void parallel_for(size_t count, Fn fn) {
+    size_t thread_count = std::thread::hardware_concurrency();
+    if (thread_count == 0) thread_count = 1;
+    if (thread_count > count) thread_count = count;
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) fn(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; i++) threads.push_back(std::thread(worker));
+    worker();
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+}
+
+void init_textures(struct sample_info &info, const std::vector<const char *> &textureNames, VkImageUsageFlags extraUsages,
+                   VkFormatFeatureFlags extraFeatures) {
+    VkResult U_ASSERT_ONLY res;
+    bool U_ASSERT_ONLY pass;
+    const size_t count = textureNames.size();
+    if (count == 0) return;
+
+    /* Map and parse every file.  The workers only record which files
+     * failed; they are reported and the sample exits once all are joined */
+    std::vector<ppm_file> ppms(count);
+    std::vector<char> opened(count, 0);
+    parallel_for(count, [&](size_t i) {
+        std::string filename = get_base_data_dir() + textureNames[i];
+        opened[i] = open_ppm(filename.c_str(), ppms[i]);
+        if (!opened[i]) {
+            filename = std::string("../../API-Samples/data/") + textureNames[i];
+            opened[i] = open_ppm(filename.c_str(), ppms[i]);
+        }
+    });
+
+    bool all_opened = true;
+    for (size_t i = 0; i < count; i++) {
+        if (!opened[i]) {
+            std::cout << "Could not read texture file " << textureNames[i] << "\n";
+            all_opened = false;
+        }
+    }
+    if (!all_opened) {
+        for (size_t i = 0; i < count; i++) {
+            if (opened[i]) close_ppm(ppms[i]);
+        }
+        exit(-1);
+    }
+
+    /* All textures are optimally tiled and filled from one staging arena */
+    VkFormatProperties formatProps;
+    vkGetPhysicalDeviceFormatProperties(info.gpus[0], VK_FORMAT_R8G8B8A8_UNORM, &formatProps);
+    VkFormatFeatureFlags allFeatures = (VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | extraFeatures);
+    assert((formatProps.optimalTilingFeatures & allFeatures) == allFeatures);
+
+    std::vector<VkDeviceSize> offsets(count);
+    VkDeviceSize arena_size = 0;
+    for (size_t i = 0; i < count; i++) {
+        /* Keep every region aligned for the copy */
+        offsets[i] = (arena_size + 15) & ~(VkDeviceSize)15;
+        arena_size = offsets[i] + (VkDeviceSize)ppms[i].width * ppms[i].height * 4;
+    }
+
+    VkBufferCreateInfo buffer_create_info = {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.pNext = NULL;
+    buffer_create_info.flags = 0;
+    buffer_create_info.size = arena_size;
+    buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    buffer_create_info.queueFamilyIndexCount = 0;
+    buffer_create_info.pQueueFamilyIndices = NULL;
+    VkBuffer arena;
+    res = vkCreateBuffer(info.device, &buffer_create_info, NULL, &arena);
+    assert(res == VK_SUCCESS);
+
+    VkMemoryRequirements mem_reqs;
+    vkGetBufferMemoryRequirements(info.device, arena, &mem_reqs);
+
+    VkMemoryAllocateInfo mem_alloc = {};
+    mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mem_alloc.pNext = NULL;
+    mem_alloc.allocationSize = mem_reqs.size;
+    mem_alloc.memoryTypeIndex = 0;
+    pass = memory_type_from_properties(info, mem_reqs.memoryTypeBits,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       &mem_alloc.memoryTypeIndex);
+    assert(pass && "No mappable, coherent memory");
+
+    VkDeviceMemory arena_memory;
+    res = vkAllocateMemory(info.device, &mem_alloc, NULL, &arena_memory);
+    assert(res == VK_SUCCESS);
+    res = vkBindBufferMemory(info.device, arena, arena_memory, 0);
+    assert(res == VK_SUCCESS);
+
+    /* Decode straight into the arena */
+    unsigned char *arena_data;
+    res = vkMapMemory(info.device, arena_memory, 0, arena_size, 0, (void **)&arena_data);
+    assert(res == VK_SUCCESS);
+
+    parallel_for(count, [&](size_t i) {
+        copy_ppm_rgba(ppms[i], ppms[i].width * 4, arena_data + offsets[i]);
+        close_ppm(ppms[i]);
+    });
+
+    vkUnmapMemory(info.device, arena_memory);
+
+    /* Create the images while the transitions and copies are recorded into
+     * a command buffer of our own, so info.cmd is left alone */
+    VkCommandBufferAllocateInfo cmd_alloc = {};
+    cmd_alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmd_alloc.pNext = NULL;
+    cmd_alloc.commandPool = info.cmd_pool;
+    cmd_alloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_alloc.commandBufferCount = 1;
+    VkCommandBuffer cmd;
+    res = vkAllocateCommandBuffers(info.device, &cmd_alloc, &cmd);
+    assert(res == VK_SUCCESS);
+
+    VkCommandBufferBeginInfo cmd_buf_info = {};
+    cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmd_buf_info.pNext = NULL;
+    cmd_buf_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    cmd_buf_info.pInheritanceInfo = NULL;
+    res = vkBeginCommandBuffer(cmd, &cmd_buf_info);
+    assert(res == VK_SUCCESS);
+
+    std::vector<texture_object> textures(count);
+    std::vector<VkImageMemoryBarrier> barriers(count);
+    for (size_t i = 0; i < count; i++) {
+        texture_object &texObj = textures[i];
+        texObj.tex_width = ppms[i].width;
+        texObj.tex_height = ppms[i].height;
+        texObj.needs_staging = true;
+        texObj.buffer = VK_NULL_HANDLE;
+        texObj.buffer_memory = VK_NULL_HANDLE;
+        texObj.buffer_size = 0;
+
+        VkImageCreateInfo image_create_info = {};
+        image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_create_info.pNext = NULL;
+        image_create_info.imageType = VK_IMAGE_TYPE_2D;
+        image_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        image_create_info.extent.width = texObj.tex_width;
+        image_create_info.extent.height = texObj.tex_height;
+        image_create_info.extent.depth = 1;
+        image_create_info.mipLevels = 1;
+        image_create_info.arrayLayers = 1;
+        image_create_info.samples = NUM_SAMPLES;
+        image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image_create_info.usage = (VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | extraUsages);
+        image_create_info.queueFamilyIndexCount = 0;
+        image_create_info.pQueueFamilyIndices = NULL;
+        image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_create_info.flags = 0;
+        res = vkCreateImage(info.device, &image_create_info, NULL, &texObj.image);
+        assert(res == VK_SUCCESS);
+
+        vkGetImageMemoryRequirements(info.device, texObj.image, &mem_reqs);
+        mem_alloc.allocationSize = mem_reqs.size;
+        pass = memory_type_from_properties(info, mem_reqs.memoryTypeBits, 0, &mem_alloc.memoryTypeIndex);
+        assert(pass);
+
+        res = vkAllocateMemory(info.device, &mem_alloc, NULL, &texObj.image_memory);
+        assert(res == VK_SUCCESS);
+        res = vkBindImageMemory(info.device, texObj.image, texObj.image_memory, 0);
+        assert(res == VK_SUCCESS);
+
+        VkImageMemoryBarrier &barrier = barriers[i];
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.pNext = NULL;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = texObj.image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+    }
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         (uint32_t)count, barriers.data());
+
+    for (size_t i = 0; i < count; i++) {
+        VkBufferImageCopy copy_region;
+        copy_region.bufferOffset = offsets[i];
+        copy_region.bufferRowLength = textures[i].tex_width;
+        copy_region.bufferImageHeight = textures[i].tex_height;
+        copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy_region.imageSubresource.mipLevel = 0;
+        copy_region.imageSubresource.baseArrayLayer = 0;
+        copy_region.imageSubresource.layerCount = 1;
+        copy_region.imageOffset.x = 0;
+        copy_region.imageOffset.y = 0;
+        copy_region.imageOffset.z = 0;
+        copy_region.imageExtent.width = textures[i].tex_width;
+        copy_region.imageExtent.height = textures[i].tex_height;
+        copy_region.imageExtent.depth = 1;
+        vkCmdCopyBufferToImage(cmd, arena, textures[i].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+
+        barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[i].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        textures[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL,
+                         (uint32_t)count, barriers.data());
+
+    res = vkEndCommandBuffer(cmd);
+    assert(res == VK_SUCCESS);
+
+    VkFenceCreateInfo fenceInfo;
+    VkFence cmdFence;
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.pNext = NULL;
+    fenceInfo.flags = 0;
+    vkCreateFence(info.device, &fenceInfo, NULL, &cmdFence);
+
+    VkSubmitInfo submit_info[1] = {};
+    submit_info[0].pNext = NULL;
+    submit_info[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info[0].waitSemaphoreCount = 0;
+    submit_info[0].pWaitSemaphores = NULL;
+    submit_info[0].pWaitDstStageMask = NULL;
+    submit_info[0].commandBufferCount = 1;
+    submit_info[0].pCommandBuffers = &cmd;
+    submit_info[0].signalSemaphoreCount = 0;
+    submit_info[0].pSignalSemaphores = NULL;
+
+    /* One submit for every texture */
+    res = vkQueueSubmit(info.graphics_queue, 1, submit_info, cmdFence);
+    assert(res == VK_SUCCESS);
+
+    /* Views and samplers do not need the copies to have finished */
+    for (size_t i = 0; i < count; i++) {
+        texture_object &texObj = textures[i];
+
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.pNext = NULL;
+        view_info.image = texObj.image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        view_info.components.r = VK_COMPONENT_SWIZZLE_R;
+        view_info.components.g = VK_COMPONENT_SWIZZLE_G;
+        view_info.components.b = VK_COMPONENT_SWIZZLE_B;
+        view_info.components.a = VK_COMPONENT_SWIZZLE_A;
+        view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.baseMipLevel = 0;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount = 1;
+        res = vkCreateImageView(info.device, &view_info, NULL, &texObj.view);
+        assert(res == VK_SUCCESS);
+
+        init_sampler(info, texObj.sampler);
+        info.textures.push_back(texObj);
+    }
+
+    do {
+        res = vkWaitForFences(info.device, 1, &cmdFence, VK_TRUE, FENCE_TIMEOUT);
+    } while (res == VK_TIMEOUT);
+    assert(res == VK_SUCCESS);
+
+    vkDestroyFence(info.device, cmdFence, NULL);
+    vkFreeCommandBuffers(info.device, info.cmd_pool, 1, &cmd);
+    vkDestroyBuffer(info.device, arena, NULL);
+    vkFreeMemory(info.device, arena_memory, NULL);
+
+    /* track a description of the last texture, like init_texture */
+    info.texture_data.image_info.imageView = info.textures.back().view;
+    info.texture_data.image_info.sampler = info.textures.back().sampler;
+    info.texture_data.image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
 void init_viewports(struct sample_info &info) {
 #ifdef __ANDROID__
 // Disable dynamic viewport on Android. Some drive has an issue with the dynamic viewport
@@ -85,6 +85,12 @@ void init_image(struct sample_info &info, texture_object &texObj,
 void init_texture(struct sample_info &info, const char *textureName = nullptr,
                   VkImageUsageFlags extraUsages = 0,
                   VkFormatFeatureFlags extraFeatures = 0);
+// Load several textures at once: the files are decoded in parallel into one
+// staging buffer and uploaded with a single submit.  Appends to info.textures.
+void init_textures(struct sample_info &info,
+                   const std::vector<const char *> &textureNames,
+                   VkImageUsageFlags extraUsages = 0,
+                   VkFormatFeatureFlags extraFeatures = 0);
 void init_viewports(struct sample_info &info);
 void init_scissors(struct sample_info &info);
 void init_fence(struct sample_info &info, VkFence &fence);
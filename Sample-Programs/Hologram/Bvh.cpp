@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "Bvh.h"
+
+namespace {
+
+// rebuild once the tree is this much looser than when built
+const float rebuild_ratio = 2.0f;
+
+float surface_area(const glm::vec3 &min, const glm::vec3 &max) {
+    const glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+}  // namespace
+
+Bvh::Bvh() : begin_(0), end_(0), build_cost_(0.0f) {}
+
+void Bvh::build(const Simulation &sim, int begin, int end) {
+    begin_ = begin;
+    end_ = end;
+
+    nodes_.clear();
+    objects_.resize(end - begin);
+    bounds_.resize(end - begin);
+    if (begin == end) return;
+
+    std::vector<BuildItem> items(objects_.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        auto &item = items[i];
+        item.object = static_cast<uint32_t>(begin + i);
+        sim.bounds(sim.objects()[item.object], item.bounds.min, item.bounds.max);
+        item.center = (item.bounds.min + item.bounds.max) * 0.5f;
+    }
+
+    // leaves hold at least two objects
+    nodes_.reserve(items.size());
+    nodes_.emplace_back();
+    build_node(0, items.data(), 0, static_cast<uint32_t>(items.size()));
+
+    slots_.resize(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        objects_[i] = items[i].object;
+        bounds_[i] = items[i].bounds;
+        slots_[items[i].object - begin] = static_cast<uint32_t>(i);
+    }
+
+    // fit the nodes bottom-up
+    for (auto node = nodes_.rbegin(); node != nodes_.rend(); ++node) {
+        if (node->left)
+            fit_internal(*node);
+        else
+            fit_leaf(*node);
+    }
+
+    build_cost_ = cost();
+}
+
+void Bvh::build_node(uint32_t index, BuildItem *items, uint32_t object_begin, uint32_t object_end) {
+    nodes_[index].left = 0;
+    nodes_[index].object_begin = object_begin;
+    nodes_[index].object_end = object_end;
+    if (object_end - object_begin <= leaf_size) return;
+
+    // split at the median along the longest axis of the centers
+    glm::vec3 min = items[object_begin].center, max = items[object_begin].center;
+    for (uint32_t i = object_begin + 1; i < object_end; i++) {
+        min = glm::min(min, items[i].center);
+        max = glm::max(max, items[i].center);
+    }
+    const glm::vec3 extent = max - min;
+    const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z) ? 1 : 2;
+
+    const uint32_t mid = object_begin + (object_end - object_begin) / 2;
+    std::nth_element(items + object_begin, items + mid, items + object_end,
+                     [axis](const BuildItem &a, const BuildItem &b) { return a.center[axis] < b.center[axis]; });
+
+    // children follow their parent, so that fitting can go in reverse
+    const uint32_t left = static_cast<uint32_t>(nodes_.size());
+    nodes_[index].left = left;
+    nodes_.emplace_back();
+    nodes_.emplace_back();
+
+    build_node(left, items, object_begin, mid);
+    build_node(left + 1, items, mid, object_end);
+}
+
+void Bvh::refit(const Simulation &sim) {
+    // read the objects in order
+    const auto &objects = sim.objects();
+    for (size_t i = 0; i < slots_.size(); i++) {
+        auto &bounds = bounds_[slots_[i]];
+        sim.bounds(objects[begin_ + i], bounds.min, bounds.max);
+    }
+
+    for (auto node = nodes_.rbegin(); node != nodes_.rend(); ++node) {
+        if (node->left)
+            fit_internal(*node);
+        else
+            fit_leaf(*node);
+    }
+}
+
+void Bvh::fit_leaf(Node &node) const {
+    node.min = bounds_[node.object_begin].min;
+    node.max = bounds_[node.object_begin].max;
+    for (uint32_t i = node.object_begin + 1; i < node.object_end; i++) {
+        node.min = glm::min(node.min, bounds_[i].min);
+        node.max = glm::max(node.max, bounds_[i].max);
+    }
+}
+
+void Bvh::fit_internal(Node &node) const {
+    const Node &left = nodes_[node.left];
+    const Node &right = nodes_[node.left + 1];
+    node.min = glm::min(left.min, right.min);
+    node.max = glm::max(left.max, right.max);
+}
+
+float Bvh::cost() const {
+    if (nodes_.empty()) return 0.0f;
+
+    float area = 0.0f;
+    for (const auto &node : nodes_) area += surface_area(node.min, node.max);
+
+    const float root_area = surface_area(nodes_[0].min, nodes_[0].max);
+    return (root_area > 0.0f) ? area / root_area : 0.0f;
+}
+
+bool Bvh::degraded() const { return cost() > build_cost_ * rebuild_ratio; }
+
+uint32_t Bvh::cull(const Frustum &frustum, uint8_t *visible) const {
+    memset(visible + begin_, 0, end_ - begin_);
+    if (nodes_.empty()) return 0;
+
+    // the tree is balanced; 64 levels are plenty
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    uint32_t visited = 0;
+    while (top) {
+        const Node &node = nodes_[stack[--top]];
+        visited++;
+
+        const Frustum::Containment containment = frustum.contains_box(node.min, node.max);
+        if (containment == Frustum::OUTSIDE) continue;
+
+        if (containment == Frustum::INSIDE) {
+            for (uint32_t i = node.object_begin; i < node.object_end; i++) visible[objects_[i]] = 1;
+        } else if (node.left) {
+            stack[top++] = node.left + 1;
+            stack[top++] = node.left;
+        } else {
+            for (uint32_t i = node.object_begin; i < node.object_end; i++) {
+                if (frustum.contains_box(bounds_[i].min, bounds_[i].max) != Frustum::OUTSIDE) visible[objects_[i]] = 1;
+            }
+        }
+    }
+
+    return visited;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "Simulation.h"
+
+// A bounding volume hierarchy over the world space bounds of a range of
+// Simulation objects.  It is built top-down by median splits and refit in
+// place as the objects move along their paths.  Refitting loosens the tree;
+// degraded() tells when the nodes have grown enough for a rebuild to pay off.
+class Bvh {
+   public:
+    static const int leaf_size = 4;
+
+    Bvh();
+
+    // objects [begin, end) of sim
+    void build(const Simulation &sim, int begin, int end);
+    int begin() const { return begin_; }
+    int end() const { return end_; }
+
+    // update the bounds to the current object bounds, keeping the topology
+    void refit(const Simulation &sim);
+    // the node surface area relative to the root has grown past
+    // rebuild_ratio times what it was when built
+    bool degraded() const;
+
+    // Set visible[i] for the objects that may be inside frustum and clear it
+    // for the others, for i in [begin, end).  Returns the number of nodes
+    // visited.
+    uint32_t cull(const Frustum &frustum, uint8_t *visible) const;
+
+   private:
+    struct Node {
+        glm::vec3 min;
+        // the left child, followed by the right one; 0 for leaves
+        uint32_t left;
+        glm::vec3 max;
+        // the objects under the node, in objects_
+        uint32_t object_begin;
+        uint32_t object_end;
+    };
+
+    struct Bounds {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    struct BuildItem {
+        uint32_t object;
+        Bounds bounds;
+        glm::vec3 center;
+    };
+
+    void build_node(uint32_t index, BuildItem *items, uint32_t object_begin, uint32_t object_end);
+    void fit_leaf(Node &node) const;
+    void fit_internal(Node &node) const;
+    // the summed surface area of the nodes over that of the root
+    float cost() const;
+
+    int begin_;
+    int end_;
+
+    std::vector<Node> nodes_;
+    // object indices, ordered so that every node covers a contiguous run
+    std::vector<uint32_t> objects_;
+    // by position in objects_
+    std::vector<Bounds> bounds_;
+    // the position in objects_ of each object, from begin_
+    std::vector<uint32_t> slots_;
+
+    float build_cost_;
+};
+
+#endif  // BVH_H
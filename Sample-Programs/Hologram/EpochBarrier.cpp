@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#endif
+
+#include "EpochBarrier.h"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define CPU_RELAX() __asm__ __volatile__("yield")
+#else
+#define CPU_RELAX() ((void)0)
+#endif
+
+EpochBarrier::EpochBarrier(int participant_count)
+    : participant_count_(static_cast<uint32_t>(participant_count)),
+      epoch_(0),
+      task_(0),
+      participant_sleepers_(0),
+      coordinator_spin_limit_(min_spin),
+      remaining_(0),
+      coordinator_sleepers_(0) {
+    assert(participant_count > 0);
+}
+
+void EpochBarrier::publish(uint32_t task) {
+    wait_done();
+
+    // both are visible to whoever observes the new epoch
+    task_.store(task, std::memory_order_relaxed);
+    remaining_.store(participant_count_, std::memory_order_relaxed);
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+
+    wake_all(epoch_, participant_sleepers_);
+}
+
+void EpochBarrier::wait_done() {
+    uint32_t remaining = remaining_.load(std::memory_order_acquire);
+    while (remaining) {
+        wait_while(remaining_, remaining, coordinator_sleepers_, coordinator_spin_limit_);
+        remaining = remaining_.load(std::memory_order_acquire);
+    }
+}
+
+uint32_t EpochBarrier::wait_epoch(uint32_t epoch, uint32_t &task, uint32_t &spin_limit) {
+    wait_while(epoch_, epoch, participant_sleepers_, spin_limit);
+
+    const uint32_t current = epoch_.load(std::memory_order_acquire);
+    task = task_.load(std::memory_order_relaxed);
+
+    return current;
+}
+
+void EpochBarrier::arrive() {
+    if (remaining_.fetch_sub(1, std::memory_order_seq_cst) == 1) wake_all(remaining_, coordinator_sleepers_);
+}
+
+void EpochBarrier::wait_while(std::atomic<uint32_t> &word, uint32_t val, std::atomic<uint32_t> &sleepers, uint32_t &spin_limit) {
+    spin_limit = std::min(std::max(spin_limit, min_spin), max_spin);
+
+    // spin longer when spinning pays off and shorter when it does not
+    for (uint32_t i = 0; i < spin_limit; i++) {
+        if (word.load(std::memory_order_acquire) != val) {
+            spin_limit = std::min(spin_limit * 2, max_spin);
+            return;
+        }
+        CPU_RELAX();
+    }
+    spin_limit = std::max(spin_limit / 2, min_spin);
+
+    // the wakers check sleepers after changing word; both are seq_cst so
+    // that either they see the sleeper or the sleeper sees the new value
+    sleepers.fetch_add(1, std::memory_order_seq_cst);
+    while (word.load(std::memory_order_seq_cst) == val) {
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, val, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+        WaitOnAddress(&word, &val, sizeof(val), INFINITE);
+#else
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&] { return word.load(std::memory_order_seq_cst) != val; });
+#endif
+    }
+    sleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void EpochBarrier::wake_all(std::atomic<uint32_t> &word, std::atomic<uint32_t> &sleepers) {
+    if (!sleepers.load(std::memory_order_seq_cst)) return;
+
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+    WakeByAddressAll(&word);
+#else
+    (void)word;
+    std::lock_guard<std::mutex> lock(mutex_);
+    cv_.notify_all();
+#endif
+}
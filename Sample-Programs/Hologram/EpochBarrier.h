@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EPOCH_BARRIER_H
+#define EPOCH_BARRIER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// One coordinator hands the same task to participant_count participants
+// and waits for all of them to finish it.  Publishing is a single atomic
+// increment of the epoch and completion is a single shared counter, so a
+// handoff costs no syscalls when the other side is spinning.  Waiters spin
+// for an adaptive number of iterations before sleeping on a futex
+// (WaitOnAddress on Windows).
+class EpochBarrier {
+   public:
+    explicit EpochBarrier(int participant_count);
+
+    EpochBarrier(const EpochBarrier &barrier) = delete;
+    EpochBarrier &operator=(const EpochBarrier &barrier) = delete;
+
+    // the epoch participants that start now should wait past
+    uint32_t epoch() const { return epoch_.load(std::memory_order_acquire); }
+
+    // coordinator: wait for the current epoch to finish and start the next
+    void publish(uint32_t task);
+    // coordinator: wait for the current epoch to finish
+    void wait_done();
+
+    // Participants: wait for an epoch newer than epoch, return it and the
+    // task published with it.  spin_limit is the caller's adaptive spin
+    // budget and starts at any value.
+    uint32_t wait_epoch(uint32_t epoch, uint32_t &task, uint32_t &spin_limit);
+    // participants: finish the current epoch
+    void arrive();
+
+   private:
+    static const uint32_t min_spin = 64;
+    static const uint32_t max_spin = 1 << 16;
+
+    // wait until word no longer holds val
+    void wait_while(std::atomic<uint32_t> &word, uint32_t val, std::atomic<uint32_t> &sleepers, uint32_t &spin_limit);
+    void wake_all(std::atomic<uint32_t> &word, std::atomic<uint32_t> &sleepers);
+
+    const uint32_t participant_count_;
+
+    // written by the coordinator
+    std::atomic<uint32_t> epoch_;
+    std::atomic<uint32_t> task_;
+    std::atomic<uint32_t> participant_sleepers_;
+    uint32_t coordinator_spin_limit_;
+    char pad_[64];
+
+    // written by the participants
+    std::atomic<uint32_t> remaining_;
+    std::atomic<uint32_t> coordinator_sleepers_;
+
+#if !defined(__linux__) && !defined(_WIN32)
+    std::mutex mutex_;
+    std::condition_variable cv_;
+#endif
+};
+
+#endif  // EPOCH_BARRIER_H
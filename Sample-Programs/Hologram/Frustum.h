@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// The planes of a view frustum in Vulkan clip space, where z is in [0, w],
+// for conservative tests of bounding volumes in world space.
+class Frustum {
+   public:
+    enum Containment {
+        OUTSIDE,
+        INTERSECTING,
+        INSIDE,
+    };
+
+    Frustum() {}
+    explicit Frustum(const glm::mat4 &view_projection) {
+        const glm::mat4 rows = glm::transpose(view_projection);
+        planes_[0] = rows[3] + rows[0];
+        planes_[1] = rows[3] - rows[0];
+        planes_[2] = rows[3] + rows[1];
+        planes_[3] = rows[3] - rows[1];
+        planes_[4] = rows[2];
+        planes_[5] = rows[3] - rows[2];
+        for (auto &plane : planes_) plane /= glm::length(glm::vec3(plane));
+    }
+
+    bool intersects_sphere(const glm::vec3 &center, float radius) const {
+        const glm::vec4 point(center, 1.0f);
+        for (const auto &plane : planes_) {
+            if (glm::dot(plane, point) < -radius) return false;
+        }
+        return true;
+    }
+
+    Containment contains_box(const glm::vec3 &min, const glm::vec3 &max) const {
+        Containment result = INSIDE;
+        for (const auto &plane : planes_) {
+            // the corners furthest along and against the plane normal
+            const glm::vec4 far_corner((plane.x >= 0.0f) ? max.x : min.x, (plane.y >= 0.0f) ? max.y : min.y,
+                                       (plane.z >= 0.0f) ? max.z : min.z, 1.0f);
+            const glm::vec4 near_corner((plane.x >= 0.0f) ? min.x : max.x, (plane.y >= 0.0f) ? min.y : max.y,
+                                        (plane.z >= 0.0f) ? min.z : max.z, 1.0f);
+            if (glm::dot(plane, far_corner) < 0.0f) return OUTSIDE;
+            if (glm::dot(plane, near_corner) < 0.0f) result = INTERSECTING;
+        }
+        return result;
+    }
+
+   private:
+    glm::vec4 planes_[6];
+};
+
+#endif  // FRUSTUM_H
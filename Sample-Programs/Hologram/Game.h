@@ -36,14 +36,34 @@ class Game {
         int back_buffer_count;
         int ticks_per_second;
         bool vsync;
+        // prefer FIFO_RELAXED over MAILBOX when vsync is on
+        bool fifo_relaxed;
+        // pace frames to this rate; 0 runs unthrottled
+        int target_fps;
+        // render offscreen at a resolution that tracks GPU time and blit to the back buffer
+        bool dynamic_resolution;
+        // create a queue on a transfer-only queue family when there is one
+        bool transfer_queue;
         bool animate;
 
         bool validate;
         bool validate_verbose;
+        // validation messages printed per message code per second; 0 is unlimited
+        int log_rate_limit;
 
         bool no_tick;
         bool no_render;
         bool no_present;
+
+        int object_count;
+        // OBJ or PLY files drawn in addition to the builtin meshes
+        std::vector<std::string> mesh_files;
+        // replaces object_count and the builtin object mix when set
+        std::string scene_file;
+        // 0 picks one worker per hardware thread
+        int worker_count;
+        // quit after presenting this many frames; 0 runs until closed
+        int max_frame_count;
     };
     const Settings &settings() const { return settings_; }
 
@@ -78,15 +98,24 @@ class Game {
         settings_.back_buffer_count = 1;
         settings_.ticks_per_second = 30;
         settings_.vsync = true;
+        settings_.fifo_relaxed = false;
+        settings_.target_fps = 0;
+        settings_.dynamic_resolution = false;
+        settings_.transfer_queue = false;
         settings_.animate = true;
 
         settings_.validate = false;
         settings_.validate_verbose = false;
+        settings_.log_rate_limit = 10;
 
         settings_.no_tick = false;
         settings_.no_render = false;
         settings_.no_present = false;
 
+        settings_.object_count = 5000;
+        settings_.worker_count = 0;
+        settings_.max_frame_count = 0;
+
         parse_args(args);
     }
 
@@ -98,6 +127,15 @@ class Game {
         for (auto it = args.begin(); it != args.end(); ++it) {
             if (*it == "-b") {
                 settings_.vsync = false;
+            } else if (*it == "--relaxed") {
+                settings_.fifo_relaxed = true;
+            } else if (*it == "--fps") {
+                ++it;
+                settings_.target_fps = std::stoi(*it);
+            } else if (*it == "--dynamic-res") {
+                settings_.dynamic_resolution = true;
+            } else if (*it == "--transfer-queue") {
+                settings_.transfer_queue = true;
             } else if (*it == "-w") {
                 ++it;
                 settings_.initial_width = std::stoi(*it);
@@ -109,12 +147,33 @@ class Game {
             } else if (*it == "-vv") {
                 settings_.validate = true;
                 settings_.validate_verbose = true;
+            } else if (*it == "--log-rate") {
+                ++it;
+                settings_.log_rate_limit = std::stoi(*it);
             } else if (*it == "-nt") {
                 settings_.no_tick = true;
             } else if (*it == "-nr") {
                 settings_.no_render = true;
             } else if (*it == "-np") {
                 settings_.no_present = true;
+            } else if (*it == "--objects") {
+                ++it;
+                settings_.object_count = std::stoi(*it);
+            } else if (*it == "--mesh") {
+                ++it;
+                settings_.mesh_files.push_back(*it);
+            } else if (*it == "--scene") {
+                ++it;
+                settings_.scene_file = *it;
+            } else if (*it == "--workers") {
+                ++it;
+                settings_.worker_count = std::stoi(*it);
+            } else if (*it == "--frames") {
+                ++it;
+                settings_.max_frame_count = std::stoi(*it);
+            } else if (*it == "--tick-rate") {
+                ++it;
+                settings_.ticks_per_second = std::stoi(*it);
             }
         }
     }
@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <cassert>
+#include <random>
+
+#include "Helpers.h"
+#include "GpuSimulation.h"
+
+namespace {
+
+// std430 layout of ObjectState in Hologram.comp
+struct ObjectState {
+    float light_pos[4];
+    float light_color[4];
+    // axis, speed
+    float animation[4];
+    // scale, angle, alpha, alpha_inc
+    float transform[4];
+    // origin, curve type
+    float path[4];
+    // now, start, end
+    float path_time[4];
+    float curve0[4];
+    float curve1[4];
+    // Scene::PathParams: duration, circle radius
+    float path_params0[4];
+    // random extent, random duration, weight of the random curve
+    float path_params1[4];
+    uint32_t rng[4];
+};
+
+// std430 layout of Object in Hologram.comp and Hologram.gpu_sim.vert
+struct Object {
+    float model[4 * 4];
+    float light_pos[4];
+    float light_color[4];
+};
+
+struct TickBlock {
+    float tick;
+    uint32_t tick_count;
+    uint32_t object_count;
+};
+
+const uint32_t workgroup_size = 64;
+
+// CURVE_NONE in Hologram.comp; the first tick generates a subpath
+const float curve_none = -1.0f;
+
+uint32_t find_memory_type(uint32_t type_bits, const std::vector<VkMemoryPropertyFlags> &mem_flags, VkMemoryPropertyFlags required,
+                          VkMemoryPropertyFlags preferred) {
+    uint32_t fallback = UINT32_MAX;
+    for (uint32_t idx = 0; idx < mem_flags.size(); idx++) {
+        if (!(type_bits & (1 << idx)) || (mem_flags[idx] & required) != required) continue;
+
+        if ((mem_flags[idx] & preferred) == preferred) return idx;
+        if (fallback == UINT32_MAX) fallback = idx;
+    }
+
+    if (fallback == UINT32_MAX) throw std::runtime_error("failed to find a memory type");
+
+    return fallback;
+}
+
+}  // namespace
+
+GpuSimulation::GpuSimulation(VkDevice dev, VkQueue queue, uint32_t queue_family,
+                             const std::vector<VkMemoryPropertyFlags> &mem_flags, const Simulation &sim)
+    : dev_(dev), object_count_(static_cast<uint32_t>(sim.objects().size())) {
+    create_buffers(sizeof(ObjectState) * object_count_, sizeof(Object) * object_count_, mem_flags);
+    upload_state(queue, queue_family, mem_flags, sim);
+    create_descriptor_sets();
+    create_pipeline();
+}
+
+GpuSimulation::~GpuSimulation() {
+    vk::DestroyPipeline(dev_, pipeline_, nullptr);
+    vk::DestroyPipelineLayout(dev_, pipeline_layout_, nullptr);
+    vk::DestroyShaderModule(dev_, cs_, nullptr);
+
+    vk::DestroyDescriptorPool(dev_, desc_pool_, nullptr);
+    vk::DestroyDescriptorSetLayout(dev_, object_set_layout_, nullptr);
+    vk::DestroyDescriptorSetLayout(dev_, sim_set_layout_, nullptr);
+
+    vk::DestroyBuffer(dev_, object_buf_, nullptr);
+    vk::DestroyBuffer(dev_, state_buf_, nullptr);
+    vk::FreeMemory(dev_, mem_, nullptr);
+}
+
+void GpuSimulation::create_buffers(VkDeviceSize state_size, VkDeviceSize object_size,
+                                   const std::vector<VkMemoryPropertyFlags> &mem_flags) {
+    VkBufferCreateInfo buf_info = {};
+    buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buf_info.size = state_size;
+    buf_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    vk::assert_success(vk::CreateBuffer(dev_, &buf_info, nullptr, &state_buf_));
+
+    buf_info.size = object_size;
+    buf_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    vk::assert_success(vk::CreateBuffer(dev_, &buf_info, nullptr, &object_buf_));
+
+    VkMemoryRequirements state_mem_reqs, object_mem_reqs;
+    vk::GetBufferMemoryRequirements(dev_, state_buf_, &state_mem_reqs);
+    vk::GetBufferMemoryRequirements(dev_, object_buf_, &object_mem_reqs);
+
+    // objects follow states
+    VkDeviceSize object_offset = state_mem_reqs.size;
+    if (object_offset % object_mem_reqs.alignment)
+        object_offset += object_mem_reqs.alignment - (object_offset % object_mem_reqs.alignment);
+
+    VkMemoryAllocateInfo mem_info = {};
+    mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mem_info.allocationSize = object_offset + object_mem_reqs.size;
+    mem_info.memoryTypeIndex = find_memory_type(state_mem_reqs.memoryTypeBits & object_mem_reqs.memoryTypeBits, mem_flags, 0,
+                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    vk::assert_success(vk::AllocateMemory(dev_, &mem_info, nullptr, &mem_));
+
+    vk::assert_success(vk::BindBufferMemory(dev_, state_buf_, mem_, 0));
+    vk::assert_success(vk::BindBufferMemory(dev_, object_buf_, mem_, object_offset));
+}
+
+void GpuSimulation::upload_state(VkQueue queue, uint32_t queue_family, const std::vector<VkMemoryPropertyFlags> &mem_flags,
+                                 const Simulation &sim) {
+    const VkDeviceSize size = sizeof(ObjectState) * object_count_;
+
+    // staging buffer
+    VkBufferCreateInfo buf_info = {};
+    buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buf_info.size = size;
+    buf_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer staging_buf;
+    vk::assert_success(vk::CreateBuffer(dev_, &buf_info, nullptr, &staging_buf));
+
+    VkMemoryRequirements mem_reqs;
+    vk::GetBufferMemoryRequirements(dev_, staging_buf, &mem_reqs);
+
+    const VkMemoryPropertyFlags host_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkMemoryAllocateInfo mem_info = {};
+    mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mem_info.allocationSize = mem_reqs.size;
+    mem_info.memoryTypeIndex = find_memory_type(mem_reqs.memoryTypeBits, mem_flags, host_flags, host_flags);
+
+    VkDeviceMemory staging_mem;
+    vk::assert_success(vk::AllocateMemory(dev_, &mem_info, nullptr, &staging_mem));
+    vk::assert_success(vk::BindBufferMemory(dev_, staging_buf, staging_mem, 0));
+
+    ObjectState *states;
+    vk::assert_success(vk::MapMemory(dev_, staging_mem, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void **>(&states)));
+
+    // the same starting point as Animation; Path starts without a subpath.
+    // The RNG streams are reproducible when the scene has a seed.
+    std::mt19937 seed_rng(sim.seed());
+    for (uint32_t i = 0; i < object_count_; i++) {
+        const auto &obj = sim.objects()[i];
+        const auto &axis = obj.animation.axis();
+        const float speed = obj.animation.speed();
+
+        ObjectState state = {};
+        state.light_pos[0] = obj.light_pos.x;
+        state.light_pos[1] = obj.light_pos.y;
+        state.light_pos[2] = obj.light_pos.z;
+        state.light_color[0] = obj.light_color.x;
+        state.light_color[1] = obj.light_color.y;
+        state.light_color[2] = obj.light_color.z;
+
+        state.animation[0] = axis.x;
+        state.animation[1] = axis.y;
+        state.animation[2] = axis.z;
+        state.animation[3] = speed;
+
+        state.transform[0] = obj.animation.scale();
+        state.transform[1] = 0.0f;
+        state.transform[2] = speed;
+        state.transform[3] = (speed > 0.5f) ? 0.05f : -0.05f;
+
+        state.path[3] = curve_none;
+        state.path_time[2] = -1.0f;
+
+        const Scene::PathParams &params = obj.path.params();
+        const float total_weight = params.curve_weights[Scene::CURVE_RANDOM] + params.curve_weights[Scene::CURVE_CIRCLE];
+        state.path_params0[0] = params.duration.min;
+        state.path_params0[1] = params.duration.max;
+        state.path_params0[2] = params.circle_radius.min;
+        state.path_params0[3] = params.circle_radius.max;
+        state.path_params1[0] = params.random_extent;
+        state.path_params1[1] = params.random_duration.min;
+        state.path_params1[2] = params.random_duration.max;
+        state.path_params1[3] = (total_weight > 0.0f) ? params.curve_weights[Scene::CURVE_RANDOM] / total_weight : 1.0f;
+
+        state.rng[0] = seed_rng();
+
+        states[i] = state;
+    }
+
+    vk::UnmapMemory(dev_, staging_mem);
+
+    // copy to the device-local buffer and wait
+    VkCommandPoolCreateInfo cmd_pool_info = {};
+    cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    cmd_pool_info.queueFamilyIndex = queue_family;
+
+    VkCommandPool cmd_pool;
+    vk::assert_success(vk::CreateCommandPool(dev_, &cmd_pool_info, nullptr, &cmd_pool));
+
+    VkCommandBufferAllocateInfo cmd_info = {};
+    cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmd_info.commandPool = cmd_pool;
+    cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_info.commandBufferCount = 1;
+
+    VkCommandBuffer cmd;
+    vk::assert_success(vk::AllocateCommandBuffers(dev_, &cmd_info, &cmd));
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vk::assert_success(vk::BeginCommandBuffer(cmd, &begin_info));
+
+    VkBufferCopy region = {};
+    region.size = size;
+    vk::CmdCopyBuffer(cmd, staging_buf, state_buf_, 1, &region);
+
+    VkBufferMemoryBarrier buf_barrier = {};
+    buf_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buf_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    buf_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    buf_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buf_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buf_barrier.buffer = state_buf_;
+    buf_barrier.offset = 0;
+    buf_barrier.size = VK_WHOLE_SIZE;
+    vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &buf_barrier,
+                           0, nullptr);
+
+    vk::assert_success(vk::EndCommandBuffer(cmd));
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd;
+    vk::assert_success(vk::QueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    vk::assert_success(vk::QueueWaitIdle(queue));
+
+    vk::DestroyCommandPool(dev_, cmd_pool, nullptr);
+    vk::DestroyBuffer(dev_, staging_buf, nullptr);
+    vk::FreeMemory(dev_, staging_mem, nullptr);
+}
+
+void GpuSimulation::create_descriptor_sets() {
+    std::array<VkDescriptorSetLayoutBinding, 2> layout_bindings = {};
+    layout_bindings[0].binding = 0;
+    layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    layout_bindings[0].descriptorCount = 1;
+    layout_bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layout_bindings[1] = layout_bindings[0];
+    layout_bindings[1].binding = 1;
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(layout_bindings.size());
+    layout_info.pBindings = layout_bindings.data();
+    vk::assert_success(vk::CreateDescriptorSetLayout(dev_, &layout_info, nullptr, &sim_set_layout_));
+
+    layout_bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    layout_info.bindingCount = 1;
+    vk::assert_success(vk::CreateDescriptorSetLayout(dev_, &layout_info, nullptr, &object_set_layout_));
+
+    VkDescriptorPoolSize desc_pool_size = {};
+    desc_pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    desc_pool_size.descriptorCount = 3;
+
+    VkDescriptorPoolCreateInfo desc_pool_info = {};
+    desc_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    desc_pool_info.maxSets = 2;
+    desc_pool_info.poolSizeCount = 1;
+    desc_pool_info.pPoolSizes = &desc_pool_size;
+    vk::assert_success(vk::CreateDescriptorPool(dev_, &desc_pool_info, nullptr, &desc_pool_));
+
+    const std::array<VkDescriptorSetLayout, 2> set_layouts = {sim_set_layout_, object_set_layout_};
+    VkDescriptorSetAllocateInfo set_info = {};
+    set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    set_info.descriptorPool = desc_pool_;
+    set_info.descriptorSetCount = static_cast<uint32_t>(set_layouts.size());
+    set_info.pSetLayouts = set_layouts.data();
+
+    std::array<VkDescriptorSet, 2> sets;
+    vk::assert_success(vk::AllocateDescriptorSets(dev_, &set_info, sets.data()));
+    sim_set_ = sets[0];
+    object_set_ = sets[1];
+
+    std::array<VkDescriptorBufferInfo, 2> desc_bufs = {};
+    desc_bufs[0].buffer = state_buf_;
+    desc_bufs[0].range = VK_WHOLE_SIZE;
+    desc_bufs[1].buffer = object_buf_;
+    desc_bufs[1].range = VK_WHOLE_SIZE;
+
+    std::array<VkWriteDescriptorSet, 3> desc_writes = {};
+    for (auto &write : desc_writes) {
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
+    desc_writes[0].dstSet = sim_set_;
+    desc_writes[0].dstBinding = 0;
+    desc_writes[0].pBufferInfo = &desc_bufs[0];
+    desc_writes[1].dstSet = sim_set_;
+    desc_writes[1].dstBinding = 1;
+    desc_writes[1].pBufferInfo = &desc_bufs[1];
+    desc_writes[2].dstSet = object_set_;
+    desc_writes[2].dstBinding = 0;
+    desc_writes[2].pBufferInfo = &desc_bufs[1];
+
+    vk::UpdateDescriptorSets(dev_, static_cast<uint32_t>(desc_writes.size()), desc_writes.data(), 0, nullptr);
+}
+
+void GpuSimulation::create_pipeline() {
+    VkShaderModuleCreateInfo sh_info = {};
+    sh_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+#ifndef __ANDROID__  // Hologram rejects --gpu-sim on Android
+#include "Hologram.comp.h"
+    sh_info.codeSize = sizeof(Hologram_comp);
+    sh_info.pCode = Hologram_comp;
+#endif
+    vk::assert_success(vk::CreateShaderModule(dev_, &sh_info, nullptr, &cs_));
+
+    VkPushConstantRange push_const_range = {};
+    push_const_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_const_range.offset = 0;
+    push_const_range.size = sizeof(TickBlock);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &sim_set_layout_;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_const_range;
+    vk::assert_success(vk::CreatePipelineLayout(dev_, &pipeline_layout_info, nullptr, &pipeline_layout_));
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = cs_;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = pipeline_layout_;
+    vk::assert_success(vk::CreateComputePipelines(dev_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline_));
+}
+
+void GpuSimulation::cmd_update(VkCommandBuffer cmd, float tick, uint32_t tick_count) const {
+    // the previous frame may still be reading the objects
+    VkBufferMemoryBarrier buf_barrier = {};
+    buf_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buf_barrier.srcAccessMask = 0;
+    buf_barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    buf_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buf_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buf_barrier.buffer = object_buf_;
+    buf_barrier.offset = 0;
+    buf_barrier.size = VK_WHOLE_SIZE;
+
+    // and the previous dispatch has written the state this one updates
+    VkBufferMemoryBarrier state_barrier = buf_barrier;
+    state_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    state_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    state_barrier.buffer = state_buf_;
+
+    const std::array<VkBufferMemoryBarrier, 2> pre_barriers = {{buf_barrier, state_barrier}};
+    vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, static_cast<uint32_t>(pre_barriers.size()),
+                           pre_barriers.data(), 0, nullptr);
+
+    TickBlock params;
+    params.tick = tick;
+    params.tick_count = tick_count;
+    params.object_count = object_count_;
+
+    vk::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_);
+    vk::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0, 1, &sim_set_, 0, nullptr);
+    vk::CmdPushConstants(cmd, pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    vk::CmdDispatch(cmd, (object_count_ + workgroup_size - 1) / workgroup_size, 1, 1);
+
+    // make the objects visible to the vertex shader
+    buf_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    buf_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, 1,
+                           &buf_barrier, 0, nullptr);
+}
+
+void GpuSimulation::cmd_copy_objects(VkCommandBuffer cmd, VkBuffer dst) const {
+    VkBufferMemoryBarrier buf_barrier = {};
+    buf_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buf_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    buf_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    buf_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buf_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buf_barrier.buffer = object_buf_;
+    buf_barrier.offset = 0;
+    buf_barrier.size = VK_WHOLE_SIZE;
+    vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
+                           &buf_barrier, 0, nullptr);
+
+    VkBufferCopy region = {};
+    region.size = object_buffer_size();
+    vk::CmdCopyBuffer(cmd, object_buf_, dst, 1, &region);
+
+    buf_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    buf_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    buf_barrier.buffer = dst;
+    vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &buf_barrier, 0,
+                           nullptr);
+}
+
+VkDeviceSize GpuSimulation::object_stride() { return sizeof(Object); }
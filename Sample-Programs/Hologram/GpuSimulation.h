@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GPU_SIMULATION_H
+#define GPU_SIMULATION_H
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Simulation.h"
+
+// Simulation on the GPU.  Object state lives in a device-local storage
+// buffer and is advanced by Hologram.comp, which mirrors Path, the curves
+// and Animation.  The results are written to a second storage buffer that
+// the vertex shader indexes with gl_InstanceIndex.
+class GpuSimulation {
+   public:
+    // sim provides the meshes, the lights and the animation parameters
+    GpuSimulation(VkDevice dev, VkQueue queue, uint32_t queue_family, const std::vector<VkMemoryPropertyFlags> &mem_flags,
+                  const Simulation &sim);
+    ~GpuSimulation();
+
+    GpuSimulation(const GpuSimulation &sim) = delete;
+    GpuSimulation &operator=(const GpuSimulation &sim) = delete;
+
+    // binding 0 is the object buffer, readable from the vertex stage
+    VkDescriptorSetLayout object_set_layout() const { return object_set_layout_; }
+    VkDescriptorSet object_set() const { return object_set_; }
+
+    // Record tick_count simulation steps of tick seconds each.  The object
+    // buffer is updated even when tick_count is 0.  Must be recorded outside
+    // of render passes.
+    void cmd_update(VkCommandBuffer cmd, float tick, uint32_t tick_count) const;
+
+    // Record a copy of the object buffer to dst for the host to read, after
+    // cmd_update.  Each object takes object_stride() bytes and starts with
+    // its column-major model matrix.  The copy must complete before the
+    // next cmd_update.
+    void cmd_copy_objects(VkCommandBuffer cmd, VkBuffer dst) const;
+    VkDeviceSize object_buffer_size() const { return object_stride() * object_count_; }
+    static VkDeviceSize object_stride();
+
+   private:
+    void create_buffers(VkDeviceSize state_size, VkDeviceSize object_size, const std::vector<VkMemoryPropertyFlags> &mem_flags);
+    void upload_state(VkQueue queue, uint32_t queue_family, const std::vector<VkMemoryPropertyFlags> &mem_flags,
+                      const Simulation &sim);
+    void create_descriptor_sets();
+    void create_pipeline();
+
+    VkDevice dev_;
+    uint32_t object_count_;
+
+    VkBuffer state_buf_;
+    VkBuffer object_buf_;
+    VkDeviceMemory mem_;
+
+    VkDescriptorSetLayout sim_set_layout_;
+    VkDescriptorSetLayout object_set_layout_;
+    VkDescriptorPool desc_pool_;
+    VkDescriptorSet sim_set_;
+    VkDescriptorSet object_set_;
+
+    VkShaderModule cs_;
+    VkPipelineLayout pipeline_layout_;
+    VkPipeline pipeline_;
+};
+
+#endif  // GPU_SIMULATION_H
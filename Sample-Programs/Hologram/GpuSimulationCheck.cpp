@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "Helpers.h"
+#include "GpuSimulation.h"
+#include "GpuSimulationCheck.h"
+#include "Shell.h"
+#include "Simulation.h"
+
+namespace {
+
+// c(alpha) of the Kolmogorov-Smirnov test at alpha = 0.001
+const double ks_coefficient = 1.949;
+
+// per-object motion over a run
+class Motion {
+   public:
+    explicit Motion(size_t object_count) : objects_(object_count) {}
+
+    void add(size_t idx, const glm::vec3 &pos) {
+        Object &obj = objects_[idx];
+
+        if (!obj.started) {
+            obj.min = pos;
+            obj.max = pos;
+            obj.started = true;
+        } else {
+            // paths wrap around at the edges of the cube
+            const float dist = glm::distance(obj.last, pos);
+            if (dist <= 0.5f) {
+                obj.distance += dist;
+                obj.steps++;
+            }
+            obj.min = glm::min(obj.min, pos);
+            obj.max = glm::max(obj.max, pos);
+        }
+
+        obj.last = pos;
+    }
+
+    // distance per second
+    std::vector<double> speeds(float tick) const {
+        std::vector<double> vals;
+        vals.reserve(objects_.size());
+        for (const auto &obj : objects_) vals.push_back((obj.steps) ? obj.distance / obj.steps / tick : 0.0);
+        return vals;
+    }
+
+    // diagonal of the bounding box of the positions
+    std::vector<double> extents() const {
+        std::vector<double> vals;
+        vals.reserve(objects_.size());
+        for (const auto &obj : objects_) vals.push_back(glm::distance(obj.min, obj.max));
+        return vals;
+    }
+
+   private:
+    struct Object {
+        Object() : started(false), last(0.0f), min(0.0f), max(0.0f), distance(0.0), steps(0) {}
+
+        bool started;
+
+        glm::vec3 last;
+        glm::vec3 min;
+        glm::vec3 max;
+        double distance;
+        uint32_t steps;
+    };
+
+    std::vector<Object> objects_;
+};
+
+double mean(const std::vector<double> &vals) {
+    double sum = 0.0;
+    for (const auto val : vals) sum += val;
+    return (vals.empty()) ? 0.0 : sum / vals.size();
+}
+
+// the two-sample Kolmogorov-Smirnov statistic
+double ks_statistic(std::vector<double> a, std::vector<double> b) {
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+
+    double d = 0.0;
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        const double x = std::min(a[i], b[j]);
+        while (i < a.size() && a[i] <= x) i++;
+        while (j < b.size() && b[j] <= x) j++;
+        d = std::max(d, std::abs(static_cast<double>(i) / a.size() - static_cast<double>(j) / b.size()));
+    }
+
+    return d;
+}
+
+// log one statistic and return whether the distributions match
+bool compare(const Shell &shell, const char *name, const std::vector<double> &cpu, const std::vector<double> &gpu) {
+    const double n = static_cast<double>(cpu.size());
+    const double m = static_cast<double>(gpu.size());
+    const double d = ks_statistic(cpu, gpu);
+    const double critical = ks_coefficient * std::sqrt((n + m) / (n * m));
+    const bool match = (d <= critical);
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(4);
+    ss << "GPU simulation check: " << name << " mean " << mean(cpu) << " on the CPU, " << mean(gpu) << " on the GPU; KS "
+       << d << " (critical " << critical << "): " << ((match) ? "match" : "MISMATCH");
+    shell.log((match) ? Shell::LOG_INFO : Shell::LOG_ERR, ss.str().c_str());
+
+    return match;
+}
+
+}  // namespace
+
+GpuSimulationCheck::GpuSimulationCheck(VkDevice dev, VkQueue queue, uint32_t queue_family,
+                                       const std::vector<VkMemoryPropertyFlags> &mem_flags)
+    : dev_(dev), queue_(queue), queue_family_(queue_family), mem_flags_(mem_flags) {}
+
+bool GpuSimulationCheck::run(const Shell &shell, const Scene &scene, float tick, uint32_t tick_count) const {
+    // both start from the objects as constructed
+    Simulation cpu_sim(scene);
+    GpuSimulation gpu_sim(dev_, queue_, queue_family_, mem_flags_, cpu_sim);
+    const size_t object_count = cpu_sim.objects().size();
+
+    Motion cpu_motion(object_count);
+    for (uint32_t t = 0; t < tick_count; t++) {
+        cpu_sim.update(tick, 0, static_cast<int>(object_count));
+        for (size_t i = 0; i < object_count; i++) cpu_motion.add(i, glm::vec3(cpu_sim.objects()[i].model[3]));
+    }
+
+    // readback buffer
+    VkBufferCreateInfo buf_info = {};
+    buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buf_info.size = gpu_sim.object_buffer_size();
+    buf_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer buf;
+    vk::assert_success(vk::CreateBuffer(dev_, &buf_info, nullptr, &buf));
+
+    VkMemoryRequirements mem_reqs;
+    vk::GetBufferMemoryRequirements(dev_, buf, &mem_reqs);
+
+    const VkMemoryPropertyFlags host_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkMemoryAllocateInfo mem_info = {};
+    mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mem_info.allocationSize = mem_reqs.size;
+    mem_info.memoryTypeIndex = UINT32_MAX;
+    for (uint32_t idx = 0; idx < mem_flags_.size(); idx++) {
+        if ((mem_reqs.memoryTypeBits & (1 << idx)) && (mem_flags_[idx] & host_flags) == host_flags) {
+            mem_info.memoryTypeIndex = idx;
+            break;
+        }
+    }
+    if (mem_info.memoryTypeIndex == UINT32_MAX) throw std::runtime_error("failed to find a memory type");
+
+    VkDeviceMemory mem;
+    vk::assert_success(vk::AllocateMemory(dev_, &mem_info, nullptr, &mem));
+    vk::assert_success(vk::BindBufferMemory(dev_, buf, mem, 0));
+
+    void *mapped;
+    vk::assert_success(vk::MapMemory(dev_, mem, 0, VK_WHOLE_SIZE, 0, &mapped));
+    const uint8_t *objects = static_cast<const uint8_t *>(mapped);
+
+    // one tick and a readback, resubmitted every tick
+    VkCommandPoolCreateInfo cmd_pool_info = {};
+    cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmd_pool_info.queueFamilyIndex = queue_family_;
+
+    VkCommandPool cmd_pool;
+    vk::assert_success(vk::CreateCommandPool(dev_, &cmd_pool_info, nullptr, &cmd_pool));
+
+    VkCommandBufferAllocateInfo cmd_info = {};
+    cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmd_info.commandPool = cmd_pool;
+    cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_info.commandBufferCount = 1;
+
+    VkCommandBuffer cmd;
+    vk::assert_success(vk::AllocateCommandBuffers(dev_, &cmd_info, &cmd));
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    vk::assert_success(vk::BeginCommandBuffer(cmd, &begin_info));
+    gpu_sim.cmd_update(cmd, tick, 1);
+    gpu_sim.cmd_copy_objects(cmd, buf);
+    vk::assert_success(vk::EndCommandBuffer(cmd));
+
+    VkFenceCreateInfo fence_info = {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkFence fence;
+    vk::assert_success(vk::CreateFence(dev_, &fence_info, nullptr, &fence));
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd;
+
+    // the position is the last column of the model matrix
+    const VkDeviceSize stride = GpuSimulation::object_stride();
+    const size_t pos_offset = sizeof(float) * 12;
+
+    Motion gpu_motion(object_count);
+    for (uint32_t t = 0; t < tick_count; t++) {
+        vk::assert_success(vk::QueueSubmit(queue_, 1, &submit_info, fence));
+        vk::assert_success(vk::WaitForFences(dev_, 1, &fence, true, UINT64_MAX));
+        vk::assert_success(vk::ResetFences(dev_, 1, &fence));
+
+        for (size_t i = 0; i < object_count; i++) {
+            float pos[3];
+            std::memcpy(pos, objects + stride * i + pos_offset, sizeof(pos));
+            gpu_motion.add(i, glm::vec3(pos[0], pos[1], pos[2]));
+        }
+    }
+
+    vk::DestroyFence(dev_, fence, nullptr);
+    vk::DestroyCommandPool(dev_, cmd_pool, nullptr);
+    vk::UnmapMemory(dev_, mem);
+    vk::DestroyBuffer(dev_, buf, nullptr);
+    vk::FreeMemory(dev_, mem, nullptr);
+
+    std::stringstream ss;
+    ss << "GPU simulation check: " << object_count << " objects over " << tick_count << " ticks";
+    shell.log(Shell::LOG_INFO, ss.str().c_str());
+
+    const bool speeds_match = compare(shell, "speed", cpu_motion.speeds(tick), gpu_motion.speeds(tick));
+    const bool extents_match = compare(shell, "path extent", cpu_motion.extents(), gpu_motion.extents());
+
+    return speeds_match && extents_match;
+}
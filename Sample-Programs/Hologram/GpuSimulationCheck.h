@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GPU_SIMULATION_CHECK_H
+#define GPU_SIMULATION_CHECK_H
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+class Scene;
+class Shell;
+
+// Checks that GpuSimulation moves objects the way Simulation does.  Both
+// simulate a scene from the same starting point, and the distributions of
+// the per-object speeds and path extents are compared with two-sample
+// Kolmogorov-Smirnov tests.  The two use different RNGs, so only the
+// distributions can match, not the objects.
+class GpuSimulationCheck {
+   public:
+    GpuSimulationCheck(VkDevice dev, VkQueue queue, uint32_t queue_family, const std::vector<VkMemoryPropertyFlags> &mem_flags);
+
+    // simulate tick_count ticks of tick seconds, submitting and reading back
+    // every tick on the GPU; log the statistics and return whether they match
+    bool run(const Shell &shell, const Scene &scene, float tick, uint32_t tick_count) const;
+
+   private:
+    VkDevice dev_;
+    VkQueue queue_;
+    uint32_t queue_family_;
+    const std::vector<VkMemoryPropertyFlags> &mem_flags_;
+};
+
+#endif  // GPU_SIMULATION_CHECK_H
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "EpochBarrier.h"
+#include "HandoffBenchmark.h"
+#include "Shell.h"
+
+namespace {
+
+const int warmup_iteration_count = 100;
+
+// the handoff of Hologram::Worker, without the work
+class CvWorker {
+   public:
+    CvWorker() : state_(IDLE) { thread_ = std::thread([this] { loop(); }); }
+    ~CvWorker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state_ = EXIT;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    void kick() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state_ = WORK;
+        }
+        cv_.notify_one();
+    }
+
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return state_ == IDLE; });
+    }
+
+   private:
+    enum State {
+        IDLE,
+        WORK,
+        EXIT,
+    };
+
+    void loop() {
+        while (true) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return state_ != IDLE; });
+            if (state_ == EXIT) break;
+
+            state_ = IDLE;
+            lock.unlock();
+            cv_.notify_one();
+        }
+    }
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    State state_;
+};
+
+double elapsed_us(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+}
+
+double percentile(std::vector<double> vals, double p) {
+    std::sort(vals.begin(), vals.end());
+    return vals[static_cast<size_t>(p * (vals.size() - 1))];
+}
+
+double mean(const std::vector<double> &vals) {
+    double sum = 0.0;
+    for (auto v : vals) sum += v;
+    return sum / vals.size();
+}
+
+}  // namespace
+
+void HandoffBenchmark::run(const Shell &shell, const std::vector<int> &thread_counts) const {
+    for (auto count : thread_counts) {
+        const auto cv = measure_condition_variables(count);
+        const auto epoch = measure_epoch_barrier(count);
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        ss << "handoff latency (us) with " << count << " threads: mutex/cv mean=" << mean(cv) << " p50=" << percentile(cv, 0.5)
+           << " p99=" << percentile(cv, 0.99) << ", epoch barrier mean=" << mean(epoch) << " p50=" << percentile(epoch, 0.5)
+           << " p99=" << percentile(epoch, 0.99);
+        shell.log(Shell::LOG_INFO, ss.str().c_str());
+    }
+}
+
+std::vector<double> HandoffBenchmark::measure_condition_variables(int thread_count) const {
+    std::vector<std::unique_ptr<CvWorker>> workers;
+    for (int i = 0; i < thread_count; i++) workers.emplace_back(new CvWorker);
+
+    std::vector<double> latencies;
+    latencies.reserve(iteration_count_);
+    for (int iter = -warmup_iteration_count; iter < iteration_count_; iter++) {
+        const auto begin = std::chrono::steady_clock::now();
+        for (auto &worker : workers) worker->kick();
+        for (auto &worker : workers) worker->wait_idle();
+
+        if (iter >= 0) latencies.push_back(elapsed_us(begin));
+    }
+
+    return latencies;
+}
+
+std::vector<double> HandoffBenchmark::measure_epoch_barrier(int thread_count) const {
+    enum Task {
+        TASK_WORK,
+        TASK_EXIT,
+    };
+
+    EpochBarrier barrier(thread_count);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; i++) {
+        threads.emplace_back([&barrier] {
+            uint32_t epoch = 0, task = TASK_WORK, spin_limit = 0;
+            while (true) {
+                epoch = barrier.wait_epoch(epoch, task, spin_limit);
+                barrier.arrive();
+                if (task == TASK_EXIT) break;
+            }
+        });
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve(iteration_count_);
+    for (int iter = -warmup_iteration_count; iter < iteration_count_; iter++) {
+        const auto begin = std::chrono::steady_clock::now();
+        barrier.publish(TASK_WORK);
+        barrier.wait_done();
+
+        if (iter >= 0) latencies.push_back(elapsed_us(begin));
+    }
+
+    barrier.publish(TASK_EXIT);
+    barrier.wait_done();
+    for (auto &thread : threads) thread.join();
+
+    return latencies;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HANDOFF_BENCHMARK_H
+#define HANDOFF_BENCHMARK_H
+
+#include <vector>
+
+class Shell;
+
+// Measures how long it takes the main thread to hand an empty task to N
+// worker threads and to see all of them finish, once with a mutex and a
+// condition variable per worker as Hologram::Worker does, and once with an
+// EpochBarrier.
+class HandoffBenchmark {
+   public:
+    HandoffBenchmark(int iteration_count) : iteration_count_(iteration_count) {}
+
+    // log one line per thread count
+    void run(const Shell &shell, const std::vector<int> &thread_counts) const;
+
+   private:
+    // handoff latencies in microseconds
+    std::vector<double> measure_condition_variables(int thread_count) const;
+    std::vector<double> measure_epoch_barrier(int thread_count) const;
+
+    const int iteration_count_;
+};
+
+#endif  // HANDOFF_BENCHMARK_H
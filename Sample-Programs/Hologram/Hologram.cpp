@@ -15,16 +15,44 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
 
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "EpochBarrier.h"
+#include "GpuSimulation.h"
+#include "GpuSimulationCheck.h"
+#include "HandoffBenchmark.h"
 #include "Helpers.h"
 #include "Hologram.h"
+#include "Icosphere.h"
+#include "IcosphereBenchmark.h"
+#include "MemoryBenchmark.h"
 #include "Meshes.h"
+#include "Partitioner.h"
+#include "ThreadPlacement.h"
 #include "Shell.h"
 
+// where teapot.hmsh is installed, absolute and relative to the executable
+#ifndef HOLOGRAM_MESH_DIR
+#define HOLOGRAM_MESH_DIR "."
+#endif
+#ifndef HOLOGRAM_RELATIVE_MESH_DIR
+#define HOLOGRAM_RELATIVE_MESH_DIR "."
+#endif
+
 namespace {
 
 // TODO do not rely on compiler to use std140 layout
@@ -37,35 +65,195 @@ struct ShaderParamBlock {
     float alpha;
 };
 
+// push constants of Hologram.fused.vert
+struct FusedFrameBlock {
+    float view_projection[4 * 4];
+};
+
+// push constants of Hologram.gpu_sim.vert
+struct GpuSimParamBlock {
+    float view_projection[4 * 4];
+    float fade;
+};
+
+// Without VK_KHR_maintenance3 there is no way to query
+// maxMemoryAllocationSize; stay well below what implementations allow.
+const VkDeviceSize max_allocation_size = VkDeviceSize(1) << 30;
+
+// lower bound of the dynamic render scale, per axis
+const float min_render_scale = 0.25f;
+
+// objects off-screen or below this radius in pixels are simulated every
+// sim_lod_interval ticks
+const float sim_lod_min_pixels = 2.0f;
+const uint32_t sim_lod_interval = 4;
+
+// worker counters have a single writer; skip the locked read-modify-write
+void add_counter(std::atomic<uint64_t> &counter, uint64_t val) {
+    counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+}
+
+uint64_t elapsed_ns(std::chrono::steady_clock::time_point begin) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+}
+
+double ns_to_ms(uint64_t ns) { return static_cast<double>(ns) / 1000000.0; }
+
+// The first directory with teapot.hmsh: next to the executable, as in the
+// build tree, the install data dir relative to the executable, then where it
+// was installed.  exe_path is argv[0].
+std::string find_mesh_dir(const std::string &exe_path) {
+    const size_t slash = exe_path.find_last_of("/\\");
+    const std::string exe_dir = (slash == std::string::npos) ? std::string(".") : exe_path.substr(0, slash);
+
+    const std::array<std::string, 3> dirs = {{exe_dir, exe_dir + "/" + HOLOGRAM_RELATIVE_MESH_DIR, HOLOGRAM_MESH_DIR}};
+    for (const auto &dir : dirs) {
+        if (std::ifstream(dir + "/teapot.hmsh").good()) return dir;
+    }
+
+    // let loading report the installed path
+    return HOLOGRAM_MESH_DIR;
+}
+
+// arguments are parsed before there is a shell to log to
+void print_arg_error(const std::string &name, const std::string &msg) {
+#ifdef __ANDROID__
+    __android_log_write(ANDROID_LOG_WARN, name.c_str(), msg.c_str());
+#else
+    std::cerr << name << ": " << msg << "\n";
+#endif
+}
+
 }  // namespace
 
 Hologram::Hologram(const std::vector<std::string> &args)
     : Game("Hologram", args),
       multithread_(true),
       use_push_constants_(false),
+      use_gpu_sim_(false),
+      check_gpu_sim_(false),
+      use_fused_(false),
+      stage_frame_data_(settings_.transfer_queue),
+      interpolate_(false),
+      sim_lod_(false),
+      use_meshlets_(false),
+      cull_back_faces_(false),
+      use_bvh_(false),
+      dynamic_res_(settings_.dynamic_resolution),
+      gpu_budget_ms_((settings_.target_fps > 0) ? 1000.0f / settings_.target_fps : 1000.0f / 60.0f),
+      force_coherent_(false),
+      run_mem_bench_(false),
+      mesh_dir_(),
+      icosphere_level_(2),
+      run_icosphere_bench_(false),
+      reserved_cpu_(-1),
+      first_touch_(false),
       sim_paused_(false),
       sim_fade_(false),
-      sim_(5000),
+      scene_((settings_.scene_file.empty()) ? Scene(settings_.object_count, settings_.mesh_files)
+                                            : Scene(settings_.scene_file, settings_.mesh_files)),
+      sim_(scene_),
       camera_(2.5f),
+      use_epoch_barrier_(false),
+      run_handoff_bench_(false),
+      gpu_sim_(nullptr),
+      deferred_ticks_(0),
+      frame_ticks_(0),
+      frame_pred_(0.0f),
+      fused_time_(0.0f),
+      frame_data_coherent_(true),
       frame_data_(),
       render_pass_clear_value_({{0.0f, 0.1f, 0.2f, 1.0f}}),
       render_pass_begin_info_(),
       primary_cmd_begin_info_(),
-      primary_cmd_submit_info_() {
+      primary_cmd_submit_info_(),
+      render_scale_(1.0f),
+      gpu_time_ms_(0.0f),
+      print_worker_stats_(false),
+      balance_warmup_frames_(0),
+      imbalance_before_(0.0),
+      imbalance_after_(0.0) {
     for (auto it = args.begin(); it != args.end(); ++it) {
-        if (*it == "-s")
+        if (*it == "-s") {
             multithread_ = false;
-        else if (*it == "-p")
+        } else if (*it == "-p") {
             use_push_constants_ = true;
+        } else if (*it == "--gpu-sim" || *it == "--gpu-sim-check") {
+#ifdef __ANDROID__
+            // the Android build has no prebuilt Hologram.comp.h or Hologram.gpu_sim.vert.h
+            __android_log_write(ANDROID_LOG_WARN, settings_.name.c_str(), "--gpu-sim is not available on Android");
+#else
+            use_gpu_sim_ = true;
+            if (*it == "--gpu-sim-check") check_gpu_sim_ = true;
+#endif
+        } else if (*it == "--fused") {
+#ifdef __ANDROID__
+            // the Android build has no prebuilt Hologram.fused.vert.h
+            __android_log_write(ANDROID_LOG_WARN, settings_.name.c_str(), "--fused is not available on Android");
+#else
+            use_fused_ = true;
+#endif
+        } else if (*it == "--interpolate") {
+            interpolate_ = true;
+        } else if (*it == "--sim-lod") {
+            sim_lod_ = true;
+        } else if (*it == "--meshlets") {
+            use_meshlets_ = true;
+        } else if (*it == "--cull-back-faces") {
+            cull_back_faces_ = true;
+        } else if (*it == "--bvh") {
+            use_bvh_ = true;
+        } else if (*it == "--balance") {
+            balance_warmup_frames_ = 60;
+        } else if (*it == "--affinity") {
+            ++it;
+            try {
+                worker_cpus_ = placement::parse_cpu_list(*it);
+            } catch (const std::logic_error &) {
+                print_arg_error(settings_.name, "--affinity expects a CPU list such as 0-3,8, not \"" + *it + "\"; ignored");
+                worker_cpus_.clear();
+            }
+        } else if (*it == "--reserve-core") {
+            ++it;
+            reserved_cpu_ = std::stoi(*it);
+        } else if (*it == "--first-touch") {
+            first_touch_ = true;
+        } else if (*it == "--epoch-barrier") {
+            use_epoch_barrier_ = true;
+        } else if (*it == "--handoff-bench") {
+            run_handoff_bench_ = true;
+        } else if (*it == "--gpu-budget") {
+            ++it;
+            gpu_budget_ms_ = std::stof(*it);
+        } else if (*it == "--worker-stats") {
+            print_worker_stats_ = true;
+        } else if (*it == "--coherent") {
+            force_coherent_ = true;
+        } else if (*it == "--mem-bench") {
+            run_mem_bench_ = true;
+        } else if (*it == "--mesh-dir") {
+            ++it;
+            mesh_dir_ = *it;
+        } else if (*it == "--icosphere-level") {
+            ++it;
+            icosphere_level_ = std::max(0, std::min(std::stoi(*it), Icosphere::max_level));
+        } else if (*it == "--icosphere-bench") {
+            run_icosphere_bench_ = true;
+        }
     }
 
+    if (mesh_dir_.empty()) mesh_dir_ = find_mesh_dir((args.empty()) ? std::string() : args.front());
+
+    sim_.set_interpolation(interpolate_);
+
     init_workers();
 }
 
 Hologram::~Hologram() {}
 
 void Hologram::init_workers() {
-    int worker_count = std::thread::hardware_concurrency();
+    int worker_count = settings_.worker_count;
+    if (worker_count <= 0) worker_count = std::thread::hardware_concurrency();
 
     // not enough cores
     if (!multithread_ || worker_count < 2) {
@@ -88,6 +276,21 @@ void Hologram::init_workers() {
         Worker *worker = new Worker(*this, i, object_begin, object_end);
         workers_.emplace_back(std::unique_ptr<Worker>(worker));
     }
+
+    // pin workers round-robin to the chosen CPUs, keeping off the reserved one
+    if (reserved_cpu_ >= 0 && worker_cpus_.empty()) {
+        for (int cpu = 0; cpu < static_cast<int>(std::thread::hardware_concurrency()); cpu++) worker_cpus_.push_back(cpu);
+    }
+    worker_cpus_.erase(std::remove(worker_cpus_.begin(), worker_cpus_.end(), reserved_cpu_), worker_cpus_.end());
+    if (multithread_ && !worker_cpus_.empty()) {
+        for (size_t i = 0; i < workers_.size(); i++) workers_[i]->cpu_ = worker_cpus_[i % worker_cpus_.size()];
+    }
+
+    if (multithread_ && use_epoch_barrier_) epoch_barrier_.reset(new EpochBarrier(worker_count));
+
+    // starts from the same ranges
+    if (balance_warmup_frames_ && worker_count > 1)
+        partitioner_.reset(new Partitioner(static_cast<int>(sim_.objects().size()), worker_count));
 }
 
 void Hologram::attach_shell(Shell &sh) {
@@ -98,6 +301,8 @@ void Hologram::attach_shell(Shell &sh) {
     dev_ = ctx.dev;
     queue_ = ctx.game_queue;
     queue_family_ = ctx.game_queue_family;
+    transfer_queue_ = ctx.transfer_queue;
+    transfer_queue_family_ = ctx.transfer_queue_family;
     format_ = ctx.format.format;
 
     vk::GetPhysicalDeviceProperties(physical_dev_, &physical_dev_props_);
@@ -107,12 +312,113 @@ void Hologram::attach_shell(Shell &sh) {
         use_push_constants_ = false;
     }
 
+    if (use_gpu_sim_) {
+        std::vector<VkQueueFamilyProperties> queue_props;
+        vk::get(physical_dev_, queue_props);
+
+        if (!(queue_props[queue_family_].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+            shell_->log(Shell::LOG_WARN, "cannot enable GPU simulation");
+            use_gpu_sim_ = false;
+        } else {
+            // objects are not drawn with ShaderParamBlocks
+            use_push_constants_ = false;
+        }
+    }
+
+    if (use_fused_ && !use_frame_data_buffers()) {
+        shell_->log(Shell::LOG_WARN, "cannot enable fused simulation without frame data buffers");
+        use_fused_ = false;
+    }
+
+    if (sim_lod_ && (use_gpu_sim_ || use_fused_)) {
+        shell_->log(Shell::LOG_WARN, "simulation LOD applies only to the CPU simulation without --fused");
+        sim_lod_ = false;
+    }
+
+    if (use_meshlets_ && (use_gpu_sim_ || use_fused_)) {
+        shell_->log(Shell::LOG_WARN, "meshlet culling applies only to the CPU simulation without --fused");
+        use_meshlets_ = false;
+    }
+
+    if (use_bvh_ && (use_gpu_sim_ || use_fused_)) {
+        shell_->log(Shell::LOG_WARN, "BVH culling applies only to the CPU simulation without --fused");
+        use_bvh_ = false;
+    }
+    if (use_bvh_) object_visible_.assign(sim_.objects().size(), 1);
+
+    if (stage_frame_data_ && !use_frame_data_buffers()) {
+        shell_->log(Shell::LOG_WARN, "cannot stage frame data without frame data buffers");
+        stage_frame_data_ = false;
+    }
+    if (!stage_frame_data_) {
+        transfer_queue_ = VK_NULL_HANDLE;
+    } else if (transfer_queue_ == VK_NULL_HANDLE) {
+        shell_->log(Shell::LOG_INFO, "no transfer-only queue family; frame data is copied on the game queue");
+    }
+
     VkPhysicalDeviceMemoryProperties mem_props;
     vk::GetPhysicalDeviceMemoryProperties(physical_dev_, &mem_props);
     mem_flags_.reserve(mem_props.memoryTypeCount);
-    for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++) mem_flags_.push_back(mem_props.memoryTypes[i].propertyFlags);
+    mem_heap_sizes_.reserve(mem_props.memoryTypeCount);
+    for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++) {
+        mem_flags_.push_back(mem_props.memoryTypes[i].propertyFlags);
+        mem_heap_sizes_.push_back(mem_props.memoryHeaps[mem_props.memoryTypes[i].heapIndex].size);
+    }
+
+    if (check_gpu_sim_ && use_gpu_sim_) {
+        // 10 seconds of simulation
+        GpuSimulationCheck check(dev_, queue_, queue_family_, mem_flags_);
+        if (!check.run(*shell_, scene_, 1.0f / settings_.ticks_per_second, 10 * settings_.ticks_per_second))
+            throw std::runtime_error("the GPU simulation does not match the CPU simulation");
+    }
+
+    if (run_handoff_bench_) {
+        HandoffBenchmark bench(2000);
+        bench.run(*shell_, {2, 4, 8, 16, 32, 64});
+    }
+
+    if (run_mem_bench_) {
+        MemoryBenchmark bench(dev_, mem_flags_);
+        const VkDeviceSize alignment = physical_dev_props_.limits.minUniformBufferOffsetAlignment;
+        bench.run(*shell_, object_data_size(), (object_data_size() + alignment - 1) / alignment * alignment);
+    }
+
+    if (run_icosphere_bench_) {
+        IcosphereBenchmark bench(static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)));
+        bench.run(*shell_, Icosphere::max_level);
+    }
+
+    if (!settings_.scene_file.empty()) {
+        std::stringstream ss;
+        ss << settings_.scene_file << ": " << scene_.object_count() << " objects in " << scene_.groups().size() << " groups";
+        if (scene_.has_seed()) ss << ", seed " << scene_.seed();
+        shell_->log(Shell::LOG_INFO, ss.str().c_str());
+    }
+
+    meshes_ = new Meshes(dev_, mem_flags_, mesh_dir_, icosphere_level_, scene_.mesh_files(), use_meshlets_);
+    if (use_meshlets_) {
+        std::stringstream ss;
+        ss << meshes_->meshlet_count() << " meshlets in " << meshes_->mesh_count() << " meshes";
+        if (cull_back_faces_) ss << "; meshlets facing away are not drawn";
+        shell_->log(Shell::LOG_INFO, ss.str().c_str());
+    }
+    for (size_t i = 0; i < meshes_->load_stats().size(); i++) {
+        const auto &stats = meshes_->load_stats()[i];
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        ss << scene_.mesh_files()[i] << ": " << stats.vertex_count << " vertices, " << stats.face_count << " faces from "
+           << stats.corner_count / 3 << " triangles; parse " << stats.parse_ms << " ms, weld " << stats.weld_ms << " ms, normals "
+           << stats.normal_ms << " ms";
+        shell_->log(Shell::LOG_INFO, ss.str().c_str());
+    }
+    if (use_gpu_sim_) gpu_sim_ = new GpuSimulation(dev_, queue_, queue_family_, mem_flags_, sim_);
 
-    meshes_ = new Meshes(dev_, mem_flags_);
+    if (dynamic_res_ && !init_dynamic_resolution()) dynamic_res_ = false;
+
+    // the main thread records the primary command buffer and submits
+    if (reserved_cpu_ >= 0 && !placement::pin_current_thread(reserved_cpu_))
+        shell_->log(Shell::LOG_WARN, "cannot pin the main thread to the reserved core");
 
     create_render_pass();
     create_shader_modules();
@@ -130,12 +436,15 @@ void Hologram::attach_shell(Shell &sh) {
     primary_cmd_begin_info_.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     primary_cmd_begin_info_.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    // we will render to the swapchain images
-    primary_cmd_submit_wait_stages_ = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // we will render or blit to the swapchain images
+    primary_cmd_submit_wait_stages_[0] =
+        (dynamic_res_) ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // and read the frame data uploaded on the transfer queue
+    primary_cmd_submit_wait_stages_[1] = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
 
     primary_cmd_submit_info_.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    primary_cmd_submit_info_.waitSemaphoreCount = 1;
-    primary_cmd_submit_info_.pWaitDstStageMask = &primary_cmd_submit_wait_stages_;
+    primary_cmd_submit_info_.waitSemaphoreCount = (transfer_queue_ != VK_NULL_HANDLE) ? 2 : 1;
+    primary_cmd_submit_info_.pWaitDstStageMask = primary_cmd_submit_wait_stages_.data();
     primary_cmd_submit_info_.commandBufferCount = 1;
     primary_cmd_submit_info_.signalSemaphoreCount = 1;
 
@@ -146,23 +455,111 @@ void Hologram::attach_shell(Shell &sh) {
 
 void Hologram::detach_shell() {
     if (multithread_) {
+        if (epoch_barrier_) {
+            epoch_barrier_->publish(WORKER_EXIT);
+            epoch_barrier_->wait_done();
+        }
+
         for (auto &worker : workers_) worker->stop();
     }
 
+    if (partitioner_ && imbalance_after_ > 0.0) {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(3);
+        ss << "worker imbalance (max/mean busy time): " << imbalance_before_ << " before balancing, " << imbalance_after_
+           << " after";
+        shell_->log(Shell::LOG_INFO, ss.str().c_str());
+    }
+
+    if (sim_lod_) {
+        int reduced = 0;
+        for (const auto &worker : workers_) reduced += worker->lod_reduced_;
+
+        std::stringstream ss;
+        ss << reduced << " of " << sim_.objects().size() << " objects at the reduced simulation rate on the last frame";
+        shell_->log(Shell::LOG_INFO, ss.str().c_str());
+    }
+
+    if (use_meshlets_) {
+        uint64_t culled = 0;
+        for (const auto &worker : workers_) culled += worker->meshlets_culled_;
+
+        std::stringstream ss;
+        ss << culled << " meshlets culled on the last frame";
+        shell_->log(Shell::LOG_INFO, ss.str().c_str());
+    }
+
+    if (use_bvh_) {
+        double refit_ms = 0.0, rebuild_ms = 0.0;
+        uint64_t rebuilds = 0;
+        uint32_t visited = 0, culled = 0;
+        for (const auto &worker : workers_) {
+            const auto stats = worker->stats();
+            refit_ms += stats.bvh_refit_ms;
+            rebuild_ms += stats.bvh_rebuild_ms;
+            rebuilds += stats.bvh_rebuilds;
+            visited += worker->bvh_nodes_visited_;
+            culled += worker->objects_culled_;
+        }
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        ss << "BVH: refit " << refit_ms << " ms, " << rebuilds << " builds " << rebuild_ms << " ms; " << visited
+           << " nodes visited and " << culled << " of " << sim_.objects().size() << " objects culled on the last frame";
+        shell_->log(Shell::LOG_INFO, ss.str().c_str());
+    }
+
     destroy_frame_data();
 
     vk::DestroyPipeline(dev_, pipeline_, nullptr);
     vk::DestroyPipelineLayout(dev_, pipeline_layout_, nullptr);
-    if (!use_push_constants_) vk::DestroyDescriptorSetLayout(dev_, desc_set_layout_, nullptr);
+    if (use_frame_data_buffers()) vk::DestroyDescriptorSetLayout(dev_, desc_set_layout_, nullptr);
     vk::DestroyShaderModule(dev_, fs_, nullptr);
     vk::DestroyShaderModule(dev_, vs_, nullptr);
     vk::DestroyRenderPass(dev_, render_pass_, nullptr);
 
+    delete gpu_sim_;
+    gpu_sim_ = nullptr;
     delete meshes_;
 
     Game::detach_shell();
 }
 
+bool Hologram::init_dynamic_resolution() {
+    VkSurfaceCapabilitiesKHR caps;
+    vk::assert_success(vk::GetPhysicalDeviceSurfaceCapabilitiesKHR(physical_dev_, shell_->context().surface, &caps));
+    if (!(caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        shell_->log(Shell::LOG_WARN, "cannot enable dynamic resolution: cannot blit to swapchain images");
+        return false;
+    }
+
+    VkFormatProperties format_props;
+    vk::GetPhysicalDeviceFormatProperties(physical_dev_, format_, &format_props);
+    const VkFormatFeatureFlags blit_features =
+        VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if ((format_props.optimalTilingFeatures & blit_features) != blit_features) {
+        shell_->log(Shell::LOG_WARN, "cannot enable dynamic resolution: surface format cannot be blitted");
+        return false;
+    }
+
+    blit_filter_ = (format_props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR
+                                                                                                           : VK_FILTER_NEAREST;
+
+    std::vector<VkQueueFamilyProperties> queue_props;
+    vk::get(physical_dev_, queue_props);
+
+    const uint32_t valid_bits = queue_props[queue_family_].timestampValidBits;
+    if (!valid_bits) {
+        shell_->log(Shell::LOG_WARN, "cannot enable dynamic resolution: no timestamp support");
+        return false;
+    }
+
+    timestamp_period_ = physical_dev_props_.limits.timestampPeriod;
+    timestamp_mask_ = (valid_bits >= 64) ? UINT64_MAX : (uint64_t(1) << valid_bits) - 1;
+
+    return true;
+}
+
 void Hologram::create_render_pass() {
     VkAttachmentDescription attachment = {};
     attachment.format = format_;
@@ -170,7 +567,8 @@ void Hologram::create_render_pass() {
     attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // the offscreen target is blitted to the back buffer afterwards
+    attachment.finalLayout = (dynamic_res_) ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference attachment_ref = {};
     attachment_ref.attachment = 0;
@@ -191,14 +589,35 @@ void Hologram::create_render_pass() {
     subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     subpass_dependency.dependencyFlags = 0;
 
+    std::array<VkSubpassDependency, 2> offscreen_dependencies;
+    if (dynamic_res_) {
+        // wait for the previous frame's blit to finish reading the offscreen target
+        offscreen_dependencies[0] = subpass_dependency;
+        offscreen_dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+        // make the rendering visible to the blit
+        offscreen_dependencies[1] = subpass_dependency;
+        offscreen_dependencies[1].srcSubpass = 0;
+        offscreen_dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        offscreen_dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        offscreen_dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        offscreen_dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        offscreen_dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    }
+
     VkRenderPassCreateInfo render_pass_info = {};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     render_pass_info.attachmentCount = 1;
     render_pass_info.pAttachments = &attachment;
     render_pass_info.subpassCount = 1;
     render_pass_info.pSubpasses = &subpass;
-    render_pass_info.dependencyCount = 1;
-    render_pass_info.pDependencies = &subpass_dependency;
+    if (dynamic_res_) {
+        render_pass_info.dependencyCount = static_cast<uint32_t>(offscreen_dependencies.size());
+        render_pass_info.pDependencies = offscreen_dependencies.data();
+    } else {
+        render_pass_info.dependencyCount = 1;
+        render_pass_info.pDependencies = &subpass_dependency;
+    }
 
     vk::assert_success(vk::CreateRenderPass(dev_, &render_pass_info, nullptr, &render_pass_));
 }
@@ -206,7 +625,19 @@ void Hologram::create_render_pass() {
 void Hologram::create_shader_modules() {
     VkShaderModuleCreateInfo sh_info = {};
     sh_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    if (use_push_constants_) {
+    if (use_gpu_sim_) {
+#ifndef __ANDROID__  // never set on Android
+#include "Hologram.gpu_sim.vert.h"
+        sh_info.codeSize = sizeof(Hologram_gpu_sim_vert);
+        sh_info.pCode = Hologram_gpu_sim_vert;
+#endif
+    } else if (use_fused_) {
+#ifndef __ANDROID__  // never set on Android
+#include "Hologram.fused.vert.h"
+        sh_info.codeSize = sizeof(Hologram_fused_vert);
+        sh_info.pCode = Hologram_fused_vert;
+#endif
+    } else if (use_push_constants_) {
 #include "Hologram.push_constant.vert.h"
         sh_info.codeSize = sizeof(Hologram_push_constant_vert);
         sh_info.pCode = Hologram_push_constant_vert;
@@ -224,7 +655,7 @@ void Hologram::create_shader_modules() {
 }
 
 void Hologram::create_descriptor_set_layout() {
-    if (use_push_constants_) return;
+    if (!use_frame_data_buffers()) return;
 
     VkDescriptorSetLayoutBinding layout_binding = {};
     layout_binding.binding = 0;
@@ -246,7 +677,18 @@ void Hologram::create_pipeline_layout() {
     VkPipelineLayoutCreateInfo pipeline_layout_info = {};
     pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 
-    if (use_push_constants_) {
+    VkDescriptorSetLayout gpu_sim_set_layout;
+    if (use_gpu_sim_) {
+        push_const_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        push_const_range.offset = 0;
+        push_const_range.size = sizeof(GpuSimParamBlock);
+
+        gpu_sim_set_layout = gpu_sim_->object_set_layout();
+        pipeline_layout_info.setLayoutCount = 1;
+        pipeline_layout_info.pSetLayouts = &gpu_sim_set_layout;
+        pipeline_layout_info.pushConstantRangeCount = 1;
+        pipeline_layout_info.pPushConstantRanges = &push_const_range;
+    } else if (use_push_constants_) {
         push_const_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
         push_const_range.offset = 0;
         push_const_range.size = sizeof(ShaderParamBlock);
@@ -256,6 +698,15 @@ void Hologram::create_pipeline_layout() {
     } else {
         pipeline_layout_info.setLayoutCount = 1;
         pipeline_layout_info.pSetLayouts = &desc_set_layout_;
+
+        if (use_fused_) {
+            push_const_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+            push_const_range.offset = 0;
+            push_const_range.size = sizeof(FusedFrameBlock);
+
+            pipeline_layout_info.pushConstantRangeCount = 1;
+            pipeline_layout_info.pPushConstantRanges = &push_const_range;
+        }
     }
 
     vk::assert_success(vk::CreatePipelineLayout(dev_, &pipeline_layout_info, nullptr, &pipeline_layout_));
@@ -283,7 +734,9 @@ void Hologram::create_pipeline() {
     rast_info.depthClampEnable = false;
     rast_info.rasterizerDiscardEnable = false;
     rast_info.polygonMode = VK_POLYGON_MODE_FILL;
-    rast_info.cullMode = VK_CULL_MODE_NONE;
+    // the meshlet cone test skips whole meshlets facing away, so it is only
+    // done when back faces are culled here too
+    rast_info.cullMode = (cull_back_faces_) ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
     rast_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
     rast_info.depthBiasEnable = false;
     rast_info.lineWidth = 1.0f;
@@ -344,23 +797,47 @@ void Hologram::create_frame_data(int count) {
     create_fences();
     create_command_buffers();
 
-    if (!use_push_constants_) {
+    if (use_frame_data_buffers()) {
         create_buffers();
         create_buffer_memory();
+        if (stage_frame_data_) create_device_buffers();
         create_descriptor_sets();
     }
 
+    if (transfer_queue_ != VK_NULL_HANDLE) create_transfer_commands();
+
+    if (dynamic_res_) create_query_pool();
+
     frame_data_index_ = 0;
 }
 
 void Hologram::destroy_frame_data() {
-    if (!use_push_constants_) {
+    if (dynamic_res_) vk::DestroyQueryPool(dev_, query_pool_, nullptr);
+
+    if (transfer_queue_ != VK_NULL_HANDLE) {
+        vk::DestroyCommandPool(dev_, transfer_cmd_pool_, nullptr);
+        for (auto &data : frame_data_) vk::DestroySemaphore(dev_, data.transfer_semaphore, nullptr);
+    }
+
+    if (use_frame_data_buffers()) {
         vk::DestroyDescriptorPool(dev_, desc_pool_, nullptr);
 
-        vk::UnmapMemory(dev_, frame_data_mem_);
-        vk::FreeMemory(dev_, frame_data_mem_, nullptr);
+        for (auto mem : frame_data_mems_) {
+            vk::UnmapMemory(dev_, mem);
+            vk::FreeMemory(dev_, mem, nullptr);
+        }
+        frame_data_mems_.clear();
+
+        for (auto &data : frame_data_) {
+            for (auto &chunk : data.chunks) {
+                vk::DestroyBuffer(dev_, chunk.buf, nullptr);
 
-        for (auto &data : frame_data_) vk::DestroyBuffer(dev_, data.buf, nullptr);
+                if (stage_frame_data_) {
+                    vk::DestroyBuffer(dev_, chunk.device_buf, nullptr);
+                    vk::FreeMemory(dev_, chunk.device_mem, nullptr);
+                }
+            }
+        }
     }
 
     for (auto cmd_pool : worker_cmd_pools_) vk::DestroyCommandPool(dev_, cmd_pool, nullptr);
@@ -426,72 +903,203 @@ void Hologram::create_buffers() {
     // align object data to device limit
     const VkDeviceSize &alignment = physical_dev_props_.limits.minUniformBufferOffsetAlignment;
 
-    aligned_object_data_size = sizeof(ShaderParamBlock);
+    aligned_object_data_size = object_data_size();
     if (aligned_object_data_size % alignment) aligned_object_data_size += alignment - (aligned_object_data_size % alignment);
 
+    // dynamic offsets are 32-bit
+    const VkDeviceSize max_chunk_size = std::min(max_allocation_size, static_cast<VkDeviceSize>(UINT32_MAX));
+    const VkDeviceSize object_count = sim_.objects().size();
+    objects_per_chunk_ =
+        static_cast<uint32_t>(std::max(VkDeviceSize(1), std::min(object_count, max_chunk_size / aligned_object_data_size)));
+    const size_t chunk_count = static_cast<size_t>((object_count + objects_per_chunk_ - 1) / objects_per_chunk_);
+
     // update simulation
     assert(aligned_object_data_size <= UINT32_MAX);
-    sim_.set_frame_data_size(static_cast<uint32_t>(aligned_object_data_size));
+    sim_.set_frame_data_size(static_cast<uint32_t>(aligned_object_data_size), objects_per_chunk_);
+
+    VkBufferCreateInfo buf_info = {};
+    buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buf_info.usage = (stage_frame_data_) ? VK_BUFFER_USAGE_TRANSFER_SRC_BIT : VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    for (auto &data : frame_data_) {
+        data.chunks.resize(chunk_count);
+
+        for (size_t i = 0; i < chunk_count; i++) {
+            const VkDeviceSize first = i * objects_per_chunk_;
+            const VkDeviceSize count = std::min(object_count - first, static_cast<VkDeviceSize>(objects_per_chunk_));
+
+            buf_info.size = aligned_object_data_size * count;
+            vk::assert_success(vk::CreateBuffer(dev_, &buf_info, nullptr, &data.chunks[i].buf));
+            data.chunks[i].size = buf_info.size;
+        }
+    }
+}
 
+void Hologram::create_device_buffers() {
     VkBufferCreateInfo buf_info = {};
     buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    buf_info.size = aligned_object_data_size * sim_.objects().size();
-    buf_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    buf_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
     buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    for (auto &data : frame_data_) vk::assert_success(vk::CreateBuffer(dev_, &buf_info, nullptr, &data.buf));
+    VkMemoryAllocateInfo mem_info = {};
+    mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+
+    // there are only a few chunks; give each its own allocation
+    for (auto &data : frame_data_) {
+        for (auto &chunk : data.chunks) {
+            buf_info.size = chunk.size;
+            vk::assert_success(vk::CreateBuffer(dev_, &buf_info, nullptr, &chunk.device_buf));
+
+            VkMemoryRequirements mem_reqs;
+            vk::GetBufferMemoryRequirements(dev_, chunk.device_buf, &mem_reqs);
+
+            // prefer device-local memory; fall back to any supported type
+            mem_info.memoryTypeIndex = UINT32_MAX;
+            for (uint32_t idx = 0; idx < mem_flags_.size(); idx++) {
+                if (!(mem_reqs.memoryTypeBits & (1 << idx))) continue;
+
+                if (mem_info.memoryTypeIndex == UINT32_MAX) mem_info.memoryTypeIndex = idx;
+                if (mem_flags_[idx] & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+                    mem_info.memoryTypeIndex = idx;
+                    break;
+                }
+            }
+            mem_info.allocationSize = mem_reqs.size;
+
+            vk::assert_success(vk::AllocateMemory(dev_, &mem_info, nullptr, &chunk.device_mem));
+            vk::assert_success(vk::BindBufferMemory(dev_, chunk.device_buf, chunk.device_mem, 0));
+        }
+    }
+}
+
+void Hologram::create_transfer_commands() {
+    VkCommandPoolCreateInfo cmd_pool_info = {};
+    cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    cmd_pool_info.queueFamilyIndex = transfer_queue_family_;
+    vk::assert_success(vk::CreateCommandPool(dev_, &cmd_pool_info, nullptr, &transfer_cmd_pool_));
+
+    VkCommandBufferAllocateInfo cmd_info = {};
+    cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmd_info.commandPool = transfer_cmd_pool_;
+    cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_info.commandBufferCount = 1;
+
+    VkSemaphoreCreateInfo sem_info = {};
+    sem_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    for (auto &data : frame_data_) {
+        vk::assert_success(vk::AllocateCommandBuffers(dev_, &cmd_info, &data.transfer_cmd));
+        vk::assert_success(vk::CreateSemaphore(dev_, &sem_info, nullptr, &data.transfer_semaphore));
+    }
 }
 
 void Hologram::create_buffer_memory() {
-    VkMemoryRequirements mem_reqs;
-    vk::GetBufferMemoryRequirements(dev_, frame_data_[0].buf, &mem_reqs);
+    // all chunks of all frames, in order
+    std::vector<FrameData::Chunk *> chunks;
+    for (auto &data : frame_data_) {
+        for (auto &chunk : data.chunks) chunks.push_back(&chunk);
+    }
 
-    VkDeviceSize aligned_size = mem_reqs.size;
-    if (aligned_size % mem_reqs.alignment) aligned_size += mem_reqs.alignment - (aligned_size % mem_reqs.alignment);
+    std::vector<VkMemoryRequirements> mem_reqs(chunks.size());
+    uint32_t mem_types = UINT32_MAX;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        vk::GetBufferMemoryRequirements(dev_, chunks[i]->buf, &mem_reqs[i]);
+        mem_types &= mem_reqs[i].memoryTypeBits;
+    }
 
-    // allocate memory
     VkMemoryAllocateInfo mem_info = {};
     mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    mem_info.allocationSize = aligned_size * (frame_data_.size() - 1) + mem_reqs.size;
 
-    for (uint32_t idx = 0; idx < mem_flags_.size(); idx++) {
-        if ((mem_reqs.memoryTypeBits & (1 << idx)) && (mem_flags_[idx] & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
-            (mem_flags_[idx] & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
-            // TODO is this guaranteed to exist?
-            mem_info.memoryTypeIndex = idx;
-            break;
+    // Cached memory is written through the CPU caches instead of write
+    // combining, which is much faster for scattered writes on some devices,
+    // but it is not always coherent.  Fall back to coherent memory and then
+    // to any mappable memory.
+    const VkMemoryPropertyFlags preferred[] = {
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    };
+    bool found = false;
+    for (auto flags : preferred) {
+        if (force_coherent_) flags |= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+        for (uint32_t idx = 0; idx < mem_flags_.size() && !found; idx++) {
+            if ((mem_types & (1 << idx)) && (mem_flags_[idx] & flags) == flags) {
+                mem_info.memoryTypeIndex = idx;
+                found = true;
+            }
         }
+        if (found) break;
     }
+    if (!found) throw std::runtime_error("no mappable memory type for frame data");
+
+    frame_data_coherent_ = (mem_flags_[mem_info.memoryTypeIndex] & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    if (!frame_data_coherent_) shell_->log(Shell::LOG_INFO, "frame data is in non-coherent memory");
+
+    const VkDeviceSize allocation_limit = std::min(max_allocation_size, mem_heap_sizes_[mem_info.memoryTypeIndex] / 2);
 
-    vk::AllocateMemory(dev_, &mem_info, nullptr, &frame_data_mem_);
+    // pack consecutive chunks into allocations no larger than the limit
+    size_t first = 0;
+    while (first < chunks.size()) {
+        std::vector<VkDeviceSize> offsets;
+        VkDeviceSize size = 0;
+        size_t last = first;
+        for (; last < chunks.size(); last++) {
+            const auto &reqs = mem_reqs[last];
 
-    void *ptr;
-    vk::MapMemory(dev_, frame_data_mem_, 0, VK_WHOLE_SIZE, 0, &ptr);
+            VkDeviceSize offset = size;
+            if (offset % reqs.alignment) offset += reqs.alignment - (offset % reqs.alignment);
+            if (last > first && offset + reqs.size > allocation_limit) break;
+
+            offsets.push_back(offset);
+            size = offset + reqs.size;
+        }
+
+        mem_info.allocationSize = size;
+
+        VkDeviceMemory mem;
+        vk::assert_success(vk::AllocateMemory(dev_, &mem_info, nullptr, &mem));
+        frame_data_mems_.push_back(mem);
+
+        void *ptr;
+        vk::assert_success(vk::MapMemory(dev_, mem, 0, VK_WHOLE_SIZE, 0, &ptr));
+
+        for (size_t i = first; i < last; i++) {
+            vk::assert_success(vk::BindBufferMemory(dev_, chunks[i]->buf, mem, offsets[i - first]));
+            chunks[i]->base = reinterpret_cast<uint8_t *>(ptr) + offsets[i - first];
+            chunks[i]->mem = mem;
+            chunks[i]->mem_offset = offsets[i - first];
+            chunks[i]->mem_size = size;
+        }
+
+        first = last;
+    }
 
-    VkDeviceSize offset = 0;
     for (auto &data : frame_data_) {
-        vk::BindBufferMemory(dev_, data.buf, frame_data_mem_, offset);
-        data.base = reinterpret_cast<uint8_t *>(ptr) + offset;
-        offset += aligned_size;
+        data.chunk_bases.clear();
+        for (const auto &chunk : data.chunks) data.chunk_bases.push_back(chunk.base);
     }
 }
 
 void Hologram::create_descriptor_sets() {
+    const uint32_t set_count = static_cast<uint32_t>(frame_data_.size() * frame_data_[0].chunks.size());
+
     VkDescriptorPoolSize desc_pool_size = {};
     desc_pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    assert(frame_data_.size() <= UINT32_MAX);
-    desc_pool_size.descriptorCount = static_cast<uint32_t>(frame_data_.size());
+    desc_pool_size.descriptorCount = set_count;
 
     VkDescriptorPoolCreateInfo desc_pool_info = {};
     desc_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    desc_pool_info.maxSets = static_cast<uint32_t>(frame_data_.size());
+    desc_pool_info.maxSets = set_count;
     desc_pool_info.poolSizeCount = 1;
     desc_pool_info.pPoolSizes = &desc_pool_size;
 
     // create descriptor pool
     vk::assert_success(vk::CreateDescriptorPool(dev_, &desc_pool_info, nullptr, &desc_pool_));
 
-    std::vector<VkDescriptorSetLayout> set_layouts(frame_data_.size(), desc_set_layout_);
+    std::vector<VkDescriptorSetLayout> set_layouts(set_count, desc_set_layout_);
     VkDescriptorSetAllocateInfo set_info = {};
     set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     set_info.descriptorPool = desc_pool_;
@@ -499,47 +1107,65 @@ void Hologram::create_descriptor_sets() {
     set_info.pSetLayouts = set_layouts.data();
 
     // create descriptor sets
-    std::vector<VkDescriptorSet> desc_sets(frame_data_.size(), VK_NULL_HANDLE);
+    std::vector<VkDescriptorSet> desc_sets(set_count, VK_NULL_HANDLE);
     vk::assert_success(vk::AllocateDescriptorSets(dev_, &set_info, desc_sets.data()));
 
-    std::vector<VkDescriptorBufferInfo> desc_bufs(frame_data_.size());
-    std::vector<VkWriteDescriptorSet> desc_writes(frame_data_.size());
+    std::vector<VkDescriptorBufferInfo> desc_bufs(set_count);
+    std::vector<VkWriteDescriptorSet> desc_writes(set_count);
 
-    for (size_t i = 0; i < frame_data_.size(); i++) {
-        auto &data = frame_data_[i];
-
-        data.desc_set = desc_sets[i];
-
-        VkDescriptorBufferInfo desc_buf = {};
-        desc_buf.buffer = data.buf;
-        desc_buf.offset = 0;
-        desc_buf.range = VK_WHOLE_SIZE;
-        desc_bufs[i] = desc_buf;
-
-        VkWriteDescriptorSet desc_write = {};
-        desc_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        desc_write.dstSet = data.desc_set;
-        desc_write.dstBinding = 0;
-        desc_write.dstArrayElement = 0;
-        desc_write.descriptorCount = 1;
-        desc_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-        desc_write.pBufferInfo = &desc_bufs[i];
-        desc_writes[i] = desc_write;
+    size_t i = 0;
+    for (auto &data : frame_data_) {
+        for (auto &chunk : data.chunks) {
+            chunk.desc_set = desc_sets[i];
+
+            // the dynamic offset selects the object; the range is a single
+            // block so that it stays within maxUniformBufferRange
+            VkDescriptorBufferInfo desc_buf = {};
+            desc_buf.buffer = (stage_frame_data_) ? chunk.device_buf : chunk.buf;
+            desc_buf.offset = 0;
+            desc_buf.range = object_data_size();
+            desc_bufs[i] = desc_buf;
+
+            VkWriteDescriptorSet desc_write = {};
+            desc_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            desc_write.dstSet = chunk.desc_set;
+            desc_write.dstBinding = 0;
+            desc_write.dstArrayElement = 0;
+            desc_write.descriptorCount = 1;
+            desc_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            desc_write.pBufferInfo = &desc_bufs[i];
+            desc_writes[i] = desc_write;
+
+            i++;
+        }
     }
 
     vk::UpdateDescriptorSets(dev_, static_cast<uint32_t>(desc_writes.size()), desc_writes.data(), 0, nullptr);
 }
 
+void Hologram::create_query_pool() {
+    // a begin and an end timestamp per frame
+    VkQueryPoolCreateInfo query_pool_info = {};
+    query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_info.queryCount = static_cast<uint32_t>(2 * frame_data_.size());
+
+    vk::assert_success(vk::CreateQueryPool(dev_, &query_pool_info, nullptr, &query_pool_));
+}
+
 void Hologram::attach_swapchain() {
     const Shell::Context &ctx = shell_->context();
 
     prepare_viewport(ctx.extent);
     prepare_framebuffers(ctx.swapchain);
+    if (dynamic_res_) create_offscreen_target();
 
     update_camera();
 }
 
 void Hologram::detach_swapchain() {
+    if (dynamic_res_) destroy_offscreen_target();
+
     for (auto fb : framebuffers_) vk::DestroyFramebuffer(dev_, fb, nullptr);
     for (auto view : image_views_) vk::DestroyImageView(dev_, view, nullptr);
 
@@ -551,15 +1177,26 @@ void Hologram::detach_swapchain() {
 void Hologram::prepare_viewport(const VkExtent2D &extent) {
     extent_ = extent;
 
+    update_render_extent();
+}
+
+void Hologram::update_render_extent() {
+    render_extent_ = extent_;
+    if (dynamic_res_) {
+        render_extent_.width = std::max(1u, static_cast<uint32_t>(extent_.width * render_scale_ + 0.5f));
+        render_extent_.height = std::max(1u, static_cast<uint32_t>(extent_.height * render_scale_ + 0.5f));
+    }
+
+    // the aspect ratio is unchanged, so is the camera
     viewport_.x = 0.0f;
     viewport_.y = 0.0f;
-    viewport_.width = static_cast<float>(extent.width);
-    viewport_.height = static_cast<float>(extent.height);
+    viewport_.width = static_cast<float>(render_extent_.width);
+    viewport_.height = static_cast<float>(render_extent_.height);
     viewport_.minDepth = 0.0f;
     viewport_.maxDepth = 1.0f;
 
     scissor_.offset = {0, 0};
-    scissor_.extent = extent_;
+    scissor_.extent = render_extent_;
 }
 
 void Hologram::prepare_framebuffers(VkSwapchainKHR swapchain) {
@@ -598,6 +1235,76 @@ void Hologram::prepare_framebuffers(VkSwapchainKHR swapchain) {
     }
 }
 
+void Hologram::create_offscreen_target() {
+    VkImageCreateInfo img_info = {};
+    img_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    img_info.imageType = VK_IMAGE_TYPE_2D;
+    img_info.format = format_;
+    img_info.extent.width = extent_.width;
+    img_info.extent.height = extent_.height;
+    img_info.extent.depth = 1;
+    img_info.mipLevels = 1;
+    img_info.arrayLayers = 1;
+    img_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    img_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    img_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    img_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    img_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    vk::assert_success(vk::CreateImage(dev_, &img_info, nullptr, &offscreen_image_));
+
+    VkMemoryRequirements mem_reqs;
+    vk::GetImageMemoryRequirements(dev_, offscreen_image_, &mem_reqs);
+
+    VkMemoryAllocateInfo mem_info = {};
+    mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mem_info.allocationSize = mem_reqs.size;
+
+    // prefer device local memory
+    mem_info.memoryTypeIndex = UINT32_MAX;
+    for (uint32_t idx = 0; idx < mem_flags_.size(); idx++) {
+        if (!(mem_reqs.memoryTypeBits & (1 << idx))) continue;
+
+        if (mem_flags_[idx] & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+            mem_info.memoryTypeIndex = idx;
+            break;
+        }
+        if (mem_info.memoryTypeIndex == UINT32_MAX) mem_info.memoryTypeIndex = idx;
+    }
+
+    vk::assert_success(vk::AllocateMemory(dev_, &mem_info, nullptr, &offscreen_mem_));
+    vk::assert_success(vk::BindImageMemory(dev_, offscreen_image_, offscreen_mem_, 0));
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = offscreen_image_;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format_;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.layerCount = 1;
+
+    vk::assert_success(vk::CreateImageView(dev_, &view_info, nullptr, &offscreen_view_));
+
+    VkFramebufferCreateInfo fb_info = {};
+    fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    fb_info.renderPass = render_pass_;
+    fb_info.attachmentCount = 1;
+    fb_info.pAttachments = &offscreen_view_;
+    fb_info.width = extent_.width;
+    fb_info.height = extent_.height;
+    fb_info.layers = 1;
+
+    vk::assert_success(vk::CreateFramebuffer(dev_, &fb_info, nullptr, &offscreen_fb_));
+}
+
+void Hologram::destroy_offscreen_target() {
+    vk::DestroyFramebuffer(dev_, offscreen_fb_, nullptr);
+    vk::DestroyImageView(dev_, offscreen_view_, nullptr);
+    vk::DestroyImage(dev_, offscreen_image_, nullptr);
+    vk::FreeMemory(dev_, offscreen_mem_, nullptr);
+}
+
 void Hologram::update_camera() {
     const glm::vec3 center(0.0f);
     const glm::vec3 up(0.f, 0.0f, 1.0f);
@@ -610,35 +1317,221 @@ void Hologram::update_camera() {
     const glm::mat4 clip(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.5f, 1.0f);
 
     camera_.view_projection = clip * projection * view;
+    camera_.pixel_scale = projection[1][1] * static_cast<float>(extent_.height) * 0.5f;
+    camera_.frustum = Frustum(camera_.view_projection);
 }
 
-void Hologram::draw_object(const Simulation::Object &obj, FrameData &data, VkCommandBuffer cmd) const {
+uint32_t Hologram::draw_object(const Simulation::Object &obj, FrameData &data, VkCommandBuffer cmd) const {
+    const glm::mat4 model = (interpolate_) ? sim_.interpolated_model(obj, frame_pred_) : obj.model;
+
     if (use_push_constants_) {
         ShaderParamBlock params;
         memcpy(params.light_pos, glm::value_ptr(obj.light_pos), sizeof(obj.light_pos));
         memcpy(params.light_color, glm::value_ptr(obj.light_color), sizeof(obj.light_color));
-        memcpy(params.model, glm::value_ptr(obj.model), sizeof(obj.model));
+        memcpy(params.model, glm::value_ptr(model), sizeof(model));
         memcpy(params.view_projection, glm::value_ptr(camera_.view_projection), sizeof(camera_.view_projection));
         params.alpha = sim_fade_ ? obj.alpha : 0.5f;
 
         vk::CmdPushConstants(cmd, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(params), &params);
     } else {
-        ShaderParamBlock *params = reinterpret_cast<ShaderParamBlock *>(data.base + obj.frame_data_offset);
+        const auto &chunk = data.chunks[obj.frame_data_chunk];
+
+        ShaderParamBlock *params = reinterpret_cast<ShaderParamBlock *>(chunk.base + obj.frame_data_offset);
         memcpy(params->light_pos, glm::value_ptr(obj.light_pos), sizeof(obj.light_pos));
         memcpy(params->light_color, glm::value_ptr(obj.light_color), sizeof(obj.light_color));
-        memcpy(params->model, glm::value_ptr(obj.model), sizeof(obj.model));
+        memcpy(params->model, glm::value_ptr(model), sizeof(model));
         memcpy(params->view_projection, glm::value_ptr(camera_.view_projection), sizeof(camera_.view_projection));
         params->alpha = sim_fade_ ? obj.alpha : 0.5f;
 
-        vk::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &data.desc_set, 1,
+        vk::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &chunk.desc_set, 1,
                                   &obj.frame_data_offset);
     }
 
+    if (use_meshlets_) return meshes_->cmd_draw_visible(cmd, obj.mesh, model, camera_.frustum, camera_.eye_pos, cull_back_faces_);
+
     meshes_->cmd_draw(cmd, obj.mesh);
+    return 0;
+}
+
+void Hologram::update_render_scale(const FrameData &data) {
+    const uint32_t query = static_cast<uint32_t>(2 * (&data - frame_data_.data()));
+
+    // the frame fence has signaled, so the results are available
+    uint64_t timestamps[2];
+    if (vk::GetQueryPoolResults(dev_, query_pool_, query, 2, sizeof(timestamps), timestamps, sizeof(timestamps[0]),
+                                VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
+
+    const uint64_t ticks = (timestamps[1] - timestamps[0]) & timestamp_mask_;
+    const float gpu_ms = static_cast<float>(ticks) * timestamp_period_ / 1000000.0f;
+
+    // smooth out single-frame spikes
+    gpu_time_ms_ = (gpu_time_ms_ > 0.0f) ? gpu_time_ms_ * 0.9f + gpu_ms * 0.1f : gpu_ms;
+    if (gpu_time_ms_ <= 0.0f) return;
+
+    // leave some headroom and do not chase small changes
+    const float ratio = gpu_budget_ms_ / gpu_time_ms_;
+    if (ratio >= 0.9f && ratio <= 1.2f) return;
+
+    // GPU time is roughly proportional to the pixel count; move at most 10%
+    // per frame so that the smoothed time has a chance to catch up
+    float scale = render_scale_ * std::sqrt(ratio * 0.95f);
+    scale = std::min(std::max(scale, render_scale_ * 0.9f), render_scale_ * 1.1f);
+    scale = std::min(std::max(scale, min_render_scale), 1.0f);
+
+    if (scale == render_scale_) return;
+
+    render_scale_ = scale;
+    update_render_extent();
+}
+
+void Hologram::cmd_blit_offscreen(VkCommandBuffer cmd, VkImage dst) const {
+    VkImageMemoryBarrier img_barrier = {};
+    img_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    img_barrier.srcAccessMask = 0;
+    img_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    img_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    img_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    img_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    img_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    img_barrier.image = dst;
+    img_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    img_barrier.subresourceRange.levelCount = 1;
+    img_barrier.subresourceRange.layerCount = 1;
+    // the acquire semaphore is waited at the transfer stage
+    vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                           &img_barrier);
+
+    VkImageBlit blit = {};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[1].x = static_cast<int32_t>(render_extent_.width);
+    blit.srcOffsets[1].y = static_cast<int32_t>(render_extent_.height);
+    blit.srcOffsets[1].z = 1;
+    blit.dstSubresource = blit.srcSubresource;
+    blit.dstOffsets[1].x = static_cast<int32_t>(extent_.width);
+    blit.dstOffsets[1].y = static_cast<int32_t>(extent_.height);
+    blit.dstOffsets[1].z = 1;
+    vk::CmdBlitImage(cmd, offscreen_image_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                     blit_filter_);
+
+    img_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    img_barrier.dstAccessMask = 0;
+    img_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    img_barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                           &img_barrier);
 }
 
-void Hologram::update_simulation(const Worker &worker) {
-    sim_.update(worker.tick_interval_, worker.object_begin_, worker.object_end_);
+void Hologram::cmd_copy_frame_data(VkCommandBuffer cmd, const FrameData &data) const {
+    const bool release = (transfer_queue_ != VK_NULL_HANDLE);
+
+    // on the game queue, host writes must be made visible to the copies
+    if (!release) {
+        VkMemoryBarrier mem_barrier = {};
+        mem_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        mem_barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
+        mem_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &mem_barrier, 0, nullptr, 0,
+                               nullptr);
+    }
+
+    std::vector<VkBufferMemoryBarrier> buf_barriers;
+    buf_barriers.reserve(data.chunks.size());
+    for (const auto &chunk : data.chunks) {
+        VkBufferCopy region = {};
+        region.size = chunk.size;
+        vk::CmdCopyBuffer(cmd, chunk.buf, chunk.device_buf, 1, &region);
+
+        VkBufferMemoryBarrier buf_barrier = {};
+        buf_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        buf_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        buf_barrier.dstAccessMask = (release) ? 0 : VK_ACCESS_UNIFORM_READ_BIT;
+        buf_barrier.srcQueueFamilyIndex = (release) ? transfer_queue_family_ : VK_QUEUE_FAMILY_IGNORED;
+        buf_barrier.dstQueueFamilyIndex = (release) ? queue_family_ : VK_QUEUE_FAMILY_IGNORED;
+        buf_barrier.buffer = chunk.device_buf;
+        buf_barrier.offset = 0;
+        buf_barrier.size = VK_WHOLE_SIZE;
+        buf_barriers.push_back(buf_barrier);
+    }
+
+    // release to the game queue, or make the copies visible to the vertex shader
+    const VkPipelineStageFlags dst_stage = (release) ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 0, 0, nullptr, static_cast<uint32_t>(buf_barriers.size()),
+                           buf_barriers.data(), 0, nullptr);
+}
+
+void Hologram::cmd_acquire_frame_data(VkCommandBuffer cmd, const FrameData &data) const {
+    std::vector<VkBufferMemoryBarrier> buf_barriers;
+    buf_barriers.reserve(data.chunks.size());
+    for (const auto &chunk : data.chunks) {
+        VkBufferMemoryBarrier buf_barrier = {};
+        buf_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        buf_barrier.srcAccessMask = 0;
+        buf_barrier.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT;
+        buf_barrier.srcQueueFamilyIndex = transfer_queue_family_;
+        buf_barrier.dstQueueFamilyIndex = queue_family_;
+        buf_barrier.buffer = chunk.device_buf;
+        buf_barrier.offset = 0;
+        buf_barrier.size = VK_WHOLE_SIZE;
+        buf_barriers.push_back(buf_barrier);
+    }
+
+    // matches the wait stage of transfer_semaphore
+    vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr,
+                           static_cast<uint32_t>(buf_barriers.size()), buf_barriers.data(), 0, nullptr);
+}
+
+VkDeviceSize Hologram::object_data_size() const {
+    return (use_fused_) ? sizeof(Simulation::FusedRecord) : sizeof(ShaderParamBlock);
+}
+
+void Hologram::place_worker(Worker &worker) const {
+    if (worker.cpu_ >= 0 && !placement::pin_current_thread(worker.cpu_)) {
+        std::stringstream ss;
+        ss << "cannot pin worker " << worker.index_ << " to cpu " << worker.cpu_;
+        shell_->log(Shell::LOG_WARN, ss.str().c_str());
+    }
+
+    if (!first_touch_ || worker.object_begin_ == worker.object_end_) return;
+
+    // The objects were constructed by the main thread and the frame data was
+    // mapped by it; move what this worker reads and writes next to it.
+    // Objects the partitioner hands over later follow in place_new_objects.
+    const size_t pages = place_objects(worker.object_begin_, worker.object_end_);
+    worker.placed_begin_ = worker.object_begin_;
+    worker.placed_end_ = worker.object_end_;
+
+    std::stringstream ss;
+    ss << "worker " << worker.index_ << ": " << pages << " pages on the local node";
+    shell_->log(Shell::LOG_INFO, ss.str().c_str());
+}
+
+size_t Hologram::place_objects(int begin, int end) const {
+    if (begin >= end) return 0;
+
+    const auto &objects = sim_.objects();
+    size_t pages = placement::move_to_local_node(&objects[begin], sizeof(objects[0]) * (end - begin));
+
+    if (use_frame_data_buffers()) {
+        for (const auto &data : frame_data_) {
+            for (int i = begin; i < end;) {
+                const auto &obj = objects[i];
+                const int chunk_end = std::min(end, static_cast<int>((obj.frame_data_chunk + 1) * objects_per_chunk_));
+
+                const uint8_t *first = data.chunks[obj.frame_data_chunk].base + obj.frame_data_offset;
+                pages += placement::move_to_local_node(first, static_cast<size_t>(aligned_object_data_size * (chunk_end - i)));
+
+                i = chunk_end;
+            }
+        }
+    }
+
+    return pages;
+}
+
+int Hologram::update_simulation(const Worker &worker) {
+    return sim_.update(worker.tick_interval_, worker.object_begin_, worker.object_end_);
 }
 
 void Hologram::draw_objects(Worker &worker) {
@@ -664,13 +1557,97 @@ void Hologram::draw_objects(Worker &worker) {
 
     meshes_->cmd_bind_buffers(cmd);
 
-    for (int i = worker.object_begin_; i < worker.object_end_; i++) {
-        auto &obj = sim_.objects()[i];
+    if (use_gpu_sim_) {
+        GpuSimParamBlock params;
+        memcpy(params.view_projection, glm::value_ptr(camera_.view_projection), sizeof(camera_.view_projection));
+        params.fade = sim_fade_ ? 1.0f : 0.0f;
 
-        draw_object(obj, data, cmd);
+        const VkDescriptorSet desc_set = gpu_sim_->object_set();
+        vk::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &desc_set, 0, nullptr);
+        vk::CmdPushConstants(cmd, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(params), &params);
+
+        // the vertex shader finds the object by gl_InstanceIndex
+        for (int i = worker.object_begin_; i < worker.object_end_; i++)
+            meshes_->cmd_draw(cmd, sim_.objects()[i].mesh, static_cast<uint32_t>(i));
+    } else if (use_fused_) {
+        // simulate and write the frame data in one pass
+        sim_.update_fused(fused_time_, frame_ticks_, worker.object_begin_, worker.object_end_, data.chunk_bases.data(),
+                          sim_fade_);
+
+        FusedFrameBlock params;
+        memcpy(params.view_projection, glm::value_ptr(camera_.view_projection), sizeof(camera_.view_projection));
+        vk::CmdPushConstants(cmd, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(params), &params);
+
+        for (int i = worker.object_begin_; i < worker.object_end_; i++) {
+            const auto &obj = sim_.objects()[i];
+
+            vk::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1,
+                                      &data.chunks[obj.frame_data_chunk].desc_set, 1, &obj.frame_data_offset);
+            meshes_->cmd_draw(cmd, obj.mesh);
+        }
+    } else {
+        if (use_bvh_) {
+            // the range may have been rebalanced since the last step
+            worker.update_bvh(false);
+            worker.bvh_nodes_visited_ = worker.bvh_.cull(camera_.frustum, object_visible_.data());
+        }
+
+        uint32_t meshlets_culled = 0;
+        uint32_t objects_culled = 0;
+        for (int i = worker.object_begin_; i < worker.object_end_; i++) {
+            if (use_bvh_ && !object_visible_[i]) {
+                objects_culled++;
+                continue;
+            }
+
+            auto &obj = sim_.objects()[i];
+
+            meshlets_culled += draw_object(obj, data, cmd);
+        }
+        worker.meshlets_culled_ = meshlets_culled;
+        worker.objects_culled_ = objects_culled;
+
+        // for the ticks before the next frame
+        if (sim_lod_) {
+            worker.lod_reduced_ = sim_.update_lod(camera_.view_projection, camera_.pixel_scale, sim_lod_min_pixels,
+                                                  sim_lod_interval, worker.object_begin_, worker.object_end_);
+        }
     }
 
     vk::EndCommandBuffer(cmd);
+
+    if (use_frame_data_buffers() && !frame_data_coherent_) record_flush_ranges(worker);
+}
+
+void Hologram::record_flush_ranges(Worker &worker) const {
+    const auto &data = frame_data_[frame_data_index_];
+    const VkDeviceSize atom = physical_dev_props_.limits.nonCoherentAtomSize;
+
+    worker.flush_ranges_.clear();
+    if (worker.object_begin_ == worker.object_end_) return;
+
+    // the objects of a worker are contiguous within each chunk
+    const uint32_t chunk_begin = sim_.objects()[worker.object_begin_].frame_data_chunk;
+    const uint32_t chunk_end = sim_.objects()[worker.object_end_ - 1].frame_data_chunk + 1;
+    for (uint32_t i = chunk_begin; i < chunk_end; i++) {
+        const auto &chunk = data.chunks[i];
+        const int chunk_first = static_cast<int>(i * objects_per_chunk_);
+        const int first = std::max(worker.object_begin_, chunk_first) - chunk_first;
+        const int last = std::min(worker.object_end_, chunk_first + static_cast<int>(objects_per_chunk_)) - chunk_first;
+
+        VkDeviceSize begin = chunk.mem_offset + aligned_object_data_size * first;
+        VkDeviceSize end = chunk.mem_offset + aligned_object_data_size * last;
+        begin -= begin % atom;
+        if (end % atom) end += atom - (end % atom);
+
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = chunk.mem;
+        range.offset = begin;
+        // the rounded end may fall outside of the allocation
+        range.size = (end >= chunk.mem_size) ? VK_WHOLE_SIZE : end - begin;
+        worker.flush_ranges_.push_back(range);
+    }
 }
 
 void Hologram::on_key(Key key) {
@@ -701,7 +1678,16 @@ void Hologram::on_key(Key key) {
 void Hologram::on_tick() {
     if (sim_paused_) return;
 
-    for (auto &worker : workers_) worker->update_simulation();
+    // simulated with the next frame
+    if (use_gpu_sim_ || use_fused_) {
+        deferred_ticks_++;
+        return;
+    }
+
+    if (epoch_barrier_)
+        epoch_barrier_->publish(WORKER_STEP);
+    else
+        for (auto &worker : workers_) worker->update_simulation();
 }
 
 void Hologram::on_frame(float frame_pred) {
@@ -713,38 +1699,118 @@ void Hologram::on_frame(float frame_pred) {
 
     const Shell::BackBuffer &back = shell_->context().acquired_back_buffer;
 
-    // ignore frame_pred
-    for (auto &worker : workers_) worker->draw_objects(framebuffers_[back.image_index]);
+    // pick the render extent for this frame before any command is recorded
+    if (dynamic_res_ && data.timestamps_written) update_render_scale(data);
+
+    VkFramebuffer fb = (dynamic_res_) ? offscreen_fb_ : framebuffers_[back.image_index];
+
+    frame_ticks_ = deferred_ticks_;
+    deferred_ticks_ = 0;
+
+    // frame_pred goes past 1 when the shell drops ticks
+    const float prev_frame_pred = frame_pred_;
+    frame_pred_ = std::min(std::max(frame_pred, 0.0f), 1.0f);
+
+    // the fused path simulates exactly up to the frame time when
+    // interpolating, and only whole ticks otherwise
+    const float tick = 1.0f / settings_.ticks_per_second;
+    if (interpolate_ && !sim_paused_)
+        fused_time_ = std::max(tick * (static_cast<float>(frame_ticks_) + frame_pred_ - prev_frame_pred), 0.0f);
+    else
+        fused_time_ = tick * static_cast<float>(frame_ticks_);
+
+    if (epoch_barrier_) {
+        // the workers are idle once the steps are done
+        epoch_barrier_->wait_done();
+        for (auto &worker : workers_) worker->fb_ = fb;
+        epoch_barrier_->publish(WORKER_DRAW);
+    } else {
+        for (auto &worker : workers_) worker->draw_objects(fb);
+    }
 
     VkResult res = vk::BeginCommandBuffer(data.primary_cmd, &primary_cmd_begin_info_);
 
-    if (!use_push_constants_) {
-        VkBufferMemoryBarrier buf_barrier = {};
-        buf_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-        buf_barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-        buf_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        buf_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        buf_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        buf_barrier.buffer = data.buf;
-        buf_barrier.offset = 0;
-        buf_barrier.size = VK_WHOLE_SIZE;
-        vk::CmdPipelineBarrier(data.primary_cmd, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, 1,
-                               &buf_barrier, 0, nullptr);
+    const uint32_t query = static_cast<uint32_t>(2 * frame_data_index_);
+    if (dynamic_res_) {
+        vk::CmdResetQueryPool(data.primary_cmd, query_pool_, query, 2);
+        vk::CmdWriteTimestamp(data.primary_cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_, query);
     }
 
-    render_pass_begin_info_.framebuffer = framebuffers_[back.image_index];
-    render_pass_begin_info_.renderArea.extent = extent_;
+    if (use_gpu_sim_) {
+        gpu_sim_->cmd_update(data.primary_cmd, 1.0f / settings_.ticks_per_second, frame_ticks_);
+    }
+
+    if (stage_frame_data_) {
+        if (transfer_queue_ != VK_NULL_HANDLE)
+            cmd_acquire_frame_data(data.primary_cmd, data);
+        else
+            cmd_copy_frame_data(data.primary_cmd, data);
+    } else if (use_frame_data_buffers()) {
+        // covers all chunks
+        VkMemoryBarrier mem_barrier = {};
+        mem_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        mem_barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
+        mem_barrier.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT;
+        vk::CmdPipelineBarrier(data.primary_cmd, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &mem_barrier, 0,
+                               nullptr, 0, nullptr);
+    }
+
+    render_pass_begin_info_.framebuffer = fb;
+    render_pass_begin_info_.renderArea.extent = render_extent_;
     vk::CmdBeginRenderPass(data.primary_cmd, &render_pass_begin_info_, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
     // record render pass commands
-    for (auto &worker : workers_) worker->wait_idle();
+    if (epoch_barrier_)
+        epoch_barrier_->wait_done();
+    else
+        for (auto &worker : workers_) worker->wait_idle();
+
+    // make the frame data writes visible to the device with one call
+    if (use_frame_data_buffers() && !frame_data_coherent_) {
+        flush_ranges_.clear();
+        for (const auto &worker : workers_)
+            flush_ranges_.insert(flush_ranges_.end(), worker->flush_ranges_.begin(), worker->flush_ranges_.end());
+
+        if (!flush_ranges_.empty())
+            vk::assert_success(
+                vk::FlushMappedMemoryRanges(dev_, static_cast<uint32_t>(flush_ranges_.size()), flush_ranges_.data()));
+    }
+
     vk::CmdExecuteCommands(data.primary_cmd, static_cast<uint32_t>(data.worker_cmds.size()), data.worker_cmds.data());
 
     vk::CmdEndRenderPass(data.primary_cmd);
+
+    if (dynamic_res_) {
+        cmd_blit_offscreen(data.primary_cmd, images_[back.image_index]);
+
+        vk::CmdWriteTimestamp(data.primary_cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_, query + 1);
+        data.timestamps_written = true;
+    }
+
     vk::EndCommandBuffer(data.primary_cmd);
 
-    // wait for the image to be owned and signal for render completion
-    primary_cmd_submit_info_.pWaitSemaphores = &back.acquire_semaphore;
+    // the uploads wait only for the host writes, which vkQueueSubmit makes
+    // available
+    if (transfer_queue_ != VK_NULL_HANDLE) {
+        VkResult res = vk::BeginCommandBuffer(data.transfer_cmd, &primary_cmd_begin_info_);
+        cmd_copy_frame_data(data.transfer_cmd, data);
+        vk::EndCommandBuffer(data.transfer_cmd);
+
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &data.transfer_cmd;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &data.transfer_semaphore;
+        res = vk::QueueSubmit(transfer_queue_, 1, &submit_info, VK_NULL_HANDLE);
+
+        (void)res;
+    }
+
+    // wait for the image to be owned and the uploads, and signal for render
+    // completion
+    const VkSemaphore wait_semaphores[2] = {back.acquire_semaphore, data.transfer_semaphore};
+    primary_cmd_submit_info_.pWaitSemaphores = wait_semaphores;
     primary_cmd_submit_info_.pCommandBuffers = &data.primary_cmd;
     primary_cmd_submit_info_.pSignalSemaphores = &back.render_semaphore;
 
@@ -752,23 +1818,130 @@ void Hologram::on_frame(float frame_pred) {
 
     frame_data_index_ = (frame_data_index_ + 1) % frame_data_.size();
 
+    if (partitioner_) rebalance_workers();
+
+    if (print_worker_stats_ && std::chrono::steady_clock::now() - worker_stats_time_ >= std::chrono::seconds(5)) log_worker_stats();
+
     (void)res;
 }
 
+void Hologram::rebalance_workers() {
+    // the workers are idle until the next tick or frame
+    std::vector<double> times;
+    times.reserve(workers_.size());
+    for (auto &worker : workers_) times.push_back(static_cast<double>(worker->take_busy_ns()));
+
+    if (balance_warmup_frames_ > 0) {
+        // the first frame includes one-time costs
+        imbalance_before_ += (imbalance_before_ > 0.0) ? (Partitioner::imbalance(times) - imbalance_before_) / 16.0
+                                                       : Partitioner::imbalance(times);
+
+        if (--balance_warmup_frames_ == 0) {
+            std::stringstream ss;
+            ss << std::fixed << std::setprecision(3);
+            ss << "worker imbalance (max/mean busy time) with equal ranges: " << imbalance_before_;
+            shell_->log(Shell::LOG_INFO, ss.str().c_str());
+        }
+        return;
+    }
+
+    partitioner_->update(times);
+    imbalance_after_ += (imbalance_after_ > 0.0) ? (partitioner_->imbalance() - imbalance_after_) / 16.0 : partitioner_->imbalance();
+
+    for (size_t i = 0; i < workers_.size(); i++) {
+        workers_[i]->object_begin_ = partitioner_->begin(static_cast<int>(i));
+        workers_[i]->object_end_ = partitioner_->end(static_cast<int>(i));
+    }
+}
+
+std::vector<Hologram::WorkerStats> Hologram::worker_stats() const {
+    std::vector<WorkerStats> stats;
+    stats.reserve(workers_.size());
+    for (const auto &worker : workers_) stats.push_back(worker->stats());
+
+    return stats;
+}
+
+void Hologram::log_worker_stats() {
+    const auto now = std::chrono::steady_clock::now();
+    const auto stats = worker_stats();
+
+    // the first call only takes the baseline
+    if (last_worker_stats_.size() == stats.size()) {
+        const double seconds = std::chrono::duration<double>(now - worker_stats_time_).count();
+
+        for (size_t i = 0; i < stats.size(); i++) {
+            const auto &cur = stats[i];
+            const auto &last = last_worker_stats_[i];
+
+            std::stringstream ss;
+            ss << std::fixed << std::setprecision(1);
+            ss << "worker " << cur.index << " [" << cur.object_begin << ", " << cur.object_end << ") over " << seconds
+               << "s: simulated " << cur.objects_simulated - last.objects_simulated << ", drew "
+               << cur.draws_recorded - last.draws_recorded << ", wrote " << (cur.bytes_written - last.bytes_written) / 1024
+               << " KiB; simulate " << cur.simulate_ms - last.simulate_ms << " ms, draw " << cur.draw_ms - last.draw_ms
+               << " ms, main waited " << cur.wait_ms - last.wait_ms << " ms, idle " << cur.idle_ms - last.idle_ms << " ms";
+            if (use_bvh_) {
+                ss << "; bvh refit " << cur.bvh_refit_ms - last.bvh_refit_ms << " ms, " << cur.bvh_rebuilds - last.bvh_rebuilds
+                   << " builds " << cur.bvh_rebuild_ms - last.bvh_rebuild_ms << " ms, visited "
+                   << cur.bvh_nodes_visited - last.bvh_nodes_visited << " nodes, culled "
+                   << cur.objects_culled - last.objects_culled;
+            }
+            shell_->log(Shell::LOG_INFO, ss.str().c_str());
+        }
+    }
+
+    last_worker_stats_ = stats;
+    worker_stats_time_ = now;
+}
+
 Hologram::Worker::Worker(Hologram &hologram, int index, int object_begin, int object_end)
     : hologram_(hologram),
       index_(index),
       object_begin_(object_begin),
       object_end_(object_end),
+      cpu_(-1),
+      placed_begin_(0),
+      placed_end_(0),
       tick_interval_(1.0f / hologram.settings_.ticks_per_second),
-      state_(INIT) {}
+      lod_reduced_(0),
+      meshlets_culled_(0),
+      bvh_nodes_visited_(0),
+      objects_culled_(0),
+      busy_ns_(0),
+      state_(INIT) {
+    worker_counters_.objects_simulated = 0;
+    worker_counters_.draws_recorded = 0;
+    worker_counters_.bytes_written = 0;
+    worker_counters_.simulate_ns = 0;
+    worker_counters_.draw_ns = 0;
+    worker_counters_.idle_ns = 0;
+    worker_counters_.bvh_refit_ns = 0;
+    worker_counters_.bvh_rebuild_ns = 0;
+    worker_counters_.bvh_rebuilds = 0;
+    worker_counters_.bvh_nodes_visited = 0;
+    worker_counters_.objects_culled = 0;
+    main_counters_.wait_ns = 0;
+}
 
 void Hologram::Worker::start() {
     state_ = IDLE;
-    thread_ = std::thread(Hologram::Worker::thread_loop, this);
+
+    // no epoch is in flight; wait past the current one
+    if (hologram_.epoch_barrier_)
+        thread_ = std::thread(Hologram::Worker::epoch_thread_loop, this, hologram_.epoch_barrier_->epoch());
+    else
+        thread_ = std::thread(Hologram::Worker::thread_loop, this);
 }
 
 void Hologram::Worker::stop() {
+    // the thread has seen WORKER_EXIT
+    if (hologram_.epoch_barrier_) {
+        thread_.join();
+        state_ = INIT;
+        return;
+    }
+
     {
         std::lock_guard<std::mutex> lock(mutex_);
         state_ = INIT;
@@ -787,7 +1960,7 @@ void Hologram::Worker::update_simulation() {
 
         // step directly
         if (!started) {
-            hologram_.update_simulation(*this);
+            step();
             state_ = INIT;
         }
     }
@@ -807,7 +1980,7 @@ void Hologram::Worker::draw_objects(VkFramebuffer fb) {
 
         // render directly
         if (!started) {
-            hologram_.draw_objects(*this);
+            draw();
             state_ = INIT;
         }
     }
@@ -818,24 +1991,152 @@ void Hologram::Worker::wait_idle() {
     std::unique_lock<std::mutex> lock(mutex_);
     bool started = (state_ != INIT);
 
-    if (started) state_cv_.wait(lock, [this] { return (state_ == IDLE); });
+    if (started) {
+        const auto begin = std::chrono::steady_clock::now();
+        state_cv_.wait(lock, [this] { return (state_ == IDLE); });
+        add_counter(main_counters_.wait_ns, elapsed_ns(begin));
+    }
+}
+
+void Hologram::Worker::step() {
+    const auto begin = std::chrono::steady_clock::now();
+    const int updated = hologram_.update_simulation(*this);
+    const uint64_t ns = elapsed_ns(begin);
+    add_counter(worker_counters_.simulate_ns, ns);
+    busy_ns_ += ns;
+
+    add_counter(worker_counters_.objects_simulated, updated);
+
+    // refit after every update, while the objects are in cache
+    if (hologram_.use_bvh_) {
+        const auto bvh_begin = std::chrono::steady_clock::now();
+        update_bvh(true);
+        busy_ns_ += elapsed_ns(bvh_begin);
+    }
+}
+
+void Hologram::Worker::update_bvh(bool refit) {
+    const Simulation &sim = hologram_.sim_;
+
+    bool rebuild = (bvh_.begin() != object_begin_ || bvh_.end() != object_end_);
+    if (!rebuild && refit) {
+        const auto begin = std::chrono::steady_clock::now();
+        bvh_.refit(sim);
+        add_counter(worker_counters_.bvh_refit_ns, elapsed_ns(begin));
+
+        rebuild = bvh_.degraded();
+    }
+    if (!rebuild) return;
+
+    const auto begin = std::chrono::steady_clock::now();
+    bvh_.build(sim, object_begin_, object_end_);
+    add_counter(worker_counters_.bvh_rebuild_ns, elapsed_ns(begin));
+    add_counter(worker_counters_.bvh_rebuilds, 1);
+}
+
+void Hologram::Worker::place_new_objects() {
+    if (!hologram_.first_touch_ || (object_begin_ == placed_begin_ && object_end_ == placed_end_)) return;
+
+    // only what was gained; the pages shared with a neighbor stay with
+    // whichever worker moved them last
+    if (object_begin_ < placed_begin_) hologram_.place_objects(object_begin_, std::min(object_end_, placed_begin_));
+    if (object_end_ > placed_end_) hologram_.place_objects(std::max(object_begin_, placed_end_), object_end_);
+
+    placed_begin_ = object_begin_;
+    placed_end_ = object_end_;
+}
+
+void Hologram::Worker::draw() {
+    const auto begin = std::chrono::steady_clock::now();
+    hologram_.draw_objects(*this);
+    const uint64_t ns = elapsed_ns(begin);
+    add_counter(worker_counters_.draw_ns, ns);
+    busy_ns_ += ns;
+
+    const uint64_t draw_count = object_end_ - object_begin_ - objects_culled_;
+    add_counter(worker_counters_.draws_recorded, draw_count);
+    if (hologram_.use_frame_data_buffers()) add_counter(worker_counters_.bytes_written, draw_count * hologram_.object_data_size());
+    if (hologram_.use_fused_) add_counter(worker_counters_.objects_simulated, draw_count * hologram_.frame_ticks_);
+    if (hologram_.use_bvh_) {
+        add_counter(worker_counters_.bvh_nodes_visited, bvh_nodes_visited_);
+        add_counter(worker_counters_.objects_culled, objects_culled_);
+    }
+}
+
+uint64_t Hologram::Worker::take_busy_ns() {
+    const uint64_t ns = busy_ns_;
+    busy_ns_ = 0;
+
+    return ns;
+}
+
+Hologram::WorkerStats Hologram::Worker::stats() const {
+    WorkerStats stats;
+    stats.index = index_;
+    stats.object_begin = object_begin_;
+    stats.object_end = object_end_;
+
+    stats.objects_simulated = worker_counters_.objects_simulated.load(std::memory_order_relaxed);
+    stats.draws_recorded = worker_counters_.draws_recorded.load(std::memory_order_relaxed);
+    stats.bytes_written = worker_counters_.bytes_written.load(std::memory_order_relaxed);
+    stats.simulate_ms = ns_to_ms(worker_counters_.simulate_ns.load(std::memory_order_relaxed));
+    stats.draw_ms = ns_to_ms(worker_counters_.draw_ns.load(std::memory_order_relaxed));
+    stats.wait_ms = ns_to_ms(main_counters_.wait_ns.load(std::memory_order_relaxed));
+    stats.idle_ms = ns_to_ms(worker_counters_.idle_ns.load(std::memory_order_relaxed));
+    stats.bvh_refit_ms = ns_to_ms(worker_counters_.bvh_refit_ns.load(std::memory_order_relaxed));
+    stats.bvh_rebuild_ms = ns_to_ms(worker_counters_.bvh_rebuild_ns.load(std::memory_order_relaxed));
+    stats.bvh_rebuilds = worker_counters_.bvh_rebuilds.load(std::memory_order_relaxed);
+    stats.bvh_nodes_visited = worker_counters_.bvh_nodes_visited.load(std::memory_order_relaxed);
+    stats.objects_culled = worker_counters_.objects_culled.load(std::memory_order_relaxed);
+
+    return stats;
 }
 
 void Hologram::Worker::update_loop() {
+    hologram_.place_worker(*this);
+
     while (true) {
         std::unique_lock<std::mutex> lock(mutex_);
 
+        const auto begin = std::chrono::steady_clock::now();
         state_cv_.wait(lock, [this] { return (state_ != IDLE); });
+        add_counter(worker_counters_.idle_ns, elapsed_ns(begin));
         if (state_ == INIT) break;
 
         assert(state_ == STEP || state_ == DRAW);
+        // the range may have been rebalanced since the last task
+        place_new_objects();
         if (state_ == STEP)
-            hologram_.update_simulation(*this);
+            step();
         else
-            hologram_.draw_objects(*this);
+            draw();
 
         state_ = IDLE;
         lock.unlock();
         state_cv_.notify_one();
     }
 }
+
+void Hologram::Worker::epoch_loop(uint32_t epoch) {
+    hologram_.place_worker(*this);
+
+    EpochBarrier &barrier = *hologram_.epoch_barrier_;
+    uint32_t spin_limit = 0;
+
+    while (true) {
+        uint32_t task;
+        const auto begin = std::chrono::steady_clock::now();
+        epoch = barrier.wait_epoch(epoch, task, spin_limit);
+        add_counter(worker_counters_.idle_ns, elapsed_ns(begin));
+
+        // the range may have been rebalanced since the last task
+        if (task != WORKER_EXIT) place_new_objects();
+        if (task == WORKER_STEP)
+            step();
+        else if (task == WORKER_DRAW)
+            draw();
+
+        barrier.arrive();
+        if (task == WORKER_EXIT) break;
+    }
+}
@@ -0,0 +1,41 @@
+#version 310 es
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec3 in_normal;
+
+// Simulation::FusedRecord, one cache line per object
+layout(std140, set = 0, binding = 0) uniform param_block {
+	vec4 model[3];
+	vec3 light_pos;
+	uint light_color;
+} params;
+
+layout(std140, push_constant) uniform frame_block {
+	mat4 view_projection;
+} frame;
+
+layout(location = 0) out vec3 color;
+layout(location = 1) out float alpha;
+
+vec3 transform(vec4 v)
+{
+	return vec3(dot(params.model[0], v), dot(params.model[1], v), dot(params.model[2], v));
+}
+
+void main()
+{
+	vec3 world_light = transform(vec4(params.light_pos, 1.0));
+	vec3 world_pos = transform(vec4(in_pos, 1.0));
+	vec3 world_normal = transform(vec4(in_normal, 0.0));
+
+	vec3 light_dir = world_light - world_pos;
+	float brightness = dot(light_dir, world_normal) / length(light_dir) / length(world_normal);
+	brightness = abs(brightness);
+
+	// rgb is the light color and a is alpha
+	vec4 packed_color = unpackUnorm4x8(params.light_color);
+
+	gl_Position = frame.view_projection * vec4(world_pos, 1.0);
+	color = packed_color.rgb * brightness;
+	alpha = packed_color.a;
+}
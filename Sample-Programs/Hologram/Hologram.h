@@ -17,6 +17,9 @@
 #ifndef HOLOGRAM_H
 #define HOLOGRAM_H
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -27,9 +30,16 @@
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
 
+#include "Bvh.h"
+#include "Frustum.h"
+#include "Scene.h"
 #include "Simulation.h"
 #include "Game.h"
 
+class EpochBarrier;
+class Partitioner;
+
+class GpuSimulation;
 class Meshes;
 
 class Hologram : public Game {
@@ -48,6 +58,32 @@ class Hologram : public Game {
 
     void on_frame(float frame_pred);
 
+    // totals since the worker was created
+    struct WorkerStats {
+        int index;
+        int object_begin;
+        int object_end;
+
+        uint64_t objects_simulated;
+        uint64_t draws_recorded;
+        uint64_t bytes_written;
+
+        double simulate_ms;
+        double draw_ms;
+        // the main thread blocked in wait_idle for this worker
+        double wait_ms;
+        // the worker thread blocked waiting for work
+        double idle_ms;
+
+        // with --bvh
+        double bvh_refit_ms;
+        double bvh_rebuild_ms;
+        uint64_t bvh_rebuilds;
+        uint64_t bvh_nodes_visited;
+        uint64_t objects_culled;
+    };
+    std::vector<WorkerStats> worker_stats() const;
+
    private:
     class Worker {
        public:
@@ -59,16 +95,48 @@ class Hologram : public Game {
         void draw_objects(VkFramebuffer fb);
         void wait_idle();
 
+        WorkerStats stats() const;
+
+        // the time spent in step and draw since the last call; only valid
+        // when the worker is idle
+        uint64_t take_busy_ns();
+
         Hologram &hologram_;
 
         const int index_;
-        const int object_begin_;
-        const int object_end_;
+        // changed by the main thread only while the worker is idle
+        int object_begin_;
+        int object_end_;
+        // the CPU the thread is pinned to, or -1
+        int cpu_;
+        // the object range whose memory was last moved to the worker's node
+        int placed_begin_;
+        int placed_end_;
 
         const float tick_interval_;
 
         VkFramebuffer fb_;
 
+        // written by draw_objects when the frame data is not host coherent
+        std::vector<VkMappedMemoryRange> flush_ranges_;
+        // objects at the reduced simulation rate, as of the last draw
+        int lod_reduced_;
+        // meshlets skipped on the last draw
+        uint32_t meshlets_culled_;
+
+        // over [object_begin_, object_end_), with the results of its last cull
+        Bvh bvh_;
+        uint32_t bvh_nodes_visited_;
+        uint32_t objects_culled_;
+
+        // rebuild bvh_ when the object range has changed, or when refitting
+        // has degraded it
+        void update_bvh(bool refit);
+
+        // with first_touch_, move the memory of the objects gained since the
+        // last placement to the worker's node
+        void place_new_objects();
+
        private:
         enum State {
             INIT,
@@ -78,8 +146,46 @@ class Hologram : public Game {
         };
 
         void update_loop();
+        // replaces update_loop when the workers share an EpochBarrier
+        void epoch_loop(uint32_t epoch);
+
+        // run a STEP or a DRAW and account for it
+        void step();
+        void draw();
 
         static void thread_loop(Worker *worker) { worker->update_loop(); }
+        static void epoch_thread_loop(Worker *worker, uint32_t epoch) { worker->epoch_loop(epoch); }
+
+        // Each block has a single writer and is read by stats() from any
+        // thread.  The padding keeps the blocks of different workers, and the
+        // blocks written by the worker and by the main thread, on different
+        // cache lines.
+        struct WorkerCounters {
+            char pad_before[64];
+            std::atomic<uint64_t> objects_simulated;
+            std::atomic<uint64_t> draws_recorded;
+            std::atomic<uint64_t> bytes_written;
+            std::atomic<uint64_t> simulate_ns;
+            std::atomic<uint64_t> draw_ns;
+            std::atomic<uint64_t> idle_ns;
+            std::atomic<uint64_t> bvh_refit_ns;
+            std::atomic<uint64_t> bvh_rebuild_ns;
+            std::atomic<uint64_t> bvh_rebuilds;
+            std::atomic<uint64_t> bvh_nodes_visited;
+            std::atomic<uint64_t> objects_culled;
+            char pad_after[64];
+        };
+        struct MainCounters {
+            char pad_before[64];
+            std::atomic<uint64_t> wait_ns;
+            char pad_after[64];
+        };
+
+        WorkerCounters worker_counters_;
+        MainCounters main_counters_;
+
+        // handed over with mutex_
+        uint64_t busy_ns_;
 
         std::thread thread_;
         std::mutex mutex_;
@@ -90,8 +196,11 @@ class Hologram : public Game {
     struct Camera {
         glm::vec3 eye_pos;
         glm::mat4 view_projection;
+        Frustum frustum;
+        // radius / w in clip space to pixels
+        float pixel_scale;
 
-        Camera(float eye) : eye_pos(eye) {}
+        Camera(float eye) : eye_pos(eye), pixel_scale(1.0f) {}
     };
 
     struct FrameData {
@@ -101,27 +210,111 @@ class Hologram : public Game {
         VkCommandBuffer primary_cmd;
         std::vector<VkCommandBuffer> worker_cmds;
 
-        VkBuffer buf;
-        uint8_t *base;
-        VkDescriptorSet desc_set;
+        // objects are split over buffers so that no buffer or allocation
+        // grows beyond what the device or the 32-bit dynamic offsets allow
+        struct Chunk {
+            VkBuffer buf;
+            uint8_t *base;
+            VkDescriptorSet desc_set;
+
+            // where buf is bound; mem_size is the size of the whole allocation
+            VkDeviceMemory mem;
+            VkDeviceSize mem_offset;
+            VkDeviceSize mem_size;
+            VkDeviceSize size;
+
+            // when frame data is staged, buf is the staging buffer and
+            // desc_set points to device_buf
+            VkBuffer device_buf;
+            VkDeviceMemory device_mem;
+        };
+        std::vector<Chunk> chunks;
+        // Chunk::base of each chunk, for Simulation::update_fused
+        std::vector<uint8_t *> chunk_bases;
+
+        // GPU begin/end timestamps were recorded by the last submission
+        bool timestamps_written;
+
+        // copies the chunks on the transfer queue and signals
+        // transfer_semaphore
+        VkCommandBuffer transfer_cmd;
+        VkSemaphore transfer_semaphore;
     };
 
     // called by the constructor
     void init_workers();
 
+    // per-object ShaderParamBlocks in per-frame uniform buffers
+    bool use_frame_data_buffers() const { return !use_push_constants_ && !use_gpu_sim_; }
+    // bytes of frame data per object, before alignment
+    VkDeviceSize object_data_size() const;
+
     bool multithread_;
     bool use_push_constants_;
+    bool use_gpu_sim_;
+    // compare the motion of the GPU simulation with Simulation at startup
+    bool check_gpu_sim_;
+    // simulate while writing Simulation::FusedRecords with draw_objects
+    bool use_fused_;
+    // copy frame data from host-visible staging buffers to device-local ones
+    bool stage_frame_data_;
+    // draw objects between the last two ticks according to frame_pred
+    bool interpolate_;
+    // update objects that were off-screen or tiny in the last frame every
+    // sim_lod_interval ticks
+    bool sim_lod_;
+    // draw the meshlets of each object that are in view, and with
+    // cull_back_faces_ not facing away
+    bool use_meshlets_;
+    // cull back faces in the pipeline; the meshes are not all wound
+    // consistently, so both faces are drawn by default
+    bool cull_back_faces_;
+    // cull objects against the frustum through per-worker Bvhs
+    bool use_bvh_;
+    bool dynamic_res_;
+    float gpu_budget_ms_;
+    bool force_coherent_;
+    bool run_mem_bench_;
+    // where Meshes finds the mesh files
+    std::string mesh_dir_;
+    int icosphere_level_;
+    bool run_icosphere_bench_;
+
+    // thread placement; reserved_cpu_ runs only the main thread
+    std::vector<int> worker_cpus_;
+    int reserved_cpu_;
+    bool first_touch_;
+
+    // called by worker threads when they start
+    void place_worker(Worker &worker) const;
+    // move the objects in [begin, end) and their frame data to the NUMA node
+    // of the calling thread; returns the number of pages there
+    size_t place_objects(int begin, int end) const;
 
     // called mostly by on_key
     void update_camera();
 
     bool sim_paused_;
     bool sim_fade_;
+    Scene scene_;
     Simulation sim_;
     Camera camera_;
+    // by object, written by Bvh::cull
+    std::vector<uint8_t> object_visible_;
 
     std::vector<std::unique_ptr<Worker>> workers_;
 
+    // Hands tasks to all workers with one publish instead of a lock and a
+    // notify per worker.  Null unless requested.
+    enum WorkerTask {
+        WORKER_STEP,
+        WORKER_DRAW,
+        WORKER_EXIT,
+    };
+    std::unique_ptr<EpochBarrier> epoch_barrier_;
+    bool use_epoch_barrier_;
+    bool run_handoff_bench_;
+
     // called by attach_shell
     void create_render_pass();
     void create_shader_modules();
@@ -135,19 +328,40 @@ class Hologram : public Game {
     void create_command_buffers();
     void create_buffers();
     void create_buffer_memory();
+    void create_device_buffers();
+    void create_transfer_commands();
     void create_descriptor_sets();
+    void create_query_pool();
+
+    // called by attach_shell when dynamic resolution is requested
+    bool init_dynamic_resolution();
 
     VkPhysicalDevice physical_dev_;
     VkDevice dev_;
     VkQueue queue_;
     uint32_t queue_family_;
+    // VK_NULL_HANDLE when frame data is not staged or is copied on queue_
+    VkQueue transfer_queue_;
+    uint32_t transfer_queue_family_;
+    VkCommandPool transfer_cmd_pool_;
     VkFormat format_;
     VkDeviceSize aligned_object_data_size;
+    uint32_t objects_per_chunk_;
 
     VkPhysicalDeviceProperties physical_dev_props_;
     std::vector<VkMemoryPropertyFlags> mem_flags_;
+    std::vector<VkDeviceSize> mem_heap_sizes_;
 
     const Meshes *meshes_;
+    const GpuSimulation *gpu_sim_;
+    // ticks to run on the GPU or in the fused path with the next frame, and
+    // the ticks taken by the frame being recorded
+    uint32_t deferred_ticks_;
+    uint32_t frame_ticks_;
+    // frame_pred of the frame being recorded, clamped to [0, 1], and how far
+    // the fused path advances the simulation for it
+    float frame_pred_;
+    float fused_time_;
 
     VkRenderPass render_pass_;
     VkShaderModule vs_;
@@ -159,33 +373,82 @@ class Hologram : public Game {
     VkCommandPool primary_cmd_pool_;
     std::vector<VkCommandPool> worker_cmd_pools_;
     VkDescriptorPool desc_pool_;
-    VkDeviceMemory frame_data_mem_;
+    std::vector<VkDeviceMemory> frame_data_mems_;
+    // frame data writes need vkFlushMappedMemoryRanges
+    bool frame_data_coherent_;
+    std::vector<VkMappedMemoryRange> flush_ranges_;
     std::vector<FrameData> frame_data_;
     int frame_data_index_;
 
+    VkQueryPool query_pool_;
+    // nanoseconds per timestamp tick
+    float timestamp_period_;
+    uint64_t timestamp_mask_;
+    VkFilter blit_filter_;
+
     VkClearValue render_pass_clear_value_;
     VkRenderPassBeginInfo render_pass_begin_info_;
 
     VkCommandBufferBeginInfo primary_cmd_begin_info_;
-    VkPipelineStageFlags primary_cmd_submit_wait_stages_;
+    std::array<VkPipelineStageFlags, 2> primary_cmd_submit_wait_stages_;
     VkSubmitInfo primary_cmd_submit_info_;
 
     // called by attach_swapchain
     void prepare_viewport(const VkExtent2D &extent);
     void prepare_framebuffers(VkSwapchainKHR swapchain);
+    void create_offscreen_target();
+    void destroy_offscreen_target();
 
     VkExtent2D extent_;
     VkViewport viewport_;
     VkRect2D scissor_;
 
+    // objects are rendered into the top-left render_extent_ of the
+    // offscreen target, which is as large as the swapchain images
+    VkImage offscreen_image_;
+    VkDeviceMemory offscreen_mem_;
+    VkImageView offscreen_view_;
+    VkFramebuffer offscreen_fb_;
+
+    // called by on_frame
+    void update_render_scale(const FrameData &data);
+    void update_render_extent();
+    void cmd_blit_offscreen(VkCommandBuffer cmd, VkImage dst) const;
+    // record the staging copies; on the transfer queue this also releases
+    // the device buffers to the game queue, which acquires them
+    void cmd_copy_frame_data(VkCommandBuffer cmd, const FrameData &data) const;
+    void cmd_acquire_frame_data(VkCommandBuffer cmd, const FrameData &data) const;
+
+    float render_scale_;
+    float gpu_time_ms_;
+    VkExtent2D render_extent_;
+
     std::vector<VkImage> images_;
     std::vector<VkImageView> image_views_;
     std::vector<VkFramebuffer> framebuffers_;
 
     // called by workers
-    void update_simulation(const Worker &worker);
-    void draw_object(const Simulation::Object &obj, FrameData &data, VkCommandBuffer cmd) const;
+    // returns the number of objects updated
+    int update_simulation(const Worker &worker);
+    // returns the number of meshlets culled
+    uint32_t draw_object(const Simulation::Object &obj, FrameData &data, VkCommandBuffer cmd) const;
     void draw_objects(Worker &worker);
+    void record_flush_ranges(Worker &worker) const;
+
+    // called by on_frame
+    void log_worker_stats();
+    void rebalance_workers();
+
+    bool print_worker_stats_;
+    std::chrono::steady_clock::time_point worker_stats_time_;
+    std::vector<WorkerStats> last_worker_stats_;
+
+    // moves the object ranges of the workers when balancing is requested
+    std::unique_ptr<Partitioner> partitioner_;
+    // frames measured with the initial ranges before balancing starts
+    int balance_warmup_frames_;
+    double imbalance_before_;
+    double imbalance_after_;
 };
 
 #endif  // HOLOGRAM_H
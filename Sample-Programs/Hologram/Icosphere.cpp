@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <thread>
+
+#include "Icosphere.h"
+#include "Parallel.h"
+
+namespace {
+
+// below this many items, threads cost more than they save
+const size_t min_parallel_count = 16 * 1024;
+
+template <typename T>
+size_t vector_bytes(const std::vector<T> &vec) {
+    return sizeof(T) * vec.capacity();
+}
+
+}  // namespace
+
+Icosphere::Icosphere(float radius, int level, int thread_count)
+    : radius_(radius), thread_count_(std::max(thread_count, 1)), peak_bytes_(0) {
+    assert(level >= 0 && level <= max_level);
+
+    // a level has 10 * 4^level + 2 vertices
+    positions_.reserve(10 * (size_t(1) << (2 * level)) + 2);
+
+    build_icosahedron();
+    for (int i = 0; i < level; i++) subdivide();
+
+    peak_bytes_ = std::max(peak_bytes_, vector_bytes(positions_) + vector_bytes(faces_));
+}
+
+void Icosphere::build_icosahedron() {
+    // https://en.wikipedia.org/wiki/Regular_icosahedron
+    const float l1 = std::sqrt(2.0f / (5.0f + std::sqrt(5.0f))) * radius_;
+    const float l2 = std::sqrt(2.0f / (5.0f - std::sqrt(5.0f))) * radius_;
+    // vertices are from three golden rectangles
+    positions_ = {
+        {{-l1, -l2, 0.0f}}, {{l1, -l2, 0.0f}}, {{l1, l2, 0.0f}}, {{-l1, l2, 0.0f}},
+        {{-l2, 0.0f, -l1}}, {{l2, 0.0f, -l1}}, {{l2, 0.0f, l1}}, {{-l2, 0.0f, l1}},
+        {{0.0f, -l1, -l2}}, {{0.0f, l1, -l2}}, {{0.0f, l1, l2}}, {{0.0f, -l1, l2}},
+    };
+    faces_ = {
+        // triangles sharing vertex 0
+        {{0, 1, 11}}, {{0, 11, 7}}, {{0, 7, 4}}, {{0, 4, 8}}, {{0, 8, 1}},
+        // adjacent triangles
+        {{11, 1, 6}}, {{7, 11, 10}}, {{4, 7, 3}}, {{8, 4, 9}}, {{1, 8, 5}},
+        // triangles sharing vertex 2
+        {{2, 3, 10}}, {{2, 10, 6}}, {{2, 6, 5}}, {{2, 5, 9}}, {{2, 9, 3}},
+        // adjacent triangles
+        {{10, 3, 7}}, {{6, 10, 11}}, {{5, 6, 1}}, {{9, 5, 8}}, {{3, 9, 4}},
+    };
+}
+
+void Icosphere::subdivide() {
+    const size_t face_count = faces_.size();
+    assert(face_count * 4 <= UINT32_MAX);
+
+    // every face edge, keyed by its vertices in increasing order
+    std::vector<Edge> edges(face_count * 3);
+    for_each_chunk(face_count, thread_count_, min_parallel_count, [this, &edges](int, size_t begin, size_t end) {
+        for (size_t f = begin; f < end; f++) {
+            const auto &face = faces_[f];
+            for (int k = 0; k < 3; k++) {
+                const uint64_t a = face[k];
+                const uint64_t b = face[(k + 1) % 3];
+                const uint32_t slot = static_cast<uint32_t>(f * 3 + k);
+                edges[slot] = Edge{(a < b) ? (a << 32 | b) : (b << 32 | a), slot};
+            }
+        }
+    });
+
+    // merging needs a second buffer
+    const size_t sort_bytes = vector_bytes(edges) * ((thread_count_ > 1) ? 2 : 1);
+    peak_bytes_ = std::max(peak_bytes_, vector_bytes(positions_) + vector_bytes(faces_) + sort_bytes);
+
+    sort_edges(edges);
+    const std::vector<uint32_t> midpoints = add_midpoints(edges);
+    peak_bytes_ =
+        std::max(peak_bytes_, vector_bytes(positions_) + vector_bytes(faces_) + vector_bytes(edges) + vector_bytes(midpoints));
+    std::vector<Edge>().swap(edges);
+
+    std::vector<std::array<uint32_t, 3>> faces(face_count * 4);
+    for_each_chunk(face_count, thread_count_, min_parallel_count, [this, &faces, &midpoints](int, size_t begin, size_t end) {
+        for (size_t f = begin; f < end; f++) {
+            const uint32_t v0 = faces_[f][0];
+            const uint32_t v1 = faces_[f][1];
+            const uint32_t v2 = faces_[f][2];
+            const uint32_t v01 = midpoints[f * 3 + 0];
+            const uint32_t v12 = midpoints[f * 3 + 1];
+            const uint32_t v20 = midpoints[f * 3 + 2];
+
+            faces[f * 4 + 0] = {{v0, v01, v20}};
+            faces[f * 4 + 1] = {{v1, v12, v01}};
+            faces[f * 4 + 2] = {{v2, v20, v12}};
+            faces[f * 4 + 3] = {{v01, v12, v20}};
+        }
+    });
+    peak_bytes_ =
+        std::max(peak_bytes_, vector_bytes(positions_) + vector_bytes(faces_) + vector_bytes(midpoints) + vector_bytes(faces));
+
+    faces_.swap(faces);
+}
+
+void Icosphere::sort_edges(std::vector<Edge> &edges) const {
+    auto less = [](const Edge &a, const Edge &b) { return a.key < b.key || (a.key == b.key && a.slot < b.slot); };
+    auto bound = [&edges, this](int chunk) { return edges.size() * std::min(chunk, thread_count_) / thread_count_; };
+
+    // sort the chunks, then merge them pairwise
+    for_each_chunk(edges.size(), thread_count_, min_parallel_count,
+                   [&edges, &less](int, size_t begin, size_t end) { std::sort(edges.begin() + begin, edges.begin() + end, less); });
+    if (thread_count_ == 1) return;
+
+    std::vector<Edge> buf(edges.size());
+    std::vector<Edge> *src = &edges;
+    std::vector<Edge> *dst = &buf;
+    for (int width = 1; width < thread_count_; width *= 2) {
+        std::vector<std::thread> threads;
+        for (int c = 0; c < thread_count_; c += 2 * width) {
+            const size_t begin = bound(c);
+            const size_t mid = bound(c + width);
+            const size_t end = bound(c + 2 * width);
+
+            auto merge = [src, dst, begin, mid, end, &less] {
+                std::merge(src->begin() + begin, src->begin() + mid, src->begin() + mid, src->begin() + end, dst->begin() + begin,
+                           less);
+            };
+            if (edges.size() < min_parallel_count)
+                merge();
+            else
+                threads.emplace_back(merge);
+        }
+        for (auto &thread : threads) thread.join();
+
+        std::swap(src, dst);
+    }
+
+    if (src != &edges) edges.swap(buf);
+}
+
+std::vector<uint32_t> Icosphere::add_midpoints(const std::vector<Edge> &edges) {
+    auto is_first = [&edges](size_t i) { return i == 0 || edges[i].key != edges[i - 1].key; };
+
+    // count the distinct edges of each chunk to find where their midpoints go
+    std::vector<size_t> offsets(thread_count_ + 1, 0);
+    for_each_chunk(edges.size(), thread_count_, min_parallel_count, [&offsets, &is_first](int chunk, size_t begin, size_t end) {
+        size_t count = 0;
+        for (size_t i = begin; i < end; i++) count += is_first(i);
+        offsets[chunk + 1] = count;
+    });
+    for (int c = 0; c < thread_count_; c++) offsets[c + 1] += offsets[c];
+
+    const size_t first_mid = positions_.size();
+    positions_.resize(first_mid + offsets[thread_count_]);
+
+    std::vector<uint32_t> midpoints(edges.size());
+    for_each_chunk(edges.size(), thread_count_, min_parallel_count, [&](int chunk, size_t begin, size_t end) {
+        // an edge continuing from the previous chunk has its last midpoint
+        size_t mid = first_mid + offsets[chunk] - 1;
+        for (size_t i = begin; i < end; i++) {
+            if (is_first(i)) {
+                mid++;
+
+                const auto &a = positions_[edges[i].key >> 32];
+                const auto &b = positions_[edges[i].key & 0xffffffff];
+                std::array<float, 3> pos = {{(a[0] + b[0]) / 2.0f, (a[1] + b[1]) / 2.0f, (a[2] + b[2]) / 2.0f}};
+                const float scale = radius_ / std::sqrt(pos[0] * pos[0] + pos[1] * pos[1] + pos[2] * pos[2]);
+                for (auto &p : pos) p *= scale;
+
+                positions_[mid] = pos;
+            }
+
+            midpoints[edges[i].slot] = static_cast<uint32_t>(mid);
+        }
+    });
+
+    return midpoints;
+}
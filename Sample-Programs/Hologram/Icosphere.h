@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ICOSPHERE_H
+#define ICOSPHERE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A geodesic sphere made by splitting every face of an icosahedron into
+// four, level times.  Each level finds the edges shared by the faces by
+// sorting the face edges, instead of looking midpoints up in a hash table,
+// so that all steps can be split across threads.  The result does not
+// depend on the thread count.
+class Icosphere {
+   public:
+    static const int max_level = 10;
+
+    Icosphere(float radius, int level, int thread_count);
+
+    // the normal of a vertex is its position divided by the radius
+    const std::vector<std::array<float, 3>> &positions() const { return positions_; }
+    const std::vector<std::array<uint32_t, 3>> &faces() const { return faces_; }
+
+    // the most memory in use at once while subdividing, in bytes
+    size_t peak_bytes() const { return peak_bytes_; }
+
+   private:
+    struct Edge {
+        uint64_t key;
+        // face * 3 + the edge within the face
+        uint32_t slot;
+    };
+
+    void build_icosahedron();
+    void subdivide();
+
+    void sort_edges(std::vector<Edge> &edges) const;
+    // the index of the midpoint vertex of each face edge, by slot
+    std::vector<uint32_t> add_midpoints(const std::vector<Edge> &edges);
+
+    const float radius_;
+    const int thread_count_;
+
+    std::vector<std::array<float, 3>> positions_;
+    std::vector<std::array<uint32_t, 3>> faces_;
+
+    size_t peak_bytes_;
+};
+
+#endif  // ICOSPHERE_H
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include "Icosphere.h"
+#include "IcosphereBenchmark.h"
+#include "Shell.h"
+
+namespace {
+
+// the hash table baseline gets slow quickly
+const int max_hash_table_level = 7;
+
+// runs shorter than this are repeated
+const double min_run_ms = 50.0;
+
+// the tessellator Meshes used before Icosphere, starting from its level 0
+size_t tessellate_with_hash_table(const Icosphere &base, int level) {
+    std::vector<std::array<float, 3>> positions = base.positions();
+    std::vector<std::array<uint32_t, 3>> faces = base.faces();
+    std::unordered_map<uint64_t, uint32_t> middle_points;
+
+    auto add_middle_point = [&](uint32_t a, uint32_t b) {
+        const uint64_t key = (a < b) ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+        auto it = middle_points.find(key);
+        if (it != middle_points.end()) return it->second;
+
+        std::array<float, 3> pos = {{(positions[a][0] + positions[b][0]) / 2.0f, (positions[a][1] + positions[b][1]) / 2.0f,
+                                     (positions[a][2] + positions[b][2]) / 2.0f}};
+        const float scale = 1.0f / std::sqrt(pos[0] * pos[0] + pos[1] * pos[1] + pos[2] * pos[2]);
+        for (auto &p : pos) p *= scale;
+
+        positions.push_back(pos);
+        const uint32_t mid = static_cast<uint32_t>(positions.size() - 1);
+        middle_points.emplace(key, mid);
+
+        return mid;
+    };
+
+    for (int i = 0; i < level; i++) {
+        std::vector<std::array<uint32_t, 3>> next;
+        next.reserve(faces.size() * 4);
+
+        middle_points.clear();
+        middle_points.reserve(faces.size() * 3 / 2);
+        for (const auto &f : faces) {
+            const uint32_t v01 = add_middle_point(f[0], f[1]);
+            const uint32_t v12 = add_middle_point(f[1], f[2]);
+            const uint32_t v20 = add_middle_point(f[2], f[0]);
+
+            next.push_back({{f[0], v01, v20}});
+            next.push_back({{f[1], v12, v01}});
+            next.push_back({{f[2], v20, v12}});
+            next.push_back({{v01, v12, v20}});
+        }
+
+        faces.swap(next);
+    }
+
+    return positions.size();
+}
+
+// the mean time of func in milliseconds
+template <typename Func>
+double time_ms(const Func &func) {
+    int runs = 0;
+    double total = 0.0;
+    do {
+        const auto begin = std::chrono::steady_clock::now();
+        func();
+        total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        runs++;
+    } while (total < min_run_ms && runs < 100);
+
+    return total / runs;
+}
+
+}  // namespace
+
+void IcosphereBenchmark::run(const Shell &shell, int max_level) const {
+    const Icosphere base(1.0f, 0, 1);
+
+    for (int level = 0; level <= max_level && level <= Icosphere::max_level; level++) {
+        size_t vertex_count = 0;
+        size_t peak_bytes = 0;
+
+        const double single_ms = time_ms([level] { Icosphere sphere(1.0f, level, 1); });
+        const double multi_ms = time_ms([this, level, &vertex_count, &peak_bytes] {
+            Icosphere sphere(1.0f, level, thread_count_);
+            vertex_count = sphere.positions().size();
+            peak_bytes = sphere.peak_bytes();
+        });
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2);
+        ss << "icosphere level " << level << " (" << vertex_count << " vertices): " << single_ms << " ms on 1 thread, " << multi_ms
+           << " ms on " << thread_count_ << " threads, peak " << static_cast<double>(peak_bytes) / (1024.0 * 1024.0) << " MiB";
+        if (level <= max_hash_table_level)
+            ss << ", hash table " << time_ms([&base, level] { tessellate_with_hash_table(base, level); }) << " ms";
+        shell.log(Shell::LOG_INFO, ss.str().c_str());
+    }
+}
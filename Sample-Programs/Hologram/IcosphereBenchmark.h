@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ICOSPHERE_BENCHMARK_H
+#define ICOSPHERE_BENCHMARK_H
+
+class Shell;
+
+// Measures how long Icosphere takes to generate each level, on one thread
+// and on thread_count threads, and how much memory it needs.  Low levels are
+// also generated with the hash table of midpoints that Icosphere replaced.
+class IcosphereBenchmark {
+   public:
+    IcosphereBenchmark(int thread_count) : thread_count_(thread_count) {}
+
+    // log one line per level
+    void run(const Shell &shell, int max_level) const;
+
+   private:
+    const int thread_count_;
+};
+
+#endif  // ICOSPHERE_BENCHMARK_H
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+#include "LogQueue.h"
+
+namespace {
+
+uint32_t round_up_pow2(uint32_t val) {
+    uint32_t pow2 = 1;
+    while (pow2 < val) pow2 <<= 1;
+    return pow2;
+}
+
+// FNV-1a
+uint64_t hash_text(const char *text) {
+    uint64_t hash = 14695981039346656037ull;
+    for (; *text; text++) {
+        hash ^= static_cast<uint8_t>(*text);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+}  // namespace
+
+LogQueue::LogQueue(const Shell &shell, uint32_t capacity, int rate_limit)
+    : shell_(shell),
+      rate_limit_(rate_limit),
+      ring_(round_up_pow2(capacity)),
+      mask_(ring_.size() - 1),
+      enqueue_pos_(0),
+      dropped_(0),
+      dequeue_pos_(0),
+      dropped_reported_(0),
+      running_(false) {
+    for (size_t i = 0; i < ring_.size(); i++) ring_[i].seq.store(i, std::memory_order_relaxed);
+}
+
+LogQueue::~LogQueue() {
+    if (thread_.joinable()) stop();
+}
+
+void LogQueue::start() {
+    running_ = true;
+    thread_ = std::thread(LogQueue::thread_loop, this);
+}
+
+void LogQueue::stop() {
+    running_ = false;
+    thread_.join();
+}
+
+bool LogQueue::push(Shell::LogPriority priority, int32_t code, const char *layer_prefix, const char *msg) {
+    uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Entry *entry;
+
+    // claim a slot
+    while (true) {
+        entry = &ring_[pos & mask_];
+        const uint64_t seq = entry->seq.load(std::memory_order_acquire);
+        const int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // full
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    entry->priority = priority;
+    entry->code = code;
+    snprintf(entry->text, sizeof(entry->text), "%s: %s", layer_prefix, msg);
+
+    // publish
+    entry->seq.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool LogQueue::pop(Entry &out) {
+    Entry &entry = ring_[dequeue_pos_ & mask_];
+    if (entry.seq.load(std::memory_order_acquire) != dequeue_pos_ + 1) return false;
+
+    out.priority = entry.priority;
+    out.code = entry.code;
+    memcpy(out.text, entry.text, sizeof(out.text));
+
+    // hand the slot back to producers
+    entry.seq.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+    dequeue_pos_++;
+
+    return true;
+}
+
+void LogQueue::process(const Entry &entry, std::chrono::steady_clock::time_point now) {
+    auto it = codes_.find(entry.code);
+    if (it == codes_.end()) {
+        CodeState state = {now, 0, 0, 0};
+        it = codes_.emplace(entry.code, state).first;
+    }
+    CodeState &state = it->second;
+
+    if (rate_limit_ > 0 && now - state.window_start >= std::chrono::seconds(1)) {
+        flush_suppressed(entry.code, state);
+        state.window_start = now;
+        state.printed = 0;
+    }
+
+    // collapse back-to-back repeats of the same message
+    const uint64_t hash = hash_text(entry.text);
+    if (state.printed && hash == state.last_hash) {
+        state.suppressed++;
+        return;
+    }
+
+    if (rate_limit_ > 0 && state.printed >= rate_limit_) {
+        state.suppressed++;
+        return;
+    }
+
+    shell_.log(entry.priority, entry.text);
+    state.printed++;
+    state.last_hash = hash;
+}
+
+void LogQueue::flush_suppressed(int32_t code, CodeState &state) {
+    if (!state.suppressed) return;
+
+    std::stringstream ss;
+    ss << "message code " << code << ": suppressed " << state.suppressed << " repeated or rate-limited messages";
+    shell_.log(Shell::LOG_INFO, ss.str().c_str());
+
+    state.suppressed = 0;
+}
+
+void LogQueue::report_dropped() {
+    const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped == dropped_reported_) return;
+
+    std::stringstream ss;
+    ss << "log queue full: dropped " << dropped - dropped_reported_ << " messages";
+    shell_.log(Shell::LOG_WARN, ss.str().c_str());
+
+    dropped_reported_ = dropped;
+}
+
+void LogQueue::drain_loop() {
+    // Entry is large; keep one around instead of on the stack per message
+    std::unique_ptr<Entry> entry(new Entry);
+    auto last_sweep = std::chrono::steady_clock::now();
+
+    while (true) {
+        const bool running = running_.load(std::memory_order_acquire);
+
+        int count = 0;
+        while (pop(*entry)) {
+            process(*entry, std::chrono::steady_clock::now());
+            count++;
+        }
+
+        report_dropped();
+
+        // report codes that went quiet while being suppressed
+        const auto now = std::chrono::steady_clock::now();
+        if (rate_limit_ > 0 && now - last_sweep >= std::chrono::seconds(1)) {
+            for (auto &code : codes_) {
+                CodeState &state = code.second;
+                if (now - state.window_start < std::chrono::seconds(1)) continue;
+
+                flush_suppressed(code.first, state);
+                state.window_start = now;
+                state.printed = 0;
+            }
+            last_sweep = now;
+        }
+
+        if (!running) break;
+
+        // producers never signal us; poll at a rate that is cheap for them
+        if (!count) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    for (auto &code : codes_) flush_suppressed(code.first, code.second);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_QUEUE_H
+#define LOG_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Shell.h"
+
+// A bounded multi-producer single-consumer ring of log messages.  Producers
+// (any thread calling into the debug report callback) never lock or block;
+// when the ring is full the message is dropped and counted.  A background
+// thread drains the ring, collapses repeated messages and rate limits each
+// message code before handing the text to Shell::log.
+class LogQueue {
+   public:
+    // capacity is rounded up to a power of two; rate_limit is the number of
+    // messages printed per message code per second, or 0 for no limit
+    LogQueue(const Shell &shell, uint32_t capacity, int rate_limit);
+    ~LogQueue();
+
+    LogQueue(const LogQueue &queue) = delete;
+    LogQueue &operator=(const LogQueue &queue) = delete;
+
+    void start();
+    // drain what is left in the ring and join the thread
+    void stop();
+
+    bool push(Shell::LogPriority priority, int32_t code, const char *layer_prefix, const char *msg);
+
+   private:
+    static const size_t max_text_len = 1024;
+
+    struct Entry {
+        std::atomic<uint64_t> seq;
+
+        Shell::LogPriority priority;
+        int32_t code;
+        char text[max_text_len];
+    };
+
+    struct CodeState {
+        std::chrono::steady_clock::time_point window_start;
+        int printed;
+        uint32_t suppressed;
+        uint64_t last_hash;
+    };
+
+    bool pop(Entry &entry);
+    void process(const Entry &entry, std::chrono::steady_clock::time_point now);
+    void flush_suppressed(int32_t code, CodeState &state);
+    void report_dropped();
+
+    void drain_loop();
+    static void thread_loop(LogQueue *queue) { queue->drain_loop(); }
+
+    const Shell &shell_;
+    const int rate_limit_;
+
+    std::vector<Entry> ring_;
+    const uint64_t mask_;
+
+    // written by producers; padded away from the consumer state
+    std::atomic<uint64_t> enqueue_pos_;
+    std::atomic<uint64_t> dropped_;
+    char pad_[64 - 2 * sizeof(uint64_t)];
+
+    // owned by the drain thread
+    uint64_t dequeue_pos_;
+    uint64_t dropped_reported_;
+    std::unordered_map<int32_t, CodeState> codes_;
+
+    std::atomic<bool> running_;
+    std::thread thread_;
+};
+
+#endif  // LOG_QUEUE_H
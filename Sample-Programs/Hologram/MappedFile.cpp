@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path) : data_(nullptr), size_(0), file_(nullptr), mapping_(nullptr) {
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) throw std::runtime_error("failed to open " + path);
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file_, &size) && size.QuadPart > 0)
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_) data_ = reinterpret_cast<const uint8_t *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+
+    if (!data_) {
+        if (mapping_) CloseHandle(mapping_);
+        CloseHandle(file_);
+        throw std::runtime_error("failed to map " + path);
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path) : data_(nullptr), size_(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("failed to open " + path);
+
+    struct stat st;
+    void *addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file open
+    close(fd);
+
+    if (addr == MAP_FAILED) throw std::runtime_error("failed to map " + path);
+
+    // files are read front to back, and all of it; the advice values are
+    // not flags and cannot be combined
+    madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    madvise(addr, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+
+    data_ = reinterpret_cast<const uint8_t *>(addr);
+    size_ = static_cast<size_t>(st.st_size);
+}
+
+MappedFile::~MappedFile() { munmap(const_cast<uint8_t *>(data_), size_); }
+
+#endif
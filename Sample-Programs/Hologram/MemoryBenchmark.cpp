@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "Helpers.h"
+#include "MemoryBenchmark.h"
+#include "Shell.h"
+
+namespace {
+
+const VkDeviceSize buffer_size = 32 << 20;
+const int iteration_count = 16;
+
+std::string describe(VkMemoryPropertyFlags flags) {
+    std::string str;
+    if (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) str += "DEVICE_LOCAL|";
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) str += "HOST_VISIBLE|";
+    if (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) str += "HOST_COHERENT|";
+    if (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) str += "HOST_CACHED|";
+    if (!str.empty()) str.pop_back();
+
+    return str;
+}
+
+}  // namespace
+
+MemoryBenchmark::MemoryBenchmark(VkDevice dev, const std::vector<VkMemoryPropertyFlags> &mem_flags)
+    : dev_(dev), mem_flags_(mem_flags) {}
+
+void MemoryBenchmark::run(const Shell &shell, VkDeviceSize record_size, VkDeviceSize stride) const {
+    // only memory types that can back the frame data buffers
+    VkBufferCreateInfo buf_info = {};
+    buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buf_info.size = buffer_size;
+    buf_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer buf;
+    vk::assert_success(vk::CreateBuffer(dev_, &buf_info, nullptr, &buf));
+
+    VkMemoryRequirements mem_reqs;
+    vk::GetBufferMemoryRequirements(dev_, buf, &mem_reqs);
+    vk::DestroyBuffer(dev_, buf, nullptr);
+
+    std::vector<VkMemoryPropertyFlags> measured;
+    for (uint32_t idx = 0; idx < mem_flags_.size(); idx++) {
+        const VkMemoryPropertyFlags flags = mem_flags_[idx];
+        if (!(mem_reqs.memoryTypeBits & (1 << idx)) || !(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) continue;
+
+        bool seen = false;
+        for (auto f : measured) seen |= (f == flags);
+        if (seen) continue;
+        measured.push_back(flags);
+
+        const double gbps = measure(idx, record_size, stride);
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2);
+        ss << "memory type " << idx << " (" << describe(flags) << "): " << gbps << " GB/s";
+        shell.log(Shell::LOG_INFO, ss.str().c_str());
+    }
+}
+
+double MemoryBenchmark::measure(uint32_t mem_type, VkDeviceSize record_size, VkDeviceSize stride) const {
+    VkMemoryAllocateInfo mem_info = {};
+    mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mem_info.allocationSize = buffer_size;
+    mem_info.memoryTypeIndex = mem_type;
+
+    VkDeviceMemory mem;
+    vk::assert_success(vk::AllocateMemory(dev_, &mem_info, nullptr, &mem));
+
+    uint8_t *base;
+    vk::assert_success(vk::MapMemory(dev_, mem, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void **>(&base)));
+
+    const bool coherent = (mem_flags_[mem_type] & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    const VkDeviceSize record_count = buffer_size / stride;
+
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = mem;
+    range.offset = 0;
+    range.size = VK_WHOLE_SIZE;
+
+    std::vector<uint8_t> record(static_cast<size_t>(record_size));
+
+    // the first iteration faults the pages in and is not timed
+    auto begin = std::chrono::steady_clock::now();
+    for (int iter = -1; iter < iteration_count; iter++) {
+        if (iter == 0) begin = std::chrono::steady_clock::now();
+
+        std::memset(record.data(), iter, record.size());
+        for (VkDeviceSize i = 0; i < record_count; i++) std::memcpy(base + i * stride, record.data(), record.size());
+
+        if (!coherent) vk::assert_success(vk::FlushMappedMemoryRanges(dev_, 1, &range));
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    vk::UnmapMemory(dev_, mem);
+    vk::FreeMemory(dev_, mem, nullptr);
+
+    return static_cast<double>(record_size * record_count * iteration_count) / seconds / 1e9;
+}
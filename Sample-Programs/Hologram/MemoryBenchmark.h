@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEMORY_BENCHMARK_H
+#define MEMORY_BENCHMARK_H
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+class Shell;
+
+// Measures how fast the host fills frame data in each kind of host-visible
+// memory, including the flushes that non-coherent memory needs.  Cached
+// memory is often several times faster than write-combined memory on
+// integrated GPUs.
+class MemoryBenchmark {
+   public:
+    MemoryBenchmark(VkDevice dev, const std::vector<VkMemoryPropertyFlags> &mem_flags);
+
+    // write record_size bytes every stride bytes and log one line per
+    // distinct set of host-visible memory properties
+    void run(const Shell &shell, VkDeviceSize record_size, VkDeviceSize stride) const;
+
+   private:
+    // GB/s
+    double measure(uint32_t mem_type, VkDeviceSize record_size, VkDeviceSize stride) const;
+
+    VkDevice dev_;
+    const std::vector<VkMemoryPropertyFlags> &mem_flags_;
+};
+
+#endif  // MEMORY_BENCHMARK_H
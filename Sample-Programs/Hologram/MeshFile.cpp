@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "MeshFile.h"
+
+static_assert(sizeof(MeshFile::Header) == 80, "MeshFile::Header must match mesh-convert");
+static_assert(sizeof(MeshFile::Lod) == 16, "MeshFile::Lod must match mesh-convert");
+
+namespace {
+
+// the largest of count indices of type T at data, which is aligned for T
+template <typename T>
+uint32_t max_index(const uint8_t *data, uint32_t count) {
+    const T *indices = reinterpret_cast<const T *>(data);
+
+    T max = 0;
+    for (uint32_t i = 0; i < count; i++) max = std::max(max, indices[i]);
+
+    return max;
+}
+
+}  // namespace
+
+MeshFile::MeshFile(const std::string &path) : file_(path) { validate(path); }
+
+void MeshFile::validate(const std::string &path) const {
+    if (file_.size() < sizeof(Header) || std::memcmp(header().magic, "HMSH", 4) != 0)
+        throw std::runtime_error(path + " is not a mesh file");
+
+    const Header &hdr = header();
+    if (hdr.version != current_version) throw std::runtime_error(path + " has an unsupported mesh file version");
+
+    // offsets and sizes must stay within the file; compute in 64 bits
+    const uint64_t lod_end = hdr.lod_offset + uint64_t(sizeof(Lod)) * hdr.lod_count;
+    const uint64_t vertex_end = hdr.vertex_offset + uint64_t(hdr.vertex_stride) * hdr.vertex_count;
+    const uint64_t index_end = hdr.index_offset + uint64_t(hdr.index_size) * hdr.index_count;
+    if (hdr.lod_count == 0 || hdr.lod_offset % 4 || hdr.vertex_offset % 16 || hdr.index_offset % 16 || lod_end > file_.size() ||
+        vertex_end > file_.size() || index_end > file_.size() || (hdr.index_size != 2 && hdr.index_size != 4))
+        throw std::runtime_error(path + " is truncated or corrupt");
+
+    for (uint32_t i = 0; i < hdr.lod_count; i++) {
+        const Lod &l = lod(i);
+        if (uint64_t(l.first_index) + l.index_count > hdr.index_count || l.index_count % 3)
+            throw std::runtime_error(path + " has a bad LOD table");
+    }
+
+    // the indices are used for vertex fetches on the GPU as they are
+    const uint8_t *indices = file_.data() + hdr.index_offset;
+    const uint32_t max = (hdr.index_size == 2) ? max_index<uint16_t>(indices, hdr.index_count)
+                                               : max_index<uint32_t>(indices, hdr.index_count);
+    if (hdr.index_count && max >= hdr.vertex_count) throw std::runtime_error(path + " has out-of-range indices");
+}
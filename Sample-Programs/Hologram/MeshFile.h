@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+
+// A read-only mapping of a mesh file written by mesh-convert.  The vertex
+// and index streams are stored in the layout the vertex input state expects
+// and can be copied to a buffer as they are.
+//
+// All fields are little endian.  The header is followed by the LOD table;
+// the streams start at 16-byte aligned offsets.
+class MeshFile {
+   public:
+    static const uint32_t current_version = 1;
+
+    struct Header {
+        char magic[4];  // "HMSH"
+        uint32_t version;
+
+        uint32_t vertex_stride;
+        uint32_t vertex_count;
+        uint32_t index_size;
+        // of all LODs together
+        uint32_t index_count;
+        uint32_t lod_count;
+        uint32_t reserved;
+
+        // of the positions
+        float bounds_min[3];
+        float bounds_max[3];
+
+        uint64_t lod_offset;
+        uint64_t vertex_offset;
+        uint64_t index_offset;
+    };
+
+    // a range of the index stream; LOD 0 is the full mesh
+    struct Lod {
+        uint32_t first_index;
+        uint32_t index_count;
+        // the largest distance a vertex was moved, in object space
+        float error;
+        uint32_t reserved;
+    };
+
+    // throws std::runtime_error when the file cannot be mapped or is not a
+    // valid mesh file
+    explicit MeshFile(const std::string &path);
+
+    MeshFile(const MeshFile &file) = delete;
+    MeshFile &operator=(const MeshFile &file) = delete;
+
+    const Header &header() const { return *reinterpret_cast<const Header *>(file_.data()); }
+    const Lod &lod(uint32_t index) const { return reinterpret_cast<const Lod *>(file_.data() + header().lod_offset)[index]; }
+
+    const void *vertices() const { return file_.data() + header().vertex_offset; }
+    size_t vertex_data_size() const { return size_t(header().vertex_stride) * header().vertex_count; }
+
+    // the indices of lod, which are relative to the first vertex
+    const void *indices(const Lod &lod) const {
+        return file_.data() + header().index_offset + size_t(header().index_size) * lod.first_index;
+    }
+    size_t index_data_size(const Lod &lod) const { return size_t(header().index_size) * lod.index_count; }
+
+   private:
+    void validate(const std::string &path) const;
+
+    MappedFile file_;
+};
+
+#endif  // MESH_FILE_H
@@ -0,0 +1,773 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "MappedFile.h"
+#include "MeshLoader.h"
+#include "Parallel.h"
+
+namespace {
+
+// below these sizes, threads cost more than they save
+const size_t min_parallel_bytes = 256 * 1024;
+const size_t min_parallel_count = 16 * 1024;
+
+// marks a missing OBJ normal while parsing
+const int64_t no_index = INT64_MIN;
+
+double elapsed_ms(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+const char *skip_space(const char *p, const char *end) {
+    while (p < end && is_space(*p)) p++;
+    return p;
+}
+
+const char *line_end(const char *p, const char *end) {
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    return (eol) ? eol : end;
+}
+
+// the files are not NUL-terminated, so strtol and strtof cannot be used
+bool parse_int(const char *&p, const char *end, int64_t &val) {
+    const char *q = p;
+    const bool neg = (q < end && *q == '-');
+    if (q < end && (*q == '-' || *q == '+')) q++;
+
+    const char *digits = q;
+    int64_t v = 0;
+    while (q < end && *q >= '0' && *q <= '9' && v < INT64_MAX / 10) v = v * 10 + (*q++ - '0');
+    if (q == digits) return false;
+
+    val = (neg) ? -v : v;
+    p = q;
+    return true;
+}
+
+double pow10(int exp) {
+    static const double exact[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    return (exp <= 22) ? exact[exp] : std::pow(10.0, exp);
+}
+
+bool parse_float(const char *&p, const char *end, float &val) {
+    const char *q = p;
+    const bool neg = (q < end && *q == '-');
+    if (q < end && (*q == '-' || *q == '+')) q++;
+
+    // 19 significant digits are more than a float needs
+    uint64_t mantissa = 0;
+    int exp = 0;
+    bool any = false;
+    for (; q < end && *q >= '0' && *q <= '9'; q++, any = true) {
+        if (mantissa < UINT64_C(1000000000000000000))
+            mantissa = mantissa * 10 + (*q - '0');
+        else
+            exp++;
+    }
+    if (q < end && *q == '.') {
+        for (q++; q < end && *q >= '0' && *q <= '9'; q++, any = true) {
+            if (mantissa < UINT64_C(1000000000000000000)) {
+                mantissa = mantissa * 10 + (*q - '0');
+                exp--;
+            }
+        }
+    }
+    if (!any) return false;
+
+    if (q < end && (*q == 'e' || *q == 'E')) {
+        const char *e = q + 1;
+        int64_t e_val;
+        if (parse_int(e, end, e_val)) {
+            exp += static_cast<int>(std::max<int64_t>(-400, std::min<int64_t>(e_val, 400)));
+            q = e;
+        }
+    }
+
+    double v = static_cast<double>(mantissa);
+    v = (exp >= 0) ? v * pow10(exp) : v / pow10(-exp);
+    val = static_cast<float>((neg) ? -v : v);
+    p = q;
+    return true;
+}
+
+// split [begin, end) into count pieces that start at lines
+std::vector<const char *> split_lines(const char *begin, const char *end, int count) {
+    std::vector<const char *> bounds(count + 1);
+    bounds[0] = begin;
+    for (int i = 1; i < count; i++) {
+        const char *p = std::max(begin + (end - begin) * i / count, bounds[i - 1]);
+        if (p > begin && p[-1] != '\n') p = std::min(line_end(p, end) + 1, end);
+        bounds[i] = p;
+    }
+    bounds[count] = end;
+
+    return bounds;
+}
+
+enum PlyType {
+    PLY_INT8,
+    PLY_UINT8,
+    PLY_INT16,
+    PLY_UINT16,
+    PLY_INT32,
+    PLY_UINT32,
+    PLY_FLOAT32,
+    PLY_FLOAT64,
+};
+
+struct PlyProperty {
+    std::string name;
+    PlyType type;
+    // the type of the element count of a list
+    bool is_list;
+    PlyType count_type;
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count;
+    std::vector<PlyProperty> properties;
+};
+
+PlyType ply_type(const std::string &name) {
+    static const std::unordered_map<std::string, PlyType> types = {
+        {"char", PLY_INT8},     {"int8", PLY_INT8},     {"uchar", PLY_UINT8},     {"uint8", PLY_UINT8},
+        {"short", PLY_INT16},   {"int16", PLY_INT16},   {"ushort", PLY_UINT16},   {"uint16", PLY_UINT16},
+        {"int", PLY_INT32},     {"int32", PLY_INT32},   {"uint", PLY_UINT32},     {"uint32", PLY_UINT32},
+        {"float", PLY_FLOAT32}, {"float32", PLY_FLOAT32}, {"double", PLY_FLOAT64}, {"float64", PLY_FLOAT64},
+    };
+
+    auto it = types.find(name);
+    if (it == types.end()) throw std::runtime_error("unknown PLY type " + name);
+    return it->second;
+}
+
+size_t ply_size(PlyType type) {
+    switch (type) {
+        case PLY_INT8:
+        case PLY_UINT8:
+            return 1;
+        case PLY_INT16:
+        case PLY_UINT16:
+            return 2;
+        case PLY_INT32:
+        case PLY_UINT32:
+        case PLY_FLOAT32:
+        default:
+            return 4;
+        case PLY_FLOAT64:
+            return 8;
+    }
+}
+
+double ply_read(const uint8_t *p, PlyType type, bool swap) {
+    uint8_t bytes[8];
+    const size_t size = ply_size(type);
+    for (size_t i = 0; i < size; i++) bytes[i] = p[(swap) ? size - 1 - i : i];
+
+    switch (type) {
+        case PLY_INT8:
+            return static_cast<int8_t>(bytes[0]);
+        case PLY_UINT8:
+            return bytes[0];
+        case PLY_INT16: {
+            int16_t v;
+            memcpy(&v, bytes, sizeof(v));
+            return v;
+        }
+        case PLY_UINT16: {
+            uint16_t v;
+            memcpy(&v, bytes, sizeof(v));
+            return v;
+        }
+        case PLY_INT32: {
+            int32_t v;
+            memcpy(&v, bytes, sizeof(v));
+            return v;
+        }
+        case PLY_UINT32: {
+            uint32_t v;
+            memcpy(&v, bytes, sizeof(v));
+            return v;
+        }
+        case PLY_FLOAT32: {
+            float v;
+            memcpy(&v, bytes, sizeof(v));
+            return v;
+        }
+        case PLY_FLOAT64:
+        default: {
+            double v;
+            memcpy(&v, bytes, sizeof(v));
+            return v;
+        }
+    }
+}
+
+struct VertexKey {
+    std::array<uint32_t, 6> bits;
+
+    bool operator==(const VertexKey &other) const { return bits == other.bits; }
+};
+
+uint64_t hash_key(const VertexKey &key) {
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    for (auto b : key.bits) h = (h ^ b) * UINT64_C(0x100000001b3);
+    return h ^ (h >> 32);
+}
+
+}  // namespace
+
+// what a thread parsed; OBJ indices are resolved once all chunks are done
+struct MeshLoader::Chunk {
+    struct RawCorner {
+        int64_t position;
+        int64_t normal;
+        // whether the indices count back from the end of this chunk's lists
+        bool relative_position;
+        bool relative_normal;
+    };
+
+    std::vector<std::array<float, 3>> positions;
+    std::vector<std::array<float, 3>> normals;
+    std::vector<RawCorner> corners;
+
+    // the first line that failed to parse
+    const char *error;
+
+    Chunk() : error(nullptr) {}
+};
+
+MeshLoader::MeshLoader(const std::string &path, int thread_count)
+    : path_(path), thread_count_(std::max(thread_count, 1)), stats_() {
+    auto begin = std::chrono::steady_clock::now();
+    {
+        const MappedFile file(path);
+
+        const std::string ext = path.substr(path.find_last_of('.') + 1);
+        if (ext == "obj" || ext == "OBJ")
+            parse_obj(file);
+        else if (ext == "ply" || ext == "PLY")
+            parse_ply(file);
+        else
+            throw std::runtime_error(path + " is neither an OBJ nor a PLY file");
+    }
+    stats_.parse_ms = elapsed_ms(begin);
+    stats_.corner_count = corners_.size();
+
+    if (corners_.empty()) throw std::runtime_error(path + " has no faces");
+
+    // all or nothing; vertices are welded by position alone otherwise
+    const bool has_normals =
+        !normals_.empty() && std::all_of(corners_.begin(), corners_.end(), [](const Corner &c) { return c.normal >= 0; });
+    if (!has_normals) {
+        normals_.clear();
+        for (auto &c : corners_) c.normal = -1;
+    }
+
+    begin = std::chrono::steady_clock::now();
+    weld();
+    stats_.weld_ms = elapsed_ms(begin);
+
+    begin = std::chrono::steady_clock::now();
+    if (!has_normals) generate_normals();
+    stats_.normal_ms = elapsed_ms(begin);
+
+    normalize();
+
+    stats_.vertex_count = positions_.size();
+    stats_.face_count = faces_.size();
+}
+
+void MeshLoader::parse_obj(const MappedFile &file) {
+    const char *data = reinterpret_cast<const char *>(file.data());
+    const auto bounds = split_lines(data, data + file.size(), thread_count_);
+
+    std::vector<Chunk> chunks(thread_count_);
+    for_each_chunk(file.size(), thread_count_, min_parallel_bytes, [&bounds, &chunks](int c, size_t, size_t) {
+        Chunk &chunk = chunks[c];
+        const char *end = bounds[c + 1];
+
+        for (const char *line = bounds[c]; line < end && !chunk.error; line = line_end(line, end) + 1) {
+            const char *eol = line_end(line, end);
+            const char *p = skip_space(line, eol);
+            if (eol - p < 2) continue;
+            const bool is_normal = (p[0] == 'v' && p[1] == 'n' && eol - p > 2 && is_space(p[2]));
+            const bool is_position = (p[0] == 'v' && is_space(p[1]));
+            const bool is_face = (p[0] == 'f' && is_space(p[1]));
+
+            if (is_position || is_normal) {
+                std::array<float, 3> vec;
+                p += (is_normal) ? 2 : 1;
+                for (auto &v : vec) {
+                    p = skip_space(p, eol);
+                    if (!parse_float(p, eol, v)) chunk.error = line;
+                }
+
+                if (is_normal)
+                    chunk.normals.push_back(vec);
+                else
+                    chunk.positions.push_back(vec);
+            } else if (is_face) {
+                Chunk::RawCorner first = {}, prev = {};
+                int count = 0;
+                for (p = skip_space(p + 1, eol); p < eol && !chunk.error; p = skip_space(p, eol)) {
+                    Chunk::RawCorner corner = {};
+                    int64_t texcoord;
+                    corner.normal = no_index;
+                    if (!parse_int(p, eol, corner.position) || corner.position == 0) chunk.error = line;
+                    if (p < eol && *p == '/') {
+                        p++;
+                        parse_int(p, eol, texcoord);
+                        if (p < eol && *p == '/') {
+                            p++;
+                            if (!parse_int(p, eol, corner.normal) || corner.normal == 0) chunk.error = line;
+                        }
+                    }
+                    if (p < eol && !is_space(*p)) chunk.error = line;
+
+                    // 1-based, or counting back from the last vertex
+                    corner.relative_position = (corner.position < 0);
+                    corner.position += (corner.relative_position) ? static_cast<int64_t>(chunk.positions.size()) : -1;
+                    if (corner.normal != no_index) {
+                        corner.relative_normal = (corner.normal < 0);
+                        corner.normal += (corner.relative_normal) ? static_cast<int64_t>(chunk.normals.size()) : -1;
+                    }
+
+                    // triangulate as a fan
+                    if (count == 0) first = corner;
+                    if (count >= 2) {
+                        chunk.corners.push_back(first);
+                        chunk.corners.push_back(prev);
+                        chunk.corners.push_back(corner);
+                    }
+                    prev = corner;
+                    count++;
+                }
+            }
+        }
+    });
+
+    // concatenate the chunks and resolve the relative indices
+    size_t position_count = 0, normal_count = 0, corner_count = 0;
+    for (const auto &chunk : chunks) {
+        if (chunk.error) {
+            const char *line = chunk.error;
+            throw std::runtime_error(path_ + ": bad line \"" + std::string(line, line_end(line, data + file.size())) + "\"");
+        }
+        position_count += chunk.positions.size();
+        normal_count += chunk.normals.size();
+        corner_count += chunk.corners.size();
+    }
+
+    positions_.reserve(position_count);
+    normals_.reserve(normal_count);
+    corners_.reserve(corner_count);
+    for (const auto &chunk : chunks) {
+        const int64_t position_base = static_cast<int64_t>(positions_.size());
+        const int64_t normal_base = static_cast<int64_t>(normals_.size());
+        positions_.insert(positions_.end(), chunk.positions.begin(), chunk.positions.end());
+        normals_.insert(normals_.end(), chunk.normals.begin(), chunk.normals.end());
+
+        for (const auto &raw : chunk.corners) {
+            Corner corner;
+            corner.position = raw.position + ((raw.relative_position) ? position_base : 0);
+            corner.normal = (raw.normal == no_index) ? -1 : raw.normal + ((raw.relative_normal) ? normal_base : 0);
+            if (corner.position < 0 || corner.position >= static_cast<int64_t>(position_count) || corner.normal < -1 ||
+                corner.normal >= static_cast<int64_t>(normal_count))
+                throw std::runtime_error(path_ + " has a face index out of range");
+
+            corners_.push_back(corner);
+        }
+    }
+}
+
+void MeshLoader::parse_ply(const MappedFile &file) {
+    const char *data = reinterpret_cast<const char *>(file.data());
+    const char *end = data + file.size();
+
+    // the header is always text
+    std::string format;
+    std::vector<PlyElement> elements;
+    const char *body = nullptr;
+    for (const char *line = data; line < end && !body; line = line_end(line, end) + 1) {
+        const std::string text(line, line_end(line, end));
+        std::vector<std::string> words;
+        for (size_t pos = 0; pos < text.size();) {
+            const size_t word_end = std::min(text.find_first_of(" \t\r", pos), text.size());
+            if (word_end > pos) words.push_back(text.substr(pos, word_end - pos));
+            pos = word_end + 1;
+        }
+
+        if (line == data && (words.size() != 1 || words[0] != "ply")) throw std::runtime_error(path_ + " is not a PLY file");
+        if (words.empty()) continue;
+
+        if (words[0] == "format" && words.size() >= 2) {
+            format = words[1];
+        } else if (words[0] == "element" && words.size() == 3) {
+            elements.push_back(PlyElement{words[1], static_cast<size_t>(std::stoull(words[2])), {}});
+        } else if (words[0] == "property" && !elements.empty()) {
+            if (words.size() == 5 && words[1] == "list")
+                elements.back().properties.push_back(PlyProperty{words[4], ply_type(words[3]), true, ply_type(words[2])});
+            else if (words.size() == 3)
+                elements.back().properties.push_back(PlyProperty{words[2], ply_type(words[1]), false, PLY_UINT8});
+            else
+                throw std::runtime_error(path_ + ": bad property \"" + text + "\"");
+        } else if (words[0] == "end_header") {
+            body = std::min(line_end(line, end) + 1, end);
+        }
+    }
+    if (!body) throw std::runtime_error(path_ + " has no end_header");
+
+    const bool ascii = (format == "ascii");
+    const bool swap = (format == "binary_big_endian");
+    if (!ascii && !swap && format != "binary_little_endian") throw std::runtime_error(path_ + " has an unknown PLY format");
+
+    for (const auto &elem : elements) {
+        const bool is_vertex = (elem.name == "vertex");
+        const bool is_face = (elem.name == "face");
+
+        // where the properties we need are
+        int x = -1, nx = -1, indices = -1;
+        for (size_t i = 0; i < elem.properties.size(); i++) {
+            const auto &name = elem.properties[i].name;
+            if (name == "x") x = static_cast<int>(i);
+            if (name == "nx") nx = static_cast<int>(i);
+            if (name == "vertex_indices" || name == "vertex_index") indices = static_cast<int>(i);
+        }
+        if (is_vertex && (x < 0 || x + 2 >= static_cast<int>(elem.properties.size())))
+            throw std::runtime_error(path_ + " has no vertex positions");
+        if (is_face && indices < 0) throw std::runtime_error(path_ + " has no vertex_indices");
+        // y, z, ny and nz are assumed to follow x and nx
+        const bool has_normals = (is_vertex && nx >= 0 && nx + 2 < static_cast<int>(elem.properties.size()));
+
+        if (ascii) {
+            // find the lines of the element, then parse them in chunks
+            const char *elem_end = body;
+            for (size_t i = 0; i < elem.count && elem_end < end; i++) elem_end = line_end(elem_end, end) + 1;
+            elem_end = std::min(elem_end, end);
+
+            if (is_vertex || is_face) {
+                const auto bounds = split_lines(body, elem_end, thread_count_);
+                std::vector<Chunk> chunks(thread_count_);
+                for_each_chunk(static_cast<size_t>(elem_end - body), thread_count_, min_parallel_bytes, [&](int c, size_t, size_t) {
+                    Chunk &chunk = chunks[c];
+                    std::vector<float> values;
+                    for (const char *line = bounds[c]; line < bounds[c + 1] && !chunk.error; line = line_end(line, end) + 1) {
+                        const char *eol = line_end(line, end);
+                        const char *p = line;
+
+                        values.clear();
+                        int64_t first = 0, prev = 0;
+                        for (size_t i = 0; i < elem.properties.size() && !chunk.error; i++) {
+                            int64_t list_count = 1;
+                            p = skip_space(p, eol);
+                            if (elem.properties[i].is_list && !parse_int(p, eol, list_count)) chunk.error = line;
+
+                            for (int64_t j = 0; j < list_count && !chunk.error; j++) {
+                                float v;
+                                p = skip_space(p, eol);
+                                if (!parse_float(p, eol, v)) chunk.error = line;
+
+                                if (is_vertex) {
+                                    values.push_back(v);
+                                } else if (static_cast<int>(i) == indices) {
+                                    const int64_t idx = static_cast<int64_t>(v);
+                                    if (j == 0) first = idx;
+                                    if (j >= 2) {
+                                        chunk.corners.push_back(Chunk::RawCorner{first, -1, false, false});
+                                        chunk.corners.push_back(Chunk::RawCorner{prev, -1, false, false});
+                                        chunk.corners.push_back(Chunk::RawCorner{idx, -1, false, false});
+                                    }
+                                    prev = idx;
+                                }
+                            }
+                        }
+
+                        if (is_vertex && !chunk.error) {
+                            chunk.positions.push_back({{values[x], values[x + 1], values[x + 2]}});
+                            if (has_normals) chunk.normals.push_back({{values[nx], values[nx + 1], values[nx + 2]}});
+                        }
+                    }
+                });
+
+                for (const auto &chunk : chunks) {
+                    if (chunk.error) {
+                        const std::string line(chunk.error, line_end(chunk.error, end));
+                        throw std::runtime_error(path_ + ": bad line \"" + line + "\"");
+                    }
+
+                    positions_.insert(positions_.end(), chunk.positions.begin(), chunk.positions.end());
+                    normals_.insert(normals_.end(), chunk.normals.begin(), chunk.normals.end());
+                    for (const auto &raw : chunk.corners) corners_.push_back(Corner{raw.position, raw.position});
+                }
+            }
+
+            body = elem_end;
+            continue;
+        }
+
+        const bool fixed_size =
+            std::none_of(elem.properties.begin(), elem.properties.end(), [](const PlyProperty &prop) { return prop.is_list; });
+        if (fixed_size) {
+            std::vector<size_t> offsets;
+            size_t stride = 0;
+            for (const auto &prop : elem.properties) {
+                offsets.push_back(stride);
+                stride += ply_size(prop.type);
+            }
+            if (static_cast<size_t>(end - body) / std::max<size_t>(stride, 1) < elem.count)
+                throw std::runtime_error(path_ + " is truncated");
+
+            // records are independent
+            if (is_vertex) {
+                positions_.resize(elem.count);
+                if (has_normals) normals_.resize(elem.count);
+
+                const uint8_t *records = reinterpret_cast<const uint8_t *>(body);
+                for_each_chunk(elem.count, thread_count_, min_parallel_count, [&](int, size_t first, size_t last) {
+                    for (size_t i = first; i < last; i++) {
+                        const uint8_t *rec = records + stride * i;
+                        for (int k = 0; k < 3; k++) {
+                            const auto &pos_prop = elem.properties[x + k];
+                            positions_[i][k] = static_cast<float>(ply_read(rec + offsets[x + k], pos_prop.type, swap));
+                            if (!has_normals) continue;
+
+                            const auto &normal_prop = elem.properties[nx + k];
+                            normals_[i][k] = static_cast<float>(ply_read(rec + offsets[nx + k], normal_prop.type, swap));
+                        }
+                    }
+                });
+            }
+
+            body += stride * elem.count;
+            continue;
+        }
+
+        // records with lists have to be walked in order
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(body);
+        const uint8_t *bin_end = reinterpret_cast<const uint8_t *>(end);
+        for (size_t i = 0; i < elem.count; i++) {
+            for (size_t k = 0; k < elem.properties.size(); k++) {
+                const auto &prop = elem.properties[k];
+                size_t list_count = 1;
+                if (prop.is_list) {
+                    if (p + ply_size(prop.count_type) > bin_end) throw std::runtime_error(path_ + " is truncated");
+                    list_count = static_cast<size_t>(ply_read(p, prop.count_type, swap));
+                    p += ply_size(prop.count_type);
+                }
+
+                const size_t size = ply_size(prop.type);
+                if (static_cast<size_t>(bin_end - p) / size < list_count) throw std::runtime_error(path_ + " is truncated");
+                if (is_face && static_cast<int>(k) == indices) {
+                    const int64_t first = static_cast<int64_t>(ply_read(p, prop.type, swap));
+                    for (size_t j = 2; j < list_count; j++) {
+                        corners_.push_back(Corner{first, first});
+                        const int64_t b = static_cast<int64_t>(ply_read(p + size * (j - 1), prop.type, swap));
+                        const int64_t c = static_cast<int64_t>(ply_read(p + size * j, prop.type, swap));
+                        corners_.push_back(Corner{b, b});
+                        corners_.push_back(Corner{c, c});
+                    }
+                }
+                p += size * list_count;
+            }
+        }
+        body = reinterpret_cast<const char *>(p);
+    }
+
+    // PLY normals are per vertex
+    const int64_t vertex_count = static_cast<int64_t>(positions_.size());
+    for (auto &c : corners_) {
+        if (c.position < 0 || c.position >= vertex_count) throw std::runtime_error(path_ + " has a face index out of range");
+        if (normals_.empty()) c.normal = -1;
+    }
+}
+
+void MeshLoader::weld() {
+    const size_t corner_count = corners_.size();
+    const bool has_normals = !normals_.empty();
+
+    // Each thread owns the vertices whose hash falls in its shard, so no hash
+    // table is shared.  A vertex is numbered by its first corner within the
+    // shard and the shards are laid out one after another.
+    const size_t shard_count = static_cast<size_t>(thread_count_);
+    const size_t min_shard_count = (corner_count < min_parallel_count) ? shard_count + 1 : 0;
+
+    // hash the corners and count them by chunk and shard
+    std::vector<VertexKey> keys(corner_count);
+    std::vector<uint64_t> hashes(corner_count);
+    std::vector<size_t> counts(shard_count * thread_count_, 0);
+    for_each_chunk(corner_count, thread_count_, min_parallel_count, [&](int chunk, size_t begin, size_t end) {
+        size_t *chunk_counts = &counts[shard_count * chunk];
+        for (size_t i = begin; i < end; i++) {
+            const auto &pos = positions_[corners_[i].position];
+            const std::array<float, 3> normal =
+                (has_normals) ? normals_[corners_[i].normal] : std::array<float, 3>{{0.0f, 0.0f, 0.0f}};
+            memcpy(&keys[i].bits[0], pos.data(), sizeof(pos));
+            memcpy(&keys[i].bits[3], normal.data(), sizeof(normal));
+            hashes[i] = hash_key(keys[i]);
+            chunk_counts[hashes[i] % shard_count]++;
+        }
+    });
+
+    // bucket the corners by shard in a single pass, keeping them in order
+    // within each shard; shard s gets [bucket_offsets[s], bucket_offsets[s + 1])
+    std::vector<size_t> bucket_offsets(shard_count + 1, 0);
+    std::vector<size_t> chunk_offsets(counts.size());
+    for (size_t shard = 0; shard < shard_count; shard++) {
+        size_t offset = bucket_offsets[shard];
+        for (int chunk = 0; chunk < thread_count_; chunk++) {
+            chunk_offsets[shard_count * chunk + shard] = offset;
+            offset += counts[shard_count * chunk + shard];
+        }
+        bucket_offsets[shard + 1] = offset;
+    }
+
+    std::vector<uint32_t> buckets(corner_count);
+    for_each_chunk(corner_count, thread_count_, min_parallel_count, [&](int chunk, size_t begin, size_t end) {
+        size_t *next = &chunk_offsets[shard_count * chunk];
+        for (size_t i = begin; i < end; i++) buckets[next[hashes[i] % shard_count]++] = static_cast<uint32_t>(i);
+    });
+
+    std::vector<uint32_t> corner_vertices(corner_count);
+    std::vector<std::vector<uint32_t>> shard_corners(thread_count_);
+    for_each_chunk(shard_count, thread_count_, min_shard_count, [&](int shard, size_t, size_t) {
+        const uint32_t *bucket = buckets.data() + bucket_offsets[shard];
+        const size_t bucket_size = bucket_offsets[shard + 1] - bucket_offsets[shard];
+
+        // open addressing over vertex numbers, at most half full
+        size_t mask = 1;
+        while (mask < bucket_size * 2 + 16) mask <<= 1;
+        mask--;
+        std::vector<uint32_t> table(mask + 1, UINT32_MAX);
+
+        auto &firsts = shard_corners[shard];
+        for (size_t j = 0; j < bucket_size; j++) {
+            const uint32_t i = bucket[j];
+
+            // the low bits picked the shard
+            size_t slot = (hashes[i] / shard_count) & mask;
+            while (table[slot] != UINT32_MAX && !(keys[firsts[table[slot]]] == keys[i])) slot = (slot + 1) & mask;
+
+            if (table[slot] == UINT32_MAX) {
+                table[slot] = static_cast<uint32_t>(firsts.size());
+                firsts.push_back(i);
+            }
+            corner_vertices[i] = table[slot];
+        }
+    });
+
+    std::vector<uint32_t> shard_offsets(shard_count + 1, 0);
+    for (size_t s = 0; s < shard_count; s++)
+        shard_offsets[s + 1] = shard_offsets[s] + static_cast<uint32_t>(shard_corners[s].size());
+
+    std::vector<std::array<float, 3>> positions(shard_offsets[shard_count]);
+    std::vector<std::array<float, 3>> normals((has_normals) ? positions.size() : 0);
+    for_each_chunk(shard_count, thread_count_, min_shard_count, [&](int shard, size_t, size_t) {
+        const auto &firsts = shard_corners[shard];
+        for (size_t v = 0; v < firsts.size(); v++) {
+            const Corner &corner = corners_[firsts[v]];
+            positions[shard_offsets[shard] + v] = positions_[corner.position];
+            if (has_normals) normals[shard_offsets[shard] + v] = normals_[corner.normal];
+        }
+    });
+
+    faces_.resize(corner_count / 3);
+    for_each_chunk(faces_.size(), thread_count_, min_parallel_count, [&](int, size_t begin, size_t end) {
+        for (size_t f = begin; f < end; f++) {
+            for (int k = 0; k < 3; k++) {
+                const size_t i = f * 3 + k;
+                faces_[f][k] = shard_offsets[hashes[i] % shard_count] + corner_vertices[i];
+            }
+        }
+    });
+
+    // faces that welding collapsed
+    faces_.erase(std::remove_if(faces_.begin(), faces_.end(),
+                                [](const std::array<uint32_t, 3> &f) { return f[0] == f[1] || f[1] == f[2] || f[2] == f[0]; }),
+                 faces_.end());
+
+    positions_.swap(positions);
+    normals_.swap(normals);
+    std::vector<Corner>().swap(corners_);
+}
+
+void MeshLoader::generate_normals() {
+    // area-weighted face normals, summed per vertex
+    std::vector<std::array<float, 3>> face_normals(faces_.size());
+    for_each_chunk(faces_.size(), thread_count_, min_parallel_count, [this, &face_normals](int, size_t begin, size_t end) {
+        for (size_t f = begin; f < end; f++) {
+            const auto &a = positions_[faces_[f][0]];
+            const auto &b = positions_[faces_[f][1]];
+            const auto &c = positions_[faces_[f][2]];
+            const float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            const float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+            face_normals[f] = {{e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]}};
+        }
+    });
+
+    // the scatter is a few adds per corner; it is not worth splitting
+    normals_.assign(positions_.size(), std::array<float, 3>{{0.0f, 0.0f, 0.0f}});
+    for (size_t f = 0; f < faces_.size(); f++) {
+        for (auto v : faces_[f]) {
+            for (int k = 0; k < 3; k++) normals_[v][k] += face_normals[f][k];
+        }
+    }
+
+    for_each_chunk(normals_.size(), thread_count_, min_parallel_count, [this](int, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            auto &n = normals_[i];
+            const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (len > 0.0f) {
+                for (auto &c : n) c /= len;
+            }
+        }
+    });
+}
+
+void MeshLoader::normalize() {
+    std::array<float, 3> lo = positions_[0], hi = positions_[0];
+    for (const auto &pos : positions_) {
+        for (int k = 0; k < 3; k++) {
+            lo[k] = std::min(lo[k], pos[k]);
+            hi[k] = std::max(hi[k], pos[k]);
+        }
+    }
+
+    float half_extent = 0.0f;
+    std::array<float, 3> center;
+    for (int k = 0; k < 3; k++) {
+        center[k] = (lo[k] + hi[k]) / 2.0f;
+        half_extent = std::max(half_extent, (hi[k] - lo[k]) / 2.0f);
+    }
+    const float scale = (half_extent > 0.0f) ? 1.0f / half_extent : 1.0f;
+
+    for_each_chunk(positions_.size(), thread_count_, min_parallel_count, [this, &center, scale](int, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            for (int k = 0; k < 3; k++) positions_[i][k] = (positions_[i][k] - center[k]) * scale;
+        }
+    });
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// Loads a triangle mesh from an OBJ or PLY file.  The file is mapped and
+// parsed in chunks on thread_count threads.  Vertices with the same position
+// and normal are welded with a hash table, normals missing from the file are
+// generated from the faces, and the mesh is centered and scaled so that its
+// largest half extent is 1, like the builtin meshes.
+class MeshLoader {
+   public:
+    struct Stats {
+        double parse_ms;
+        double weld_ms;
+        double normal_ms;
+
+        // face corners in the file, after triangulation
+        size_t corner_count;
+        // after welding
+        size_t vertex_count;
+        size_t face_count;
+    };
+
+    // throws std::runtime_error when the file cannot be read or parsed
+    MeshLoader(const std::string &path, int thread_count);
+
+    const std::vector<std::array<float, 3>> &positions() const { return positions_; }
+    const std::vector<std::array<float, 3>> &normals() const { return normals_; }
+    const std::vector<std::array<uint32_t, 3>> &faces() const { return faces_; }
+
+    const Stats &stats() const { return stats_; }
+
+   private:
+    // a face corner; normal is -1 when the file has none
+    struct Corner {
+        int64_t position;
+        int64_t normal;
+    };
+
+    struct Chunk;
+
+    void parse_obj(const MappedFile &file);
+    void parse_ply(const MappedFile &file);
+
+    void weld();
+    void generate_normals();
+    void normalize();
+
+    const std::string path_;
+    const int thread_count_;
+
+    // as parsed; replaced by the welded vertices
+    std::vector<std::array<float, 3>> positions_;
+    std::vector<std::array<float, 3>> normals_;
+    std::vector<Corner> corners_;
+
+    std::vector<std::array<uint32_t, 3>> faces_;
+
+    Stats stats_;
+};
+
+#endif  // MESH_LOADER_H
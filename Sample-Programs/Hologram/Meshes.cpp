@@ -14,13 +14,19 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstring>
 #include <array>
-#include <unordered_map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
 
 #include "Helpers.h"
+#include "Icosphere.h"
+#include "MeshFile.h"
+#include "MeshLoader.h"
 #include "Meshes.h"
 
 namespace {
@@ -87,6 +93,16 @@ class Mesh {
         return ia_info;
     }
 
+    // the streams of LOD 0 are copied from the file as they are, unless
+    // unpack is called
+    void load(const std::string &path) {
+        file_.reset(new MeshFile(path));
+
+        const auto &hdr = file_->header();
+        if (hdr.vertex_stride != vertex_stride() || hdr.index_size != sizeof(uint32_t))
+            throw std::runtime_error(path + " does not use the Hologram vertex format");
+    }
+
     void build(const std::vector<std::array<float, 6>> &vertices, const std::vector<std::array<int, 3>> &faces) {
         positions_.reserve(vertices.size());
         normals_.reserve(vertices.size());
@@ -99,11 +115,51 @@ class Mesh {
         for (const auto &f : faces) faces_.emplace_back(Face{f[0], f[1], f[2]});
     }
 
-    uint32_t vertex_count() const { return static_cast<uint32_t>(positions_.size()); }
+    // replace the file by the vectors
+    void unpack() {
+        if (!file_) return;
+
+        const float *src = reinterpret_cast<const float *>(file_->vertices());
+        positions_.reserve(file_->header().vertex_count);
+        normals_.reserve(file_->header().vertex_count);
+        for (uint32_t i = 0; i < file_->header().vertex_count; i++) {
+            positions_.emplace_back(Position{src[0], src[1], src[2]});
+            normals_.emplace_back(Normal{src[3], src[4], src[5]});
+            src += 6;
+        }
+
+        const auto &lod = file_->lod(0);
+        const uint32_t *indices = reinterpret_cast<const uint32_t *>(file_->indices(lod));
+        faces_.reserve(lod.index_count / 3);
+        for (uint32_t i = 0; i < lod.index_count; i += 3) {
+            faces_.emplace_back(
+                Face{static_cast<int>(indices[i + 0]), static_cast<int>(indices[i + 1]), static_cast<int>(indices[i + 2])});
+        }
+
+        file_.reset();
+    }
+
+    // reorders the faces
+    std::vector<Meshlets::Meshlet> build_meshlets() {
+        unpack();
+
+        static_assert(sizeof(Position) == sizeof(float) * 3 && sizeof(Face) == sizeof(uint32_t) * 3, "unexpected padding");
+        const Meshlets meshlets(&positions_[0].x, positions_.size(), reinterpret_cast<uint32_t *>(faces_.data()),
+                                faces_.size() * 3);
+
+        return meshlets.meshlets();
+    }
+
+    uint32_t vertex_count() const { return (file_) ? file_->header().vertex_count : static_cast<uint32_t>(positions_.size()); }
 
     VkDeviceSize vertex_buffer_size() const { return vertex_stride() * vertex_count(); }
 
     void vertex_buffer_write(void *data) const {
+        if (file_) {
+            memcpy(data, file_->vertices(), file_->vertex_data_size());
+            return;
+        }
+
         float *dst = reinterpret_cast<float *>(data);
         for (size_t i = 0; i < positions_.size(); i++) {
             const Position &pos = positions_[i];
@@ -118,11 +174,16 @@ class Mesh {
         }
     }
 
-    uint32_t index_count() const { return static_cast<uint32_t>(faces_.size() * 3); }
+    uint32_t index_count() const { return (file_) ? file_->lod(0).index_count : static_cast<uint32_t>(faces_.size() * 3); }
 
     VkDeviceSize index_buffer_size() const { return sizeof(uint32_t) * index_count(); }
 
     void index_buffer_write(void *data) const {
+        if (file_) {
+            memcpy(data, file_->indices(file_->lod(0)), file_->index_data_size(file_->lod(0)));
+            return;
+        }
+
         uint32_t *dst = reinterpret_cast<uint32_t *>(data);
         for (const auto &face : faces_) {
             dst[0] = face.v0;
@@ -135,6 +196,9 @@ class Mesh {
     std::vector<Position> positions_;
     std::vector<Normal> normals_;
     std::vector<Face> faces_;
+
+    // replaces the vectors when set
+    std::unique_ptr<MeshFile> file_;
 };
 
 class BuildPyramid {
@@ -157,158 +221,28 @@ class BuildPyramid {
 
 class BuildIcosphere {
    public:
-    BuildIcosphere(Mesh &mesh) : mesh_(mesh), radius_(1.0f) {
-        const int tessellate_level = 2;
-
-        build_icosahedron();
-        for (int i = 0; i < tessellate_level; i++) tessellate();
-    }
-
-   private:
-    void build_icosahedron() {
-        // https://en.wikipedia.org/wiki/Regular_icosahedron
-        const float l1 = std::sqrt(2.0f / (5.0f + std::sqrt(5.0f))) * radius_;
-        const float l2 = std::sqrt(2.0f / (5.0f - std::sqrt(5.0f))) * radius_;
-        // vertices are from three golden rectangles
-        const std::vector<std::array<float, 6>> icosahedron_vertices = {
-            //   position           normal
-            {
-                -l1, -l2, 0.0f, -l1, -l2, 0.0f,
-            },
-            {
-                l1, -l2, 0.0f, l1, -l2, 0.0f,
-            },
-            {
-                l1, l2, 0.0f, l1, l2, 0.0f,
-            },
-            {
-                -l1, l2, 0.0f, -l1, l2, 0.0f,
-            },
-
-            {
-                -l2, 0.0f, -l1, -l2, 0.0f, -l1,
-            },
-            {
-                l2, 0.0f, -l1, l2, 0.0f, -l1,
-            },
-            {
-                l2, 0.0f, l1, l2, 0.0f, l1,
-            },
-            {
-                -l2, 0.0f, l1, -l2, 0.0f, l1,
-            },
-
-            {
-                0.0f, -l1, -l2, 0.0f, -l1, -l2,
-            },
-            {
-                0.0f, l1, -l2, 0.0f, l1, -l2,
-            },
-            {
-                0.0f, l1, l2, 0.0f, l1, l2,
-            },
-            {
-                0.0f, -l1, l2, 0.0f, -l1, l2,
-            },
-        };
-        const std::vector<std::array<int, 3>> icosahedron_faces = {
-            // triangles sharing vertex 0
-            {0, 1, 11},
-            {0, 11, 7},
-            {0, 7, 4},
-            {0, 4, 8},
-            {0, 8, 1},
-            // adjacent triangles
-            {11, 1, 6},
-            {7, 11, 10},
-            {4, 7, 3},
-            {8, 4, 9},
-            {1, 8, 5},
-            // triangles sharing vertex 2
-            {2, 3, 10},
-            {2, 10, 6},
-            {2, 6, 5},
-            {2, 5, 9},
-            {2, 9, 3},
-            // adjacent triangles
-            {10, 3, 7},
-            {6, 10, 11},
-            {5, 6, 1},
-            {9, 5, 8},
-            {3, 9, 4},
-        };
-
-        mesh_.build(icosahedron_vertices, icosahedron_faces);
-    }
-
-    void tessellate() {
-        size_t middle_point_count = mesh_.faces_.size() * 3 / 2;
-        size_t final_face_count = mesh_.faces_.size() * 4;
-
-        std::vector<Mesh::Face> faces;
-        faces.reserve(final_face_count);
-
-        middle_points_.clear();
-        middle_points_.reserve(middle_point_count);
-
-        mesh_.positions_.reserve(mesh_.vertex_count() + middle_point_count);
-        mesh_.normals_.reserve(mesh_.vertex_count() + middle_point_count);
-
-        for (const auto &f : mesh_.faces_) {
-            int v0 = f.v0;
-            int v1 = f.v1;
-            int v2 = f.v2;
-
-            int v01 = add_middle_point(v0, v1);
-            int v12 = add_middle_point(v1, v2);
-            int v20 = add_middle_point(v2, v0);
-
-            faces.emplace_back(Mesh::Face{v0, v01, v20});
-            faces.emplace_back(Mesh::Face{v1, v12, v01});
-            faces.emplace_back(Mesh::Face{v2, v20, v12});
-            faces.emplace_back(Mesh::Face{v01, v12, v20});
+    BuildIcosphere(Mesh &mesh, int level) {
+        const Icosphere sphere(1.0f, level, static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)));
+
+        mesh.positions_.reserve(sphere.positions().size());
+        mesh.normals_.reserve(sphere.positions().size());
+        for (const auto &pos : sphere.positions()) {
+            mesh.positions_.emplace_back(Mesh::Position{pos[0], pos[1], pos[2]});
+            // the radius is 1
+            mesh.normals_.emplace_back(Mesh::Normal{pos[0], pos[1], pos[2]});
         }
 
-        mesh_.faces_.swap(faces);
-    }
-
-    int add_middle_point(int a, int b) {
-        uint64_t key = (a < b) ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
-        auto it = middle_points_.find(key);
-        if (it != middle_points_.end()) return it->second;
-
-        const Mesh::Position &pos_a = mesh_.positions_[a];
-        const Mesh::Position &pos_b = mesh_.positions_[b];
-        Mesh::Position pos_mid = {
-            (pos_a.x + pos_b.x) / 2.0f, (pos_a.y + pos_b.y) / 2.0f, (pos_a.z + pos_b.z) / 2.0f,
-        };
-        float scale = radius_ / std::sqrt(pos_mid.x * pos_mid.x + pos_mid.y * pos_mid.y + pos_mid.z * pos_mid.z);
-        pos_mid.x *= scale;
-        pos_mid.y *= scale;
-        pos_mid.z *= scale;
-
-        Mesh::Normal normal_mid = {pos_mid.x, pos_mid.y, pos_mid.z};
-        normal_mid.x /= radius_;
-        normal_mid.y /= radius_;
-        normal_mid.z /= radius_;
-
-        mesh_.positions_.emplace_back(pos_mid);
-        mesh_.normals_.emplace_back(normal_mid);
-
-        int mid = mesh_.vertex_count() - 1;
-        middle_points_.emplace(std::make_pair(key, mid));
-
-        return mid;
+        mesh.faces_.reserve(sphere.faces().size());
+        for (const auto &f : sphere.faces())
+            mesh.faces_.emplace_back(Mesh::Face{static_cast<int>(f[0]), static_cast<int>(f[1]), static_cast<int>(f[2])});
     }
-
-    Mesh &mesh_;
-    const float radius_;
-    std::unordered_map<uint64_t, uint32_t> middle_points_;
 };
 
+#ifdef HOLOGRAM_BUILTIN_TEAPOT
+
 class BuildTeapot {
    public:
-    BuildTeapot(Mesh &mesh) {
+    BuildTeapot(Mesh &mesh, const std::string &) {
 #include "Meshes.teapot.h"
         const int position_count = sizeof(teapot_positions) / sizeof(teapot_positions[0]);
         const int index_count = sizeof(teapot_indices) / sizeof(teapot_indices[0]);
@@ -364,15 +298,41 @@ class BuildTeapot {
     }
 };
 
-void build_meshes(std::array<Mesh, Meshes::MESH_COUNT> &meshes) {
+#else  // HOLOGRAM_BUILTIN_TEAPOT
+
+// teapot.hmsh is generated from Meshes.teapot.h by mesh-convert, which
+// applies the same normalization as the builtin teapot
+class BuildTeapot {
+   public:
+    BuildTeapot(Mesh &mesh, const std::string &mesh_dir) { mesh.load(mesh_dir + "/teapot.hmsh"); }
+};
+
+#endif  // HOLOGRAM_BUILTIN_TEAPOT
+
+class BuildLoaded {
+   public:
+    BuildLoaded(Mesh &mesh, const MeshLoader &loader) {
+        mesh.positions_.reserve(loader.positions().size());
+        mesh.normals_.reserve(loader.normals().size());
+        for (const auto &pos : loader.positions()) mesh.positions_.emplace_back(Mesh::Position{pos[0], pos[1], pos[2]});
+        for (const auto &normal : loader.normals()) mesh.normals_.emplace_back(Mesh::Normal{normal[0], normal[1], normal[2]});
+
+        mesh.faces_.reserve(loader.faces().size());
+        for (const auto &f : loader.faces())
+            mesh.faces_.emplace_back(Mesh::Face{static_cast<int>(f[0]), static_cast<int>(f[1]), static_cast<int>(f[2])});
+    }
+};
+
+void build_meshes(std::vector<Mesh> &meshes, const std::string &mesh_dir, int icosphere_level) {
     BuildPyramid build_pyramid(meshes[Meshes::MESH_PYRAMID]);
-    BuildIcosphere build_icosphere(meshes[Meshes::MESH_ICOSPHERE]);
-    BuildTeapot build_teapot(meshes[Meshes::MESH_TEAPOT]);
+    BuildIcosphere build_icosphere(meshes[Meshes::MESH_ICOSPHERE], icosphere_level);
+    BuildTeapot build_teapot(meshes[Meshes::MESH_TEAPOT], mesh_dir);
 }
 
 }  // namespace
 
-Meshes::Meshes(VkDevice dev, const std::vector<VkMemoryPropertyFlags> &mem_flags)
+Meshes::Meshes(VkDevice dev, const std::vector<VkMemoryPropertyFlags> &mem_flags, const std::string &mesh_dir,
+               int icosphere_level, const std::vector<std::string> &extra_mesh_files, bool meshlets)
     : dev_(dev),
       vertex_input_binding_(Mesh::vertex_input_binding()),
       vertex_input_attrs_(Mesh::vertex_input_attributes()),
@@ -385,8 +345,21 @@ Meshes::Meshes(VkDevice dev, const std::vector<VkMemoryPropertyFlags> &mem_flags
     vertex_input_state_.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_input_attrs_.size());
     vertex_input_state_.pVertexAttributeDescriptions = vertex_input_attrs_.data();
 
-    std::array<Mesh, MESH_COUNT> meshes;
-    build_meshes(meshes);
+    std::vector<Mesh> meshes(MESH_COUNT + extra_mesh_files.size());
+    build_meshes(meshes, mesh_dir, icosphere_level);
+
+    // after the builtin meshes, in order
+    const int thread_count = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    for (size_t i = 0; i < extra_mesh_files.size(); i++) {
+        const MeshLoader loader(extra_mesh_files[i], thread_count);
+        BuildLoaded build_loaded(meshes[MESH_COUNT + i], loader);
+        load_stats_.push_back(loader.stats());
+    }
+
+    if (meshlets) {
+        meshlets_.reserve(meshes.size());
+        for (auto &mesh : meshes) meshlets_.emplace_back(mesh.build_meshlets());
+    }
 
     draw_commands_.reserve(meshes.size());
     uint32_t first_index = 0;
@@ -402,6 +375,9 @@ Meshes::Meshes(VkDevice dev, const std::vector<VkMemoryPropertyFlags> &mem_flags
         draw.firstInstance = 0;
 
         draw_commands_.push_back(draw);
+        if (meshlets) {
+            for (auto &meshlet : meshlets_[draw_commands_.size() - 1]) meshlet.first_index += first_index;
+        }
 
         first_index += mesh.index_count();
         vertex_offset += mesh.vertex_count();
@@ -422,6 +398,15 @@ Meshes::Meshes(VkDevice dev, const std::vector<VkMemoryPropertyFlags> &mem_flags
         ib_data += mesh.index_buffer_size();
     }
 
+    if (!mem_coherent_) {
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = mem_;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vk::FlushMappedMemoryRanges(dev_, 1, &range);
+    }
+
     vk::UnmapMemory(dev_, mem_);
 }
 
@@ -438,9 +423,57 @@ void Meshes::cmd_bind_buffers(VkCommandBuffer cmd) const {
     vk::CmdBindIndexBuffer(cmd, ib_, 0, index_type_);
 }
 
-void Meshes::cmd_draw(VkCommandBuffer cmd, Type type) const {
+void Meshes::cmd_draw(VkCommandBuffer cmd, Type type, uint32_t first_instance) const {
     const auto &draw = draw_commands_[type];
-    vk::CmdDrawIndexed(cmd, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+    vk::CmdDrawIndexed(cmd, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, first_instance);
+}
+
+size_t Meshes::meshlet_count() const {
+    size_t count = 0;
+    for (const auto &meshlets : meshlets_) count += meshlets.size();
+    return count;
+}
+
+uint32_t Meshes::cmd_draw_visible(VkCommandBuffer cmd, Type type, const glm::mat4 &model, const Frustum &frustum,
+                                  const glm::vec3 &eye, bool back_faces_culled, uint32_t first_instance) const {
+    const auto &draw = draw_commands_[type];
+    const auto &meshlets = meshlets_[type];
+
+    // the cone test is done in mesh space; model scales uniformly
+    const glm::vec3 mesh_eye = glm::vec3(glm::inverse(model) * glm::vec4(eye, 1.0f));
+    const float scale = glm::length(glm::vec3(model[0]));
+
+    uint32_t culled = 0;
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    for (const auto &meshlet : meshlets) {
+        const glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+        const glm::vec3 cone_axis(meshlet.cone_axis[0], meshlet.cone_axis[1], meshlet.cone_axis[2]);
+        const glm::vec3 to_center = center - mesh_eye;
+
+        const bool facing_away =
+            back_faces_culled && glm::dot(to_center, cone_axis) >= meshlet.cone_cutoff * glm::length(to_center) + meshlet.radius;
+        const bool visible = !facing_away &&
+                             frustum.intersects_sphere(glm::vec3(model * glm::vec4(center, 1.0f)), meshlet.radius * scale);
+        if (!visible) {
+            culled++;
+            continue;
+        }
+
+        // meshlets are contiguous in the index buffer
+        if (index_count && first_index + index_count == meshlet.first_index) {
+            index_count += meshlet.index_count;
+            continue;
+        }
+
+        if (index_count) vk::CmdDrawIndexed(cmd, index_count, 1, first_index, draw.vertexOffset, first_instance);
+        first_index = meshlet.first_index;
+        index_count = meshlet.index_count;
+    }
+
+    if (index_count) vk::CmdDrawIndexed(cmd, index_count, 1, first_index, draw.vertexOffset, first_instance);
+
+    return culled;
 }
 
 void Meshes::allocate_resources(VkDeviceSize vb_size, VkDeviceSize ib_size, const std::vector<VkMemoryPropertyFlags> &mem_flags) {
@@ -466,16 +499,18 @@ void Meshes::allocate_resources(VkDeviceSize vb_size, VkDeviceSize ib_size, cons
     mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     mem_info.allocationSize = ib_mem_offset_ + ib_mem_reqs.size;
 
-    // find any supported and mappable memory type
+    // find any supported and mappable memory type, preferably a coherent one
     uint32_t mem_types = (vb_mem_reqs.memoryTypeBits & ib_mem_reqs.memoryTypeBits);
+    bool found = false;
     for (uint32_t idx = 0; idx < mem_flags.size(); idx++) {
         if ((mem_types & (1 << idx)) && (mem_flags[idx] & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
-            (mem_flags[idx] & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
-            // TODO this may not be reachable
+            (!found || (mem_flags[idx] & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))) {
             mem_info.memoryTypeIndex = idx;
-            break;
+            found = true;
+            if (mem_flags[idx] & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) break;
         }
     }
+    mem_coherent_ = (mem_flags[mem_info.memoryTypeIndex] & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
 
     vk::AllocateMemory(dev_, &mem_info, nullptr, &mem_);
 
@@ -18,11 +18,22 @@
 #define MESHES_H
 
 #include <vulkan/vulkan.h>
+#include <string>
 #include <vector>
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "MeshLoader.h"
+#include "Meshlets.h"
 
 class Meshes {
    public:
-    Meshes(VkDevice dev, const std::vector<VkMemoryPropertyFlags> &mem_flags);
+    // mesh_dir holds the mesh files written by mesh-convert; the icosphere
+    // has 20 * 4^icosphere_level faces.  The OBJ or PLY files in
+    // extra_mesh_files become the types following MESH_COUNT.  With
+    // meshlets, the faces of every mesh are clustered for cmd_draw_visible.
+    Meshes(VkDevice dev, const std::vector<VkMemoryPropertyFlags> &mem_flags, const std::string &mesh_dir, int icosphere_level,
+           const std::vector<std::string> &extra_mesh_files, bool meshlets);
     ~Meshes();
 
     const VkPipelineVertexInputStateCreateInfo &vertex_input_state() const { return vertex_input_state_; }
@@ -36,8 +47,25 @@ class Meshes {
         MESH_COUNT,
     };
 
+    // MESH_COUNT plus the loaded meshes
+    uint32_t mesh_count() const { return static_cast<uint32_t>(draw_commands_.size()); }
+
+    // of the extra mesh files, in order
+    const std::vector<MeshLoader::Stats> &load_stats() const { return load_stats_; }
+
     void cmd_bind_buffers(VkCommandBuffer cmd) const;
-    void cmd_draw(VkCommandBuffer cmd, Type type) const;
+    void cmd_draw(VkCommandBuffer cmd, Type type, uint32_t first_instance = 0) const;
+
+    // of all meshes; 0 without meshlets
+    size_t meshlet_count() const;
+
+    // Draw the meshlets of type that are inside frustum, merging adjacent
+    // ones into single draws.  model maps the mesh to world space, where
+    // frustum and eye are.  Meshlets facing away from eye are skipped too
+    // when back_faces_culled says the pipeline culls back faces; otherwise
+    // they are visible.  Returns the number of meshlets skipped.
+    uint32_t cmd_draw_visible(VkCommandBuffer cmd, Type type, const glm::mat4 &model, const Frustum &frustum, const glm::vec3 &eye,
+                              bool back_faces_culled, uint32_t first_instance = 0) const;
 
    private:
     void allocate_resources(VkDeviceSize vb_size, VkDeviceSize ib_size, const std::vector<VkMemoryPropertyFlags> &mem_flags);
@@ -51,11 +79,15 @@ class Meshes {
     VkIndexType index_type_;
 
     std::vector<VkDrawIndexedIndirectCommand> draw_commands_;
+    // by type, with first_index into the shared index buffer
+    std::vector<std::vector<Meshlets::Meshlet>> meshlets_;
+    std::vector<MeshLoader::Stats> load_stats_;
 
     VkBuffer vb_;
     VkBuffer ib_;
     VkDeviceMemory mem_;
     VkDeviceSize ib_mem_offset_;
+    bool mem_coherent_;
 };
 
 #endif  // MESHES_H
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include "Meshlets.h"
+
+namespace {
+
+void sub(const float *a, const float *b, float *dst) {
+    dst[0] = a[0] - b[0];
+    dst[1] = a[1] - b[1];
+    dst[2] = a[2] - b[2];
+}
+
+float dot(const float *a, const float *b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+}  // namespace
+
+Meshlets::Meshlets(const float *positions, size_t vertex_count, uint32_t *indices, size_t index_count, uint32_t max_vertices,
+                   uint32_t max_triangles) {
+    const size_t tri_count = index_count / 3;
+
+    // the triangles around each vertex
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+    for (size_t i = 0; i < tri_count * 3; i++) adjacency_offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertex_count; v++) adjacency_offsets[v + 1] += adjacency_offsets[v];
+
+    std::vector<uint32_t> adjacency(tri_count * 3);
+    {
+        std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for (size_t i = 0; i < tri_count * 3; i++) adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    auto centroid = [positions, indices](size_t tri, float *dst) {
+        const float *a = positions + 3 * indices[tri * 3 + 0];
+        const float *b = positions + 3 * indices[tri * 3 + 1];
+        const float *c = positions + 3 * indices[tri * 3 + 2];
+        for (int k = 0; k < 3; k++) dst[k] = (a[k] + b[k] + c[k]) / 3.0f;
+    };
+
+    // the meshlet a vertex was last added to
+    const uint32_t no_meshlet = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> vertex_meshlet(vertex_count, no_meshlet);
+    std::vector<bool> emitted(tri_count, false);
+
+    std::vector<uint32_t> order;
+    order.reserve(tri_count);
+    std::vector<uint32_t> candidates;
+    size_t next_seed = 0;
+
+    while (order.size() < tri_count) {
+        const uint32_t meshlet = static_cast<uint32_t>(meshlets_.size());
+        const size_t meshlet_begin = order.size();
+        uint32_t meshlet_vertex_count = 0;
+        float center_sum[3] = {0.0f, 0.0f, 0.0f};
+
+        candidates.clear();
+
+        auto new_vertex_count = [&](uint32_t tri) {
+            uint32_t count = 0;
+            for (int k = 0; k < 3; k++) count += (vertex_meshlet[indices[tri * 3 + k]] != meshlet);
+            return count;
+        };
+
+        auto add = [&](uint32_t tri) {
+            emitted[tri] = true;
+            order.push_back(tri);
+
+            float c[3];
+            centroid(tri, c);
+            for (int k = 0; k < 3; k++) center_sum[k] += c[k];
+
+            for (int k = 0; k < 3; k++) {
+                const uint32_t v = indices[tri * 3 + k];
+                if (vertex_meshlet[v] == meshlet) continue;
+
+                vertex_meshlet[v] = meshlet;
+                meshlet_vertex_count++;
+                for (uint32_t a = adjacency_offsets[v]; a < adjacency_offsets[v + 1]; a++) {
+                    if (!emitted[adjacency[a]]) candidates.push_back(adjacency[a]);
+                }
+            }
+        };
+
+        while (emitted[next_seed]) next_seed++;
+        add(static_cast<uint32_t>(next_seed));
+
+        while (order.size() - meshlet_begin < max_triangles) {
+            float center[3];
+            const float count = static_cast<float>(order.size() - meshlet_begin);
+            for (int k = 0; k < 3; k++) center[k] = center_sum[k] / count;
+
+            // prefer triangles that add the fewest vertices, then the
+            // closest ones; drop the emitted candidates on the way
+            uint32_t best = no_meshlet;
+            uint32_t best_new = 4;
+            float best_dist = 0.0f;
+            size_t kept = 0;
+            for (size_t i = 0; i < candidates.size(); i++) {
+                const uint32_t tri = candidates[i];
+                if (emitted[tri]) continue;
+                candidates[kept++] = tri;
+
+                const uint32_t new_count = new_vertex_count(tri);
+                if (meshlet_vertex_count + new_count > max_vertices || new_count > best_new) continue;
+
+                float c[3], d[3];
+                centroid(tri, c);
+                sub(c, center, d);
+                const float dist = dot(d, d);
+                if (new_count < best_new || dist < best_dist) {
+                    best = tri;
+                    best_new = new_count;
+                    best_dist = dist;
+                }
+            }
+            candidates.resize(kept);
+
+            if (best == no_meshlet) break;
+            add(best);
+        }
+
+        meshlets_.push_back(bound(positions, indices, order, meshlet_begin, order.size()));
+    }
+
+    std::vector<uint32_t> reordered;
+    reordered.reserve(tri_count * 3);
+    for (const auto tri : order) reordered.insert(reordered.end(), indices + tri * 3, indices + tri * 3 + 3);
+    std::copy(reordered.begin(), reordered.end(), indices);
+}
+
+Meshlets::Meshlet Meshlets::bound(const float *positions, const uint32_t *indices, const std::vector<uint32_t> &triangles,
+                                  size_t begin, size_t end) const {
+    Meshlet meshlet = {};
+    meshlet.first_index = static_cast<uint32_t>(begin * 3);
+    meshlet.index_count = static_cast<uint32_t>((end - begin) * 3);
+
+    float min[3], max[3];
+    for (int k = 0; k < 3; k++) {
+        min[k] = std::numeric_limits<float>::max();
+        max[k] = -std::numeric_limits<float>::max();
+    }
+
+    std::vector<std::array<float, 3>> normals;
+    normals.reserve(end - begin);
+    float normal_sum[3] = {0.0f, 0.0f, 0.0f};
+
+    for (size_t i = begin; i < end; i++) {
+        const uint32_t *tri = indices + triangles[i] * 3;
+        const float *a = positions + 3 * tri[0];
+        const float *b = positions + 3 * tri[1];
+        const float *c = positions + 3 * tri[2];
+
+        for (const float *p : {a, b, c}) {
+            for (int k = 0; k < 3; k++) {
+                min[k] = std::min(min[k], p[k]);
+                max[k] = std::max(max[k], p[k]);
+            }
+        }
+
+        float e1[3], e2[3];
+        sub(b, a, e1);
+        sub(c, a, e2);
+        std::array<float, 3> n = {{e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]}};
+        const float len = std::sqrt(dot(n.data(), n.data()));
+
+        // degenerate triangles are never rasterized
+        if (len == 0.0f) continue;
+        for (int k = 0; k < 3; k++) {
+            n[k] /= len;
+            normal_sum[k] += n[k];
+        }
+        normals.push_back(n);
+    }
+
+    for (int k = 0; k < 3; k++) meshlet.center[k] = (min[k] + max[k]) * 0.5f;
+    for (size_t i = begin; i < end; i++) {
+        const uint32_t *tri = indices + triangles[i] * 3;
+        for (int k = 0; k < 3; k++) {
+            float d[3];
+            sub(positions + 3 * tri[k], meshlet.center, d);
+            meshlet.radius = std::max(meshlet.radius, std::sqrt(dot(d, d)));
+        }
+    }
+
+    // the normals may cancel out, as they do for a closed meshlet
+    const float axis_len = std::sqrt(dot(normal_sum, normal_sum));
+    meshlet.cone_cutoff = 1.0f;
+    if (axis_len > 0.0f) {
+        float min_dot = 1.0f;
+        for (int k = 0; k < 3; k++) meshlet.cone_axis[k] = normal_sum[k] / axis_len;
+        for (const auto &n : normals) min_dot = std::min(min_dot, dot(n.data(), meshlet.cone_axis));
+
+        if (min_dot > 0.0f) meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    }
+
+    return meshlet;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A triangle list split into meshlets: clusters of at most max_vertices
+// distinct vertices and max_triangles triangles, grown greedily across
+// shared vertices so that they stay compact.  Each meshlet has a bounding
+// sphere and a cone bounding its face normals, which lets whole clusters be
+// culled against the frustum or as back-facing.
+class Meshlets {
+   public:
+    struct Meshlet {
+        // a range of the reordered indices
+        uint32_t first_index;
+        uint32_t index_count;
+
+        float center[3];
+        float radius;
+
+        // the meshlet faces away from eye when
+        //
+        //   dot(center - eye, cone_axis) >= cone_cutoff * length(center - eye) + radius
+        //
+        // cone_cutoff is 1 when the normals spread over a hemisphere or more
+        float cone_axis[3];
+        float cone_cutoff;
+    };
+
+    // positions are vertex_count packed xyz triples.  indices are reordered
+    // so that the triangles of each meshlet are contiguous.
+    Meshlets(const float *positions, size_t vertex_count, uint32_t *indices, size_t index_count, uint32_t max_vertices = 64,
+             uint32_t max_triangles = 124);
+
+    const std::vector<Meshlet> &meshlets() const { return meshlets_; }
+
+   private:
+    Meshlet bound(const float *positions, const uint32_t *indices, const std::vector<uint32_t> &triangles, size_t begin,
+                  size_t end) const;
+
+    std::vector<Meshlet> meshlets_;
+};
+
+#endif  // MESHLETS_H
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks Meshlets on the CPU: every meshlet stays within its vertex and
+// triangle limits, the meshlets cover every triangle exactly once, and a
+// meshlet the cone test rejects has no triangle facing the eye.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Icosphere.h"
+#include "Meshlets.h"
+
+namespace {
+
+struct Mesh {
+    std::string name;
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+};
+
+Mesh make_icosphere(int level) {
+    Icosphere sphere(1.0f, level, 1);
+
+    Mesh mesh;
+    mesh.name = "icosphere level " + std::to_string(level);
+    for (const auto &pos : sphere.positions()) mesh.positions.insert(mesh.positions.end(), pos.begin(), pos.end());
+    for (const auto &face : sphere.faces()) mesh.indices.insert(mesh.indices.end(), face.begin(), face.end());
+    return mesh;
+}
+
+// an open, bumpy height field
+Mesh make_terrain(int size, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> height(-0.2f, 0.2f);
+
+    Mesh mesh;
+    mesh.name = "terrain " + std::to_string(size) + "x" + std::to_string(size);
+    for (int y = 0; y <= size; y++) {
+        for (int x = 0; x <= size; x++) {
+            mesh.positions.push_back(static_cast<float>(x) / size * 2.0f - 1.0f);
+            mesh.positions.push_back(static_cast<float>(y) / size * 2.0f - 1.0f);
+            mesh.positions.push_back(height(rng));
+        }
+    }
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            const uint32_t a = y * (size + 1) + x;
+            const uint32_t b = a + 1;
+            const uint32_t c = a + size + 1;
+            const uint32_t d = c + 1;
+            mesh.indices.insert(mesh.indices.end(), {a, b, d, a, d, c});
+        }
+    }
+    return mesh;
+}
+
+// disconnected triangles in random orientations, plus a degenerate one
+Mesh make_soup(int tri_count, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+
+    Mesh mesh;
+    mesh.name = "soup of " + std::to_string(tri_count);
+    for (int i = 0; i < tri_count * 3; i++) {
+        for (int k = 0; k < 3; k++) mesh.positions.push_back(coord(rng));
+        mesh.indices.push_back(i);
+    }
+    mesh.indices.insert(mesh.indices.end(), {0, 0, 1});
+    return mesh;
+}
+
+void sub(const float *a, const float *b, float *dst) {
+    for (int k = 0; k < 3; k++) dst[k] = a[k] - b[k];
+}
+
+float dot(const float *a, const float *b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+std::vector<std::array<uint32_t, 3>> sorted_triangles(const std::vector<uint32_t> &indices) {
+    std::vector<std::array<uint32_t, 3>> tris(indices.size() / 3);
+    for (size_t i = 0; i < tris.size(); i++) tris[i] = {{indices[i * 3 + 0], indices[i * 3 + 1], indices[i * 3 + 2]}};
+    std::sort(tris.begin(), tris.end());
+    return tris;
+}
+
+// returns the number of failures
+int check(const Mesh &mesh, uint32_t max_vertices, uint32_t max_triangles, std::mt19937 &rng) {
+    std::vector<uint32_t> indices = mesh.indices;
+    const Meshlets meshlets(mesh.positions.data(), mesh.positions.size() / 3, indices.data(), indices.size(), max_vertices,
+                            max_triangles);
+
+    int failures = 0;
+    auto fail = [&](const std::string &what) {
+        if (failures++ < 10) std::printf("FAIL %s (%u/%u): %s\n", mesh.name.c_str(), max_vertices, max_triangles, what.c_str());
+    };
+
+    // the meshlets cover the indices in order, and the triangles are only
+    // reordered
+    uint32_t next_index = 0;
+    for (const auto &meshlet : meshlets.meshlets()) {
+        if (meshlet.first_index != next_index || meshlet.index_count % 3) fail("meshlet ranges are not contiguous");
+        next_index = meshlet.first_index + meshlet.index_count;
+
+        if (meshlet.index_count == 0 || meshlet.index_count / 3 > max_triangles) fail("bad meshlet triangle count");
+
+        std::vector<uint32_t> vertices(indices.begin() + meshlet.first_index, indices.begin() + next_index);
+        std::sort(vertices.begin(), vertices.end());
+        if (std::unique(vertices.begin(), vertices.end()) - vertices.begin() > max_vertices) fail("too many meshlet vertices");
+
+        for (const auto v : vertices) {
+            float d[3];
+            sub(&mesh.positions[v * 3], meshlet.center, d);
+            if (std::sqrt(dot(d, d)) > meshlet.radius * 1.0001f + 1e-6f) fail("vertex outside the bounding sphere");
+        }
+    }
+    if (next_index != indices.size()) fail("meshlets do not cover all indices");
+    if (sorted_triangles(indices) != sorted_triangles(mesh.indices)) fail("triangles were lost or changed");
+
+    // no triangle of a rejected meshlet faces eye, from near and far
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> distance(0.05f, 20.0f);
+    int rejected = 0;
+    for (int e = 0; e < 200; e++) {
+        float eye[3] = {coord(rng), coord(rng), coord(rng)};
+        const float scale = distance(rng) / std::sqrt(dot(eye, eye));
+        for (int k = 0; k < 3; k++) eye[k] *= scale;
+
+        for (const auto &meshlet : meshlets.meshlets()) {
+            float to_center[3];
+            sub(meshlet.center, eye, to_center);
+            if (dot(to_center, meshlet.cone_axis) < meshlet.cone_cutoff * std::sqrt(dot(to_center, to_center)) + meshlet.radius)
+                continue;
+            rejected++;
+
+            for (uint32_t i = meshlet.first_index; i < meshlet.first_index + meshlet.index_count; i += 3) {
+                const float *a = &mesh.positions[indices[i + 0] * 3];
+                const float *b = &mesh.positions[indices[i + 1] * 3];
+                const float *c = &mesh.positions[indices[i + 2] * 3];
+
+                float e1[3], e2[3], to_eye[3];
+                sub(b, a, e1);
+                sub(c, a, e2);
+                sub(eye, a, to_eye);
+                const float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+                const float len = std::sqrt(dot(n, n));
+                if (len > 0.0f && dot(n, to_eye) > len * 1e-5f) fail("a rejected meshlet has a triangle facing eye");
+            }
+        }
+    }
+
+    std::printf("%s (%u/%u): %zu meshlets, %d rejections checked\n", mesh.name.c_str(), max_vertices, max_triangles,
+                meshlets.meshlets().size(), rejected);
+
+    return failures;
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 rng(1);
+
+    std::vector<Mesh> meshes;
+    meshes.push_back(make_icosphere(0));
+    meshes.push_back(make_icosphere(4));
+    meshes.push_back(make_terrain(40, rng));
+    meshes.push_back(make_soup(500, rng));
+
+    int failures = 0;
+    for (const auto &mesh : meshes) {
+        failures += check(mesh, 64, 124, rng);
+        failures += check(mesh, 16, 20, rng);
+        failures += check(mesh, 3, 1, rng);
+    }
+
+    if (failures) std::printf("%d failures\n", failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Split [0, count) into chunk_count contiguous chunks and call
+// func(chunk, begin, end) for each of them, on a thread per chunk.  The
+// chunks do not depend on whether threads are used; below min_count items
+// they all run on the calling thread.  func must not throw.
+template <typename Func>
+void for_each_chunk(size_t count, int chunk_count, size_t min_count, const Func &func) {
+    auto bound = [count, chunk_count](int chunk) { return count * chunk / chunk_count; };
+
+    if (count < min_count) {
+        for (int c = 0; c < chunk_count; c++) func(c, bound(c), bound(c + 1));
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunk_count - 1);
+    for (int c = 1; c < chunk_count; c++) threads.emplace_back([&func, &bound, c] { func(c, bound(c), bound(c + 1)); });
+    func(0, bound(0), bound(1));
+
+    for (auto &thread : threads) thread.join();
+}
+
+#endif  // PARALLEL_H
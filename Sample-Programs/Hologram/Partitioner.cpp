@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cassert>
+
+#include "Partitioner.h"
+
+Partitioner::Partitioner(int item_count, int part_count)
+    : item_count_(item_count), smoothing_(0.25), targets_(part_count + 1), bounds_(part_count + 1), imbalance_(1.0) {
+    assert(part_count > 0);
+
+    const int items_per_part = item_count / part_count;
+    for (int i = 0; i < part_count; i++) bounds_[i] = items_per_part * i;
+    bounds_[part_count] = item_count;
+
+    for (int i = 0; i <= part_count; i++) targets_[i] = bounds_[i];
+}
+
+double Partitioner::imbalance(const std::vector<double> &times) {
+    double total = 0.0, longest = 0.0;
+    for (auto t : times) {
+        total += t;
+        longest = std::max(longest, t);
+    }
+
+    return (total > 0.0) ? longest / (total / times.size()) : 1.0;
+}
+
+void Partitioner::update(const std::vector<double> &times) {
+    const int part_count = static_cast<int>(bounds_.size()) - 1;
+    assert(static_cast<int>(times.size()) == part_count);
+
+    double total = 0.0;
+    for (auto t : times) total += t;
+    if (total <= 0.0) return;
+
+    imbalance_ = imbalance(times);
+    if (part_count == 1) return;
+
+    // Walk the piecewise linear cumulative cost of the items and find where
+    // it crosses each multiple of total / part_count.  Empty parts have no
+    // cost and are skipped over.
+    const double share = total / part_count;
+    int part = 0;
+    double cost_before = 0.0;
+    for (int i = 1; i < part_count; i++) {
+        const double cost = share * i;
+        while (part < part_count - 1 && cost_before + times[part] < cost) cost_before += times[part++];
+
+        const int count = bounds_[part + 1] - bounds_[part];
+        const double frac = (times[part] > 0.0) ? std::min((cost - cost_before) / times[part], 1.0) : 0.0;
+        const double target = bounds_[part] + frac * count;
+
+        targets_[i] += smoothing_ * (target - targets_[i]);
+    }
+
+    // keep every part non-empty when there are enough items
+    const int min_count = (item_count_ >= part_count) ? 1 : 0;
+    for (int i = 1; i < part_count; i++) {
+        const int lo = bounds_[i - 1] + min_count;
+        const int hi = item_count_ - min_count * (part_count - i);
+        bounds_[i] = std::min(std::max(static_cast<int>(targets_[i] + 0.5), lo), hi);
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PARTITIONER_H
+#define PARTITIONER_H
+
+#include <vector>
+
+// Splits item_count items into part_count contiguous ranges and moves the
+// boundaries so that the parts take equally long.  Items within a part are
+// assumed to cost the same; the boundaries move only part of the way to
+// their targets each update so that noisy measurements do not make them
+// oscillate.
+class Partitioner {
+   public:
+    // starts with ranges of equal size, the remainder going to the last part
+    Partitioner(int item_count, int part_count);
+
+    int begin(int part) const { return bounds_[part]; }
+    int end(int part) const { return bounds_[part + 1]; }
+
+    // times[i] is how long part i took with the current ranges
+    void update(const std::vector<double> &times);
+
+    // max / mean of the times passed to the last update
+    double imbalance() const { return imbalance_; }
+    static double imbalance(const std::vector<double> &times);
+
+   private:
+    const int item_count_;
+    // the fraction of the distance to the target moved per update
+    const double smoothing_;
+
+    std::vector<double> targets_;
+    std::vector<int> bounds_;
+    double imbalance_;
+};
+
+#endif  // PARTITIONER_H
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "Scene.h"
+
+namespace {
+
+std::string trim(const std::string &str) {
+    const char *space = " \t\r\n";
+    const size_t begin = str.find_first_not_of(space);
+    if (begin == std::string::npos) return std::string();
+
+    return str.substr(begin, str.find_last_not_of(space) - begin + 1);
+}
+
+// the base of the builtin scales
+const float base_scale = 0.005f;
+
+}  // namespace
+
+Scene::Group Scene::default_group() {
+    Group group;
+    group.mesh = Meshes::MESH_PYRAMID;
+    group.count = 0;
+    group.scale = base_scale;
+    group.speed = Range{0.1f, 1.0f};
+    group.color_min = glm::vec3(0.0f);
+    group.color_max = glm::vec3(1.0f);
+    group.path.duration = Range{5.0f, 20.0f};
+    group.path.curve_weights[CURVE_RANDOM] = 1.0f;
+    group.path.curve_weights[CURVE_CIRCLE] = 1.0f;
+    group.path.circle_radius = Range{0.02f, 0.2f};
+    group.path.random_extent = 0.3f;
+    group.path.random_duration = Range{1.0f, 5.0f};
+
+    return group;
+}
+
+Scene::Scene(int object_count, const std::vector<std::string> &mesh_files)
+    : mesh_files_(mesh_files), object_count_(object_count), has_seed_(false), seed_(0) {
+    Group pyramid = default_group();
+    pyramid.name = "pyramid";
+
+    Group icosphere = default_group();
+    icosphere.name = "icosphere";
+    icosphere.mesh = Meshes::MESH_ICOSPHERE;
+    icosphere.scale = base_scale * 3.0f;
+
+    Group teapot = default_group();
+    teapot.name = "teapot";
+    teapot.mesh = Meshes::MESH_TEAPOT;
+    teapot.scale = base_scale * 10.0f;
+
+    groups_ = {pyramid, icosphere, teapot};
+    pattern_ = {0, 1, 2, 0, 1, 0, 0, 0, 0, 0};
+
+    // loaded meshes are normalized like the teapot
+    for (size_t i = 0; i < mesh_files_.size(); i++) {
+        Group loaded = teapot;
+        loaded.name = mesh_files_[i];
+        loaded.mesh = static_cast<Meshes::Type>(Meshes::MESH_COUNT + i);
+
+        pattern_.push_back(static_cast<uint32_t>(groups_.size()));
+        groups_.push_back(loaded);
+    }
+
+    for (int i = 0; i < object_count_; i++) groups_[pattern_[i % pattern_.size()]].count++;
+}
+
+Scene::Scene(const std::string &path, const std::vector<std::string> &mesh_files)
+    : mesh_files_(mesh_files), object_count_(0), has_seed_(false), seed_(0) {
+    std::ifstream file(path);
+    if (!file) throw std::runtime_error("failed to open " + path);
+
+    const size_t slash = path.find_last_of("/\\");
+    const std::string dir = (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+
+    std::string line;
+    int line_number = 0;
+    bool has_mesh = false;
+    while (std::getline(file, line)) {
+        line_number++;
+
+        auto fail = [&](const std::string &msg) {
+            std::stringstream ss;
+            ss << path << ":" << line_number << ": " << msg;
+            throw std::runtime_error(ss.str());
+        };
+
+        line = trim(line.substr(0, line.find_first_of(";#")));
+        if (line.empty()) continue;
+
+        if (line.front() == '[') {
+            if (line.back() != ']') fail("bad section header");
+            if (!groups_.empty() && !has_mesh) fail("group " + groups_.back().name + " has no mesh");
+
+            groups_.push_back(default_group());
+            groups_.back().name = trim(line.substr(1, line.size() - 2));
+            has_mesh = false;
+            continue;
+        }
+
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) fail("expected key = value");
+
+        const std::string key = trim(line.substr(0, equals));
+        std::istringstream value(line.substr(equals + 1));
+
+        auto read_float = [&]() {
+            float val;
+            if (!(value >> val)) fail("bad value for " + key);
+            return val;
+        };
+        auto read_range = [&]() {
+            Range range;
+            range.min = read_float();
+            range.max = read_float();
+            if (range.min > range.max) fail(key + " is an empty range");
+            return range;
+        };
+        auto read_vec3 = [&]() {
+            glm::vec3 vec;
+            for (int i = 0; i < 3; i++) vec[i] = read_float();
+            return vec;
+        };
+
+        if (groups_.empty()) {
+            if (key != "seed") fail("unknown key " + key + " outside of a group");
+            if (!(value >> seed_)) fail("bad value for seed");
+            has_seed_ = true;
+        } else {
+            Group &group = groups_.back();
+
+            if (key == "mesh") {
+                std::string name;
+                std::getline(value, name);
+                group.mesh = find_mesh(trim(name), dir);
+                has_mesh = true;
+            } else if (key == "count") {
+                if (!(value >> group.count) || group.count < 0) fail("bad value for count");
+            } else if (key == "scale") {
+                group.scale = read_float();
+            } else if (key == "speed") {
+                group.speed = read_range();
+            } else if (key == "color_min") {
+                group.color_min = read_vec3();
+            } else if (key == "color_max") {
+                group.color_max = read_vec3();
+            } else if (key == "path_duration") {
+                group.path.duration = read_range();
+                if (group.path.duration.min <= 0.0f) fail("path_duration must be positive");
+            } else if (key == "curves") {
+                for (auto &weight : group.path.curve_weights) weight = 0.0f;
+
+                std::string curve;
+                while (value >> curve) {
+                    const float weight = read_float();
+                    if (curve == "random")
+                        group.path.curve_weights[CURVE_RANDOM] = weight;
+                    else if (curve == "circle")
+                        group.path.curve_weights[CURVE_CIRCLE] = weight;
+                    else
+                        fail("unknown curve " + curve);
+                    if (weight < 0.0f) fail("negative curve weight");
+                }
+                if (group.path.curve_weights[CURVE_RANDOM] + group.path.curve_weights[CURVE_CIRCLE] <= 0.0f)
+                    fail("no curve has a weight");
+            } else if (key == "circle_radius") {
+                group.path.circle_radius = read_range();
+            } else if (key == "random_extent") {
+                group.path.random_extent = read_float();
+            } else if (key == "random_duration") {
+                group.path.random_duration = read_range();
+                if (group.path.random_duration.min <= 0.0f) fail("random_duration must be positive");
+            } else {
+                fail("unknown key " + key);
+            }
+        }
+
+        std::string rest;
+        if (value >> rest) fail("trailing characters after " + key);
+    }
+
+    if (!groups_.empty() && !has_mesh) throw std::runtime_error(path + ": group " + groups_.back().name + " has no mesh");
+
+    for (const auto &group : groups_) object_count_ += group.count;
+    if (!object_count_) throw std::runtime_error(path + " has no objects");
+
+    interleave();
+}
+
+Meshes::Type Scene::find_mesh(const std::string &name, const std::string &dir) {
+    if (name == "pyramid") return Meshes::MESH_PYRAMID;
+    if (name == "icosphere") return Meshes::MESH_ICOSPHERE;
+    if (name == "teapot") return Meshes::MESH_TEAPOT;
+
+    const bool absolute = (!name.empty() && (name[0] == '/' || name[0] == '\\')) || name.find(':') != std::string::npos;
+    const std::string path = (absolute) ? name : dir + name;
+
+    for (size_t i = 0; i < mesh_files_.size(); i++) {
+        if (mesh_files_[i] == path) return static_cast<Meshes::Type>(Meshes::MESH_COUNT + i);
+    }
+
+    mesh_files_.push_back(path);
+    return static_cast<Meshes::Type>(Meshes::MESH_COUNT + mesh_files_.size() - 1);
+}
+
+void Scene::interleave() {
+    // each object goes to the group furthest behind its share, so that the
+    // groups are spread evenly over the object ranges of the workers
+    pattern_.clear();
+    pattern_.reserve(object_count_);
+
+    std::vector<int> placed(groups_.size(), 0);
+    for (int i = 0; i < object_count_; i++) {
+        size_t best = 0;
+        double best_lag = -1.0;
+        for (size_t g = 0; g < groups_.size(); g++) {
+            if (placed[g] == groups_[g].count) continue;
+
+            const double lag = static_cast<double>(groups_[g].count) * (i + 1) / object_count_ - placed[g];
+            if (lag > best_lag) {
+                best = g;
+                best_lag = lag;
+            }
+        }
+
+        placed[best]++;
+        pattern_.push_back(static_cast<uint32_t>(best));
+    }
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Meshes.h"
+
+// The objects Simulation creates: groups of objects sharing a mesh, a scale
+// and the ranges their animations, colors and paths are drawn from.  A scene
+// is either the builtin mix or read from an INI file like
+//
+//   seed = 1234                 ; optional; the same seed gives the same run
+//
+//   [teapots]
+//   mesh = teapot               ; pyramid, icosphere, teapot or an OBJ/PLY file
+//   count = 500
+//   scale = 0.05
+//   speed = 0.1 1.0             ; radians per second
+//   color_min = 0 0 0
+//   color_max = 1 1 1
+//   path_duration = 5 20        ; seconds per subpath
+//   curves = random 1 circle 1  ; relative weights
+//   circle_radius = 0.02 0.2
+//   random_extent = 0.3         ; of a random segment, per axis
+//   random_duration = 1 5
+//
+// where every key but mesh and count has the default shown.  Mesh files are
+// relative to the scene file.
+class Scene {
+   public:
+    struct Range {
+        float min;
+        float max;
+    };
+
+    enum CurveType {
+        CURVE_RANDOM,
+        CURVE_CIRCLE,
+        CURVE_COUNT,
+    };
+
+    struct PathParams {
+        Range duration;
+        float curve_weights[CURVE_COUNT];
+        Range circle_radius;
+        float random_extent;
+        Range random_duration;
+    };
+
+    struct Group {
+        std::string name;
+        Meshes::Type mesh;
+        int count;
+        float scale;
+        Range speed;
+        glm::vec3 color_min;
+        glm::vec3 color_max;
+        PathParams path;
+    };
+
+    // the builtin mix of object_count objects, mostly pyramids; each of
+    // mesh_files is used once every pattern
+    Scene(int object_count, const std::vector<std::string> &mesh_files);
+    // Throws std::runtime_error when path cannot be read or parsed.  The mesh
+    // files the scene names are appended to mesh_files.
+    Scene(const std::string &path, const std::vector<std::string> &mesh_files);
+
+    const std::vector<Group> &groups() const { return groups_; }
+    // the meshes following Meshes::MESH_COUNT
+    const std::vector<std::string> &mesh_files() const { return mesh_files_; }
+
+    int object_count() const { return object_count_; }
+    // object i belongs to groups()[pattern()[i % pattern().size()]]
+    const std::vector<uint32_t> &pattern() const { return pattern_; }
+
+    bool has_seed() const { return has_seed_; }
+    uint32_t seed() const { return seed_; }
+
+   private:
+    static Group default_group();
+
+    Meshes::Type find_mesh(const std::string &name, const std::string &dir);
+    // spread the groups evenly over the objects, in proportion to their counts
+    void interleave();
+
+    std::vector<Group> groups_;
+    std::vector<std::string> mesh_files_;
+    int object_count_;
+    std::vector<uint32_t> pattern_;
+
+    bool has_seed_;
+    uint32_t seed_;
+};
+
+#endif  // SCENE_H
@@ -15,17 +15,45 @@
  */
 
 #include <cassert>
+#include <algorithm>
 #include <array>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <sstream>
 #include <set>
+#ifndef _WIN32
+#include <cerrno>
+#include <time.h>
+#endif
 #include "Helpers.h"
+#include "LogQueue.h"
 #include "Shell.h"
 #include "Game.h"
 
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX() std::this_thread::yield()
+#endif
+
 Shell::Shell(Game &game)
-    : game_(game), settings_(game.settings()), ctx_(), game_tick_(1.0f / settings_.ticks_per_second), game_time_(game_tick_) {
+    : game_(game),
+      settings_(game.settings()),
+      ctx_(),
+      log_queue_(nullptr),
+      game_tick_(1.0f / settings_.ticks_per_second),
+      game_time_(game_tick_),
+      pace_query_pool_(VK_NULL_HANDLE),
+      pace_cmd_pool_(VK_NULL_HANDLE),
+      pace_timestamp_period_(0.0),
+      pace_timestamp_mask_(0),
+      pace_last_ticks_(0),
+      pace_wrapped_ticks_(0),
+      pace_clock_offsets_(),
+      pace_clock_offset_count_(0),
+      frame_count_(0) {
     // require generic WSI extensions
     instance_extensions_.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
     device_extensions_.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
@@ -53,7 +81,13 @@ void Shell::init_vk() {
 }
 
 void Shell::cleanup_vk() {
-    if (settings_.validate) vk::DestroyDebugReportCallbackEXT(ctx_.instance, ctx_.debug_report, nullptr);
+    if (settings_.validate) {
+        vk::DestroyDebugReportCallbackEXT(ctx_.instance, ctx_.debug_report, nullptr);
+
+        log_queue_->stop();
+        delete log_queue_;
+        log_queue_ = nullptr;
+    }
 
     vk::DestroyInstance(ctx_.instance, nullptr);
 }
@@ -70,10 +104,9 @@ bool Shell::debug_report_callback(VkDebugReportFlagsEXT flags, VkDebugReportObje
     else if (flags & VK_DEBUG_REPORT_DEBUG_BIT_EXT)
         prio = LOG_DEBUG;
 
-    std::stringstream ss;
-    ss << layer_prefix << ": " << msg;
-
-    log(prio, ss.str().c_str());
+    // this may be called from any thread, including every Hologram worker;
+    // formatting and printing are left to the log queue thread
+    log_queue_->push(prio, msg_code, layer_prefix, msg);
 
     return false;
 }
@@ -168,6 +201,9 @@ void Shell::init_debug_report() {
         debug_report_info.flags = VK_DEBUG_REPORT_INFORMATION_BIT_EXT | VK_DEBUG_REPORT_DEBUG_BIT_EXT;
     }
 
+    log_queue_ = new LogQueue(*this, 1024, settings_.log_rate_limit);
+    log_queue_->start();
+
     debug_report_info.pfnCallback = debug_report_callback;
     debug_report_info.pUserData = reinterpret_cast<void *>(this);
 
@@ -205,6 +241,17 @@ void Shell::init_physical_dev() {
             ctx_.physical_dev = phy;
             ctx_.game_queue_family = game_queue_family;
             ctx_.present_queue_family = present_queue_family;
+
+            // usually backed by the copy engines of discrete GPUs
+            ctx_.transfer_queue_family = UINT32_MAX;
+            for (uint32_t i = 0; i < queues.size() && settings_.transfer_queue; i++) {
+                const VkFlags flags = queues[i].queueFlags;
+                if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+                    i != ctx_.present_queue_family) {
+                    ctx_.transfer_queue_family = i;
+                    break;
+                }
+            }
             break;
         }
     }
@@ -218,6 +265,10 @@ void Shell::create_context() {
 
     vk::GetDeviceQueue(ctx_.dev, ctx_.game_queue_family, 0, &ctx_.game_queue);
     vk::GetDeviceQueue(ctx_.dev, ctx_.present_queue_family, 0, &ctx_.present_queue);
+    if (ctx_.transfer_queue_family != UINT32_MAX)
+        vk::GetDeviceQueue(ctx_.dev, ctx_.transfer_queue_family, 0, &ctx_.transfer_queue);
+    else
+        ctx_.transfer_queue = VK_NULL_HANDLE;
 
     create_back_buffers();
 
@@ -240,6 +291,7 @@ void Shell::destroy_context() {
 
     ctx_.game_queue = VK_NULL_HANDLE;
     ctx_.present_queue = VK_NULL_HANDLE;
+    ctx_.transfer_queue = VK_NULL_HANDLE;
 
     vk::DeviceWaitIdle(ctx_.dev);
     vk::DestroyDevice(ctx_.dev, nullptr);
@@ -251,21 +303,28 @@ void Shell::create_dev() {
     dev_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
     const std::vector<float> queue_priorities(settings_.queue_count, 0.0f);
-    std::array<VkDeviceQueueCreateInfo, 2> queue_info = {};
+    std::array<VkDeviceQueueCreateInfo, 3> queue_info = {};
     queue_info[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     queue_info[0].queueFamilyIndex = ctx_.game_queue_family;
     queue_info[0].queueCount = settings_.queue_count;
     queue_info[0].pQueuePriorities = queue_priorities.data();
+    dev_info.queueCreateInfoCount = 1;
 
     if (ctx_.game_queue_family != ctx_.present_queue_family) {
-        queue_info[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queue_info[1].queueFamilyIndex = ctx_.present_queue_family;
-        queue_info[1].queueCount = 1;
-        queue_info[1].pQueuePriorities = queue_priorities.data();
+        auto &info = queue_info[dev_info.queueCreateInfoCount++];
+        info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        info.queueFamilyIndex = ctx_.present_queue_family;
+        info.queueCount = 1;
+        info.pQueuePriorities = queue_priorities.data();
+    }
 
-        dev_info.queueCreateInfoCount = 2;
-    } else {
-        dev_info.queueCreateInfoCount = 1;
+    // a transfer-only family differs from both of the above
+    if (ctx_.transfer_queue_family != UINT32_MAX) {
+        auto &info = queue_info[dev_info.queueCreateInfoCount++];
+        info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        info.queueFamilyIndex = ctx_.transfer_queue_family;
+        info.queueCount = 1;
+        info.pQueuePriorities = queue_priorities.data();
     }
 
     dev_info.pQueueCreateInfos = queue_info.data();
@@ -292,16 +351,76 @@ void Shell::create_back_buffers() {
     // images may allows us to replace CPU wait on present_fence by GPU wait
     // on acquire_semaphore.
     const int count = settings_.back_buffer_count + 1;
+
+    std::vector<VkCommandBuffer> timestamp_cmds;
+    if (create_pace_timestamps(count)) {
+        VkCommandBufferAllocateInfo cmd_info = {};
+        cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmd_info.commandPool = pace_cmd_pool_;
+        cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmd_info.commandBufferCount = count;
+
+        timestamp_cmds.resize(count);
+        vk::assert_success(vk::AllocateCommandBuffers(ctx_.dev, &cmd_info, timestamp_cmds.data()));
+    }
+
     for (int i = 0; i < count; i++) {
         BackBuffer buf = {};
         vk::assert_success(vk::CreateSemaphore(ctx_.dev, &sem_info, nullptr, &buf.acquire_semaphore));
         vk::assert_success(vk::CreateSemaphore(ctx_.dev, &sem_info, nullptr, &buf.render_semaphore));
         vk::assert_success(vk::CreateFence(ctx_.dev, &fence_info, nullptr, &buf.present_fence));
 
+        if (!timestamp_cmds.empty()) {
+            buf.timestamp_cmd = timestamp_cmds[i];
+            buf.timestamp_query = i;
+
+            // recorded once and resubmitted after every frame using buf
+            VkCommandBufferBeginInfo begin_info = {};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            vk::assert_success(vk::BeginCommandBuffer(buf.timestamp_cmd, &begin_info));
+            vk::CmdResetQueryPool(buf.timestamp_cmd, pace_query_pool_, buf.timestamp_query, 1);
+            vk::CmdWriteTimestamp(buf.timestamp_cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pace_query_pool_, buf.timestamp_query);
+            vk::assert_success(vk::EndCommandBuffer(buf.timestamp_cmd));
+        }
+
         ctx_.back_buffers.push(buf);
     }
 }
 
+bool Shell::create_pace_timestamps(uint32_t count) {
+    if (settings_.target_fps <= 0) return false;
+
+    // the timestamp is written on the present queue, and it follows the
+    // rendering of the frame only when that is the game queue as well
+    if (ctx_.game_queue_family != ctx_.present_queue_family) return false;
+
+    std::vector<VkQueueFamilyProperties> queues;
+    vk::get(ctx_.physical_dev, queues);
+    const uint32_t valid_bits = queues[ctx_.present_queue_family].timestampValidBits;
+    if (!valid_bits) return false;
+
+    VkPhysicalDeviceProperties props;
+    vk::GetPhysicalDeviceProperties(ctx_.physical_dev, &props);
+    pace_timestamp_period_ = props.limits.timestampPeriod;
+    pace_timestamp_mask_ = (valid_bits >= 64) ? UINT64_MAX : (uint64_t(1) << valid_bits) - 1;
+    pace_last_ticks_ = 0;
+    pace_wrapped_ticks_ = 0;
+    pace_clock_offset_count_ = 0;
+
+    VkQueryPoolCreateInfo query_pool_info = {};
+    query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_info.queryCount = count;
+    vk::assert_success(vk::CreateQueryPool(ctx_.dev, &query_pool_info, nullptr, &pace_query_pool_));
+
+    VkCommandPoolCreateInfo cmd_pool_info = {};
+    cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmd_pool_info.queueFamilyIndex = ctx_.present_queue_family;
+    vk::assert_success(vk::CreateCommandPool(ctx_.dev, &cmd_pool_info, nullptr, &pace_cmd_pool_));
+
+    return true;
+}
+
 void Shell::destroy_back_buffers() {
     while (!ctx_.back_buffers.empty()) {
         const auto &buf = ctx_.back_buffers.front();
@@ -312,6 +431,13 @@ void Shell::destroy_back_buffers() {
 
         ctx_.back_buffers.pop();
     }
+
+    if (pace_query_pool_ != VK_NULL_HANDLE) {
+        vk::DestroyCommandPool(ctx_.dev, pace_cmd_pool_, nullptr);
+        vk::DestroyQueryPool(ctx_.dev, pace_query_pool_, nullptr);
+        pace_cmd_pool_ = VK_NULL_HANDLE;
+        pace_query_pool_ = VK_NULL_HANDLE;
+    }
 }
 
 void Shell::create_swapchain() {
@@ -384,10 +510,13 @@ void Shell::resize_swapchain(uint32_t width_hint, uint32_t height_hint) {
     std::vector<VkPresentModeKHR> modes;
     vk::get(ctx_.physical_dev, ctx_.surface, modes);
 
+    VkPresentModeKHR preferred_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    if (settings_.vsync) preferred_mode = (settings_.fifo_relaxed) ? VK_PRESENT_MODE_FIFO_RELAXED_KHR : VK_PRESENT_MODE_MAILBOX_KHR;
+
     // FIFO is the only mode universally supported
     VkPresentModeKHR mode = VK_PRESENT_MODE_FIFO_KHR;
     for (auto m : modes) {
-        if ((settings_.vsync && m == VK_PRESENT_MODE_MAILBOX_KHR) || (!settings_.vsync && m == VK_PRESENT_MODE_IMMEDIATE_KHR)) {
+        if (m == preferred_mode) {
             mode = m;
             break;
         }
@@ -402,6 +531,9 @@ void Shell::resize_swapchain(uint32_t width_hint, uint32_t height_hint) {
     swapchain_info.imageExtent = extent;
     swapchain_info.imageArrayLayers = 1;
     swapchain_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // the game blits its offscreen target to the back buffer
+    if (settings_.dynamic_resolution && (caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+        swapchain_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
     std::vector<uint32_t> queue_families(1, ctx_.game_queue_family);
     if (ctx_.game_queue_family != ctx_.present_queue_family) {
@@ -448,12 +580,16 @@ void Shell::add_game_time(float time) {
 
 void Shell::acquire_back_buffer() {
     // acquire just once when not presenting
-    if (settings_.no_present && ctx_.acquired_back_buffer.acquire_semaphore != VK_NULL_HANDLE) return;
+    if (settings_.no_present && ctx_.acquired_back_buffer.acquire_semaphore != VK_NULL_HANDLE) {
+        pace_frame(nullptr);
+        return;
+    }
 
     auto &buf = ctx_.back_buffers.front();
 
     // wait until acquire and render semaphores are waited/unsignaled
     vk::assert_success(vk::WaitForFences(ctx_.dev, 1, &buf.present_fence, true, UINT64_MAX));
+    pace_frame(&buf);
     // reset the fence
     vk::assert_success(vk::ResetFences(ctx_.dev, 1, &buf.present_fence));
 
@@ -478,6 +614,8 @@ void Shell::present_back_buffer() {
 
     if (!settings_.no_render) game_.on_frame(game_time_ / game_tick_);
 
+    count_frame();
+
     if (settings_.no_present) {
         fake_present();
         return;
@@ -500,8 +638,18 @@ void Shell::present_back_buffer() {
         assert(!res);
     }
 
-    vk::assert_success(vk::QueueSubmit(ctx_.present_queue, 0, nullptr, buf.present_fence));
-    ctx_.back_buffers.push(buf);
+    // timestamp the end of the frame for pace_frame
+    BackBuffer done = buf;
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    if (done.timestamp_cmd != VK_NULL_HANDLE) {
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &done.timestamp_cmd;
+        done.timestamp_written = true;
+    }
+
+    vk::assert_success(vk::QueueSubmit(ctx_.present_queue, 1, &submit_info, done.present_fence));
+    ctx_.back_buffers.push(done);
 }
 
 void Shell::fake_present() {
@@ -525,3 +673,114 @@ void Shell::fake_present() {
     // push the buffer back just once for Shell::cleanup_vk
     if (buf.acquire_semaphore != ctx_.back_buffers.back().acquire_semaphore) ctx_.back_buffers.push(buf);
 }
+
+void Shell::pace_frame(const BackBuffer *buf) {
+    if (settings_.target_fps <= 0) return;
+
+    using namespace std::chrono;
+
+    const auto period = duration_cast<steady_clock::duration>(duration<double>(1.0 / settings_.target_fps));
+    // OS sleeps overshoot; wake up this early and spin the rest
+#ifdef _WIN32
+    const auto spin = milliseconds(2);
+#else
+    const auto spin = microseconds(200);
+#endif
+
+    // called right after the back buffer fence signaled; schedule from when
+    // the GPU finished the frame that last used the buffer, or from now when
+    // there is no timestamp for it.  When the GPU or the CPU fell behind by a
+    // whole period, restart from there instead of trying to catch up
+    auto now = steady_clock::now();
+    auto done = now;
+    if (buf) gpu_done_time(*buf, now, done);
+    if (done - pace_deadline_ > period) pace_deadline_ = done;
+
+    if (pace_deadline_ - now > spin) {
+        const auto sleep = duration_cast<nanoseconds>(pace_deadline_ - now - spin);
+#ifdef _WIN32
+        std::this_thread::sleep_for(sleep);
+#else
+        struct timespec ts;
+        ts.tv_sec = static_cast<time_t>(sleep.count() / 1000000000);
+        ts.tv_nsec = static_cast<long>(sleep.count() % 1000000000);
+        while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR) {
+        }
+#endif
+    }
+
+    while (steady_clock::now() < pace_deadline_) CPU_RELAX();
+
+    pace_deadline_ += period;
+}
+
+bool Shell::gpu_done_time(const BackBuffer &buf, std::chrono::steady_clock::time_point now,
+                          std::chrono::steady_clock::time_point &done) {
+    using namespace std::chrono;
+
+    if (buf.timestamp_cmd == VK_NULL_HANDLE || !buf.timestamp_written) return false;
+
+    // the present fence has signaled, so the result is available
+    uint64_t ticks;
+    if (vk::GetQueryPoolResults(ctx_.dev, pace_query_pool_, buf.timestamp_query, 1, sizeof(ticks), &ticks, sizeof(ticks),
+                                VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return false;
+
+    // frames complete in order; a smaller value means the counter wrapped
+    ticks &= pace_timestamp_mask_;
+    if (ticks < pace_last_ticks_) pace_wrapped_ticks_ += pace_timestamp_mask_ + 1;
+    pace_last_ticks_ = ticks;
+
+    const int64_t gpu_ns = static_cast<int64_t>(static_cast<double>(pace_wrapped_ticks_ + ticks) * pace_timestamp_period_);
+    const int64_t now_ns = duration_cast<nanoseconds>(now.time_since_epoch()).count();
+
+    // the fence is always seen some time after the timestamp is written, so
+    // the smallest recent difference is the closest to the offset between
+    // the two clocks; keeping only recent ones follows their drift
+    pace_clock_offsets_[pace_clock_offset_count_++ % pace_clock_offsets_.size()] = now_ns - gpu_ns;
+    const size_t offset_count = static_cast<size_t>(std::min<uint64_t>(pace_clock_offset_count_, pace_clock_offsets_.size()));
+    const int64_t offset = *std::min_element(pace_clock_offsets_.begin(), pace_clock_offsets_.begin() + offset_count);
+
+    done = steady_clock::time_point(duration_cast<steady_clock::duration>(nanoseconds(gpu_ns + offset)));
+    return true;
+}
+
+void Shell::count_frame() {
+    const auto now = std::chrono::steady_clock::now();
+
+    if (settings_.max_frame_count > 0) {
+        if (frame_times_.empty()) frame_times_.reserve(settings_.max_frame_count);
+        if (frame_count_ > 0) frame_times_.push_back(std::chrono::duration<float, std::milli>(now - last_frame_time_).count());
+    }
+
+    last_frame_time_ = now;
+    frame_count_++;
+
+    if (frame_count_ == settings_.max_frame_count) {
+        log_frame_stats();
+        quit();
+    }
+}
+
+void Shell::log_frame_stats() const {
+    if (frame_times_.empty()) return;
+
+    std::vector<float> sorted(frame_times_);
+    std::sort(sorted.begin(), sorted.end());
+
+    // nearest-rank percentiles
+    auto percentile = [&sorted](float p) {
+        size_t rank = static_cast<size_t>(p / 100.0f * sorted.size() + 0.5f);
+        if (rank > 0) rank--;
+        return sorted[std::min(rank, sorted.size() - 1)];
+    };
+
+    double sum = 0.0;
+    for (auto t : sorted) sum += t;
+
+    // parsed by scaling-sweep
+    std::stringstream ss;
+    ss << "frame time (ms) over " << sorted.size() << " frames: mean=" << sum / sorted.size() << " p50=" << percentile(50.0f)
+       << " p90=" << percentile(90.0f) << " p99=" << percentile(99.0f) << " max=" << sorted.back();
+    log(LOG_INFO, ss.str().c_str());
+}
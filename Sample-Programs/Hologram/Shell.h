@@ -17,6 +17,8 @@
 #ifndef SHELL_H
 #define SHELL_H
 
+#include <array>
+#include <chrono>
 #include <queue>
 #include <vector>
 #include <stdexcept>
@@ -25,6 +27,7 @@
 #include "Game.h"
 
 class Game;
+class LogQueue;
 
 class Shell {
    public:
@@ -40,6 +43,12 @@ class Shell {
 
         // signaled when this struct is ready for reuse
         VkFence present_fence;
+
+        // submitted with present_fence to timestamp the end of the frame;
+        // VK_NULL_HANDLE when the frame pacer cannot use GPU timestamps
+        VkCommandBuffer timestamp_cmd;
+        uint32_t timestamp_query;
+        bool timestamp_written;
     };
 
     struct Context {
@@ -49,10 +58,14 @@ class Shell {
         VkPhysicalDevice physical_dev;
         uint32_t game_queue_family;
         uint32_t present_queue_family;
+        // valid only when transfer_queue is not VK_NULL_HANDLE
+        uint32_t transfer_queue_family;
 
         VkDevice dev;
         VkQueue game_queue;
         VkQueue present_queue;
+        // a queue without graphics or compute, when requested and available
+        VkQueue transfer_queue;
 
         std::queue<BackBuffer> back_buffers;
 
@@ -128,16 +141,46 @@ class Shell {
     void create_dev();
     void create_back_buffers();
     void destroy_back_buffers();
+    bool create_pace_timestamps(uint32_t count);
     virtual VkSurfaceKHR create_surface(VkInstance instance) = 0;
     void create_swapchain();
     void destroy_swapchain();
 
     void fake_present();
 
+    // called by acquire_back_buffer
+    void pace_frame(const BackBuffer *buf);
+    bool gpu_done_time(const BackBuffer &buf, std::chrono::steady_clock::time_point now,
+                       std::chrono::steady_clock::time_point &done);
+
+    // called by present_back_buffer
+    void count_frame();
+    void log_frame_stats() const;
+
     Context ctx_;
 
+    // debug report messages are logged by a background thread
+    LogQueue *log_queue_;
+
     const float game_tick_;
     float game_time_;
+
+    std::chrono::steady_clock::time_point pace_deadline_;
+
+    // GPU timestamps of frame ends, for pacing from GPU completion
+    VkQueryPool pace_query_pool_;
+    VkCommandPool pace_cmd_pool_;
+    double pace_timestamp_period_;
+    uint64_t pace_timestamp_mask_;
+    uint64_t pace_last_ticks_;
+    uint64_t pace_wrapped_ticks_;
+    // recent differences between steady_clock and the GPU clock
+    std::array<int64_t, 128> pace_clock_offsets_;
+    uint64_t pace_clock_offset_count_;
+
+    int frame_count_;
+    std::chrono::steady_clock::time_point last_frame_time_;
+    std::vector<float> frame_times_;
 };
 
 #endif  // SHELL_H
@@ -18,67 +18,69 @@
 #include <cmath>
 #include <array>
 #include <glm/gtc/matrix_transform.hpp>
+#include "Frustum.h"
 #include "Simulation.h"
 
-namespace {
-
-class MeshPicker {
-   public:
-    MeshPicker()
-        : pattern_({
-              Meshes::MESH_PYRAMID, Meshes::MESH_ICOSPHERE, Meshes::MESH_TEAPOT, Meshes::MESH_PYRAMID, Meshes::MESH_ICOSPHERE,
-              Meshes::MESH_PYRAMID, Meshes::MESH_PYRAMID, Meshes::MESH_PYRAMID, Meshes::MESH_PYRAMID, Meshes::MESH_PYRAMID,
-          }),
-          cur_(-1) {}
-
-    Meshes::Type pick() {
-        cur_ = (cur_ + 1) % pattern_.size();
-        return pattern_[cur_];
-    }
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAVE_SSE2 1
+#endif
 
-    float scale(Meshes::Type type) const {
-        float base = 0.005f;
-
-        switch (type) {
-            case Meshes::MESH_PYRAMID:
-            default:
-                return base * 1.0f;
-            case Meshes::MESH_ICOSPHERE:
-                return base * 3.0f;
-            case Meshes::MESH_TEAPOT:
-                return base * 10.0f;
-        }
-    }
+namespace {
 
-   private:
-    const std::array<Meshes::Type, 10> pattern_;
-    int cur_;
-};
+static_assert(sizeof(Simulation::FusedRecord) == 64, "FusedRecord must fill exactly one cache line");
+// about 350 bytes on 64-bit hosts, so a million objects take 350 MB of CPU
+// state; keep generators and curves inline and small
+static_assert(sizeof(Simulation::Object) <= 384, "Simulation::Object has grown");
+
+uint32_t pack_unorm8(float val) { return static_cast<uint32_t>(glm::clamp(val, 0.0f, 1.0f) * 255.0f + 0.5f); }
+
+// Write a whole cache line without reading it first.  Partial lines would
+// make write-combining buffers flush early.
+void stream_record(Simulation::FusedRecord *dst, const Simulation::FusedRecord &rec) {
+#ifdef HAVE_SSE2
+    const __m128i *src = reinterpret_cast<const __m128i *>(&rec);
+    __m128i *lines = reinterpret_cast<__m128i *>(dst);
+    _mm_stream_si128(lines + 0, _mm_loadu_si128(src + 0));
+    _mm_stream_si128(lines + 1, _mm_loadu_si128(src + 1));
+    _mm_stream_si128(lines + 2, _mm_loadu_si128(src + 2));
+    _mm_stream_si128(lines + 3, _mm_loadu_si128(src + 3));
+#else
+    *dst = rec;
+#endif
+}
 
 class ColorPicker {
    public:
-    ColorPicker(unsigned int rng_seed) : rng_(rng_seed), red_(0.0f, 1.0f), green_(0.0f, 1.0f), blue_(0.0f, 1.0f) {}
+    ColorPicker(unsigned int rng_seed) : rng_(rng_seed) {}
 
-    glm::vec3 pick() { return glm::vec3{red_(rng_), green_(rng_), blue_(rng_)}; }
+    glm::vec3 pick(const Scene::Group &group) {
+        glm::vec3 color;
+        for (int i = 0; i < 3; i++) color[i] = std::uniform_real_distribution<float>(group.color_min[i], group.color_max[i])(rng_);
+        return color;
+    }
 
    private:
     std::mt19937 rng_;
-    std::uniform_real_distribution<float> red_;
-    std::uniform_real_distribution<float> green_;
-    std::uniform_real_distribution<float> blue_;
 };
 
+// Animation matrices are a uniform scale followed by rotations
+glm::quat rotation(const glm::mat4 &trans, float scale) { return glm::quat_cast(glm::mat3(trans) / scale); }
+
 }  // namespace
 
-Animation::Animation(unsigned int rng_seed, float scale) : rng_(rng_seed), dir_(-1.0f, 1.0f), speed_(0.1f, 1.0f) {
-    float x = dir_(rng_);
-    float y = dir_(rng_);
-    float z = dir_(rng_);
+Animation::Animation(unsigned int rng_seed, float scale, const Scene::Range &speed) {
+    // only the starting point is random
+    Rng rng(rng_seed);
+
+    float x = rng.uniform(-1.0f, 1.0f);
+    float y = rng.uniform(-1.0f, 1.0f);
+    float z = rng.uniform(-1.0f, 1.0f);
     if (std::abs(x) + std::abs(y) + std::abs(z) == 0.0f) x = 1.0f;
 
     current_.axis = glm::normalize(glm::vec3(x, y, z));
 
-    current_.speed = speed_(rng_);
+    current_.speed = rng.uniform(speed);
     current_.scale = scale;
 
     current_.matrix = glm::scale(glm::mat4(1.0f), glm::vec3(current_.scale));
@@ -101,103 +103,58 @@ glm::mat4 Animation::transformation(float t) {
     return current_.matrix;
 }
 
-class Curve {
-   public:
-    virtual ~Curve() {}
-    virtual glm::vec3 evaluate(float t) = 0;
-};
-
-namespace {
-
-enum CurveType {
-    CURVE_RANDOM,
-    CURVE_CIRCLE,
-    CURVE_COUNT,
-};
-
-class RandomCurve : public Curve {
-   public:
-    RandomCurve(unsigned int rng_seed)
-        : rng_(rng_seed),
-          direction_(-0.3f, 0.3f),
-          duration_(1.0f, 5.0f),
-          segment_start_(0.0f),
-          segment_direction_(0.0f),
-          time_start_(0.0f),
-          time_duration_(0.0f) {}
-
-    glm::vec3 evaluate(float t) {
-        if (t >= time_start_ + time_duration_) new_segment(t);
-
-        pos_ += unit_dir_ * (t - last_);
-        last_ = t;
-
-        return pos_;
-    }
-
-   private:
-    void new_segment(float time_start) {
-        segment_start_ += segment_direction_;
-        segment_direction_ = glm::vec3(direction_(rng_), direction_(rng_), direction_(rng_));
+Curve Curve::random() { return Curve(Scene::CURVE_RANDOM); }
 
-        time_start_ = time_start;
-        time_duration_ = duration_(rng_);
+Curve Curve::circle(float radius, const glm::vec3 &axis) {
+    glm::vec3 a;
 
-        unit_dir_ = segment_direction_ / time_duration_;
-        pos_ = segment_start_;
-        last_ = time_start_;
+    if (axis.x != 0.0f) {
+        a.x = -axis.z / axis.x;
+        a.y = 0.0f;
+        a.z = 1.0f;
+    } else if (axis.y != 0.0f) {
+        a.x = 1.0f;
+        a.y = -axis.x / axis.y;
+        a.z = 0.0f;
+    } else {
+        a.x = 1.0f;
+        a.y = 0.0f;
+        a.z = -axis.x / axis.z;
     }
 
-    std::mt19937 rng_;
-    std::uniform_real_distribution<float> direction_;
-    std::uniform_real_distribution<float> duration_;
+    a = glm::normalize(a);
+    const glm::vec3 b = glm::normalize(glm::cross(a, axis));
 
-    glm::vec3 segment_start_;
-    glm::vec3 segment_direction_;
-    float time_start_;
-    float time_duration_;
+    Curve curve(Scene::CURVE_CIRCLE);
+    curve.v0_ = a * radius;
+    curve.v1_ = b * radius;
 
-    glm::vec3 unit_dir_;
-    glm::vec3 pos_;
-    float last_;
-};
-
-class CircleCurve : public Curve {
-   public:
-    CircleCurve(float radius, glm::vec3 axis) : r_(radius) {
-        glm::vec3 a;
-
-        if (axis.x != 0.0f) {
-            a.x = -axis.z / axis.x;
-            a.y = 0.0f;
-            a.z = 1.0f;
-        } else if (axis.y != 0.0f) {
-            a.x = 1.0f;
-            a.y = -axis.x / axis.y;
-            a.z = 0.0f;
-        } else {
-            a.x = 1.0f;
-            a.y = 0.0f;
-            a.z = -axis.x / axis.z;
-        }
-
-        a_ = glm::normalize(a);
-        b_ = glm::normalize(glm::cross(a_, axis));
-    }
+    return curve;
+}
 
-    glm::vec3 evaluate(float t) {
-        return (a_ * (glm::vec3(std::cos(t)) - glm::vec3(1.0f)) + b_ * glm::vec3(std::sin(t))) * glm::vec3(r_);
+glm::vec3 Curve::evaluate(float t, Rng &rng, const Scene::PathParams &params) {
+    switch (type_) {
+        case Scene::CURVE_RANDOM:
+            if (t >= segment_start_ + segment_duration_) {
+                v0_ += v1_;
+                v1_.x = rng.uniform(-params.random_extent, params.random_extent);
+                v1_.y = rng.uniform(-params.random_extent, params.random_extent);
+                v1_.z = rng.uniform(-params.random_extent, params.random_extent);
+
+                segment_start_ = t;
+                segment_duration_ = rng.uniform(params.random_duration);
+            }
+
+            return v0_ + v1_ * ((t - segment_start_) / segment_duration_);
+        case Scene::CURVE_CIRCLE:
+            return v0_ * (std::cos(t) - 1.0f) + v1_ * std::sin(t);
+        default:
+            assert(!"unreachable");
+            return glm::vec3(0.0f);
     }
+}
 
-   private:
-    float r_;
-    glm::vec3 a_;
-    glm::vec3 b_;
-};
-
-}  // namespace
-
-Path::Path(unsigned int rng_seed) : rng_(rng_seed), type_(0, CURVE_COUNT - 1), duration_(5.0f, 20.0f) {
+Path::Path(unsigned int rng_seed, const Scene::PathParams &params) : rng_(rng_seed), params_(&params) {
     // trigger a subpath generation
     current_.end = -1.0f;
     current_.now = 0.0f;
@@ -208,79 +165,210 @@ glm::vec3 Path::position(float t) {
 
     while (current_.now >= current_.end) generate_subpath();
 
-    return current_.origin + current_.curve->evaluate(current_.now - current_.start);
+    return current_.origin + current_.curve.evaluate(current_.now - current_.start, rng_, *params_);
 }
 
 void Path::generate_subpath() {
-    float duration = duration_(rng_);
-    CurveType type = static_cast<CurveType>(type_(rng_));
+    float duration = rng_.uniform(params_->duration);
+
+    float total_weight = 0.0f;
+    for (const auto weight : params_->curve_weights) total_weight += weight;
+    float pick = rng_.uniform(0.0f, total_weight);
 
-    if (current_.curve) {
-        current_.origin += current_.curve->evaluate(current_.end - current_.start);
+    // the last curve with a weight when rounding leaves pick past the end
+    int type = 0;
+    for (int i = 0; i < Scene::CURVE_COUNT; i++) {
+        if (params_->curve_weights[i] <= 0.0f) continue;
+
+        type = i;
+        if (pick < params_->curve_weights[i]) break;
+        pick -= params_->curve_weights[i];
+    }
+
+    if (!current_.curve.empty()) {
+        current_.origin += current_.curve.evaluate(current_.end - current_.start, rng_, *params_);
         current_.origin = glm::mod(current_.origin, glm::vec3(2.0f));
         current_.start = current_.end;
     } else {
-        std::uniform_real_distribution<float> origin(0.0f, 2.0f);
-        current_.origin = glm::vec3(origin(rng_), origin(rng_), origin(rng_));
+        const float x = rng_.uniform(0.0f, 2.0f);
+        const float y = rng_.uniform(0.0f, 2.0f);
+        const float z = rng_.uniform(0.0f, 2.0f);
+        current_.origin = glm::vec3(x, y, z);
         current_.start = current_.now;
     }
 
     current_.end = current_.start + duration;
 
-    Curve *curve;
-
     switch (type) {
-        case CURVE_RANDOM:
-            curve = new RandomCurve(rng_());
+        case Scene::CURVE_RANDOM:
+            current_.curve = Curve::random();
             break;
-        case CURVE_CIRCLE: {
-            std::uniform_real_distribution<float> dir(-1.0f, 1.0f);
-            glm::vec3 axis(dir(rng_), dir(rng_), dir(rng_));
+        case Scene::CURVE_CIRCLE: {
+            const float x = rng_.uniform(-1.0f, 1.0f);
+            const float y = rng_.uniform(-1.0f, 1.0f);
+            const float z = rng_.uniform(-1.0f, 1.0f);
+            glm::vec3 axis(x, y, z);
             if (axis.x == 0.0f && axis.y == 0.0f && axis.z == 0.0f) axis.x = 1.0f;
 
-            std::uniform_real_distribution<float> radius_(0.02f, 0.2f);
-            curve = new CircleCurve(radius_(rng_), axis);
+            current_.curve = Curve::circle(rng_.uniform(params_->circle_radius), axis);
         } break;
         default:
             assert(!"unreachable");
-            curve = nullptr;
             break;
     }
-
-    current_.curve.reset(curve);
 }
 
-Simulation::Simulation(int object_count) : random_dev_() {
-    MeshPicker mesh;
-    ColorPicker color(random_dev_());
+Simulation::Simulation(const Scene &scene)
+    : seed_((scene.has_seed()) ? scene.seed() : std::random_device()()),
+      seed_rng_(seed_),
+      groups_(scene.groups()),
+      interpolate_(false) {
+    ColorPicker color(seed_rng_());
+
+    const int object_count = scene.object_count();
+    const auto &pattern = scene.pattern();
 
     objects_.reserve(object_count);
     for (int i = 0; i < object_count; i++) {
-        Meshes::Type type = mesh.pick();
-        float scale = mesh.scale(type);
+        // Path keeps a pointer to the params in groups_
+        const Scene::Group &group = groups_[pattern[i % pattern.size()]];
+        const float scale = group.scale;
 
         objects_.emplace_back(Object{
-            type, glm::vec3(0.5f + 0.5f * (float)i / object_count), color.pick(), Animation(random_dev_(), scale),
-            Path(random_dev_()),
+            group.mesh, glm::vec3(0.5f + 0.5f * (float)i / object_count), color.pick(group),
+            Animation(seed_rng_(), scale, group.speed), Path(seed_rng_(), group.path),
         });
+
+        // where the object starts, without advancing it
+        auto &obj = objects_.back();
+        obj.transform.position = obj.path.position(0.0f);
+        obj.transform.rotation = rotation(obj.animation.transformation(0.0f), scale);
+        obj.prev_transform = obj.transform;
+        obj.model = glm::translate(glm::mat4(1.0f), obj.transform.position) * obj.animation.transformation(0.0f);
+        obj.lod_interval = 1;
+        obj.lod_pending = 0;
     }
 }
 
-void Simulation::set_frame_data_size(uint32_t size) {
-    uint32_t offset = 0;
-    for (auto &obj : objects_) {
-        obj.frame_data_offset = offset;
-        offset += size;
+glm::mat4 Simulation::interpolated_model(const Object &obj, float t) const {
+    const Transform &prev = obj.prev_transform;
+    const Transform &cur = obj.transform;
+
+    // paths wrap around at the edges of the cube; jump instead of sweeping
+    // across it
+    const glm::vec3 pos = (glm::distance(prev.position, cur.position) > 0.5f) ? cur.position : glm::mix(prev.position, cur.position, t);
+    const glm::quat rot = glm::slerp(prev.rotation, cur.rotation, t);
+
+    return glm::scale(glm::translate(glm::mat4(1.0f), pos) * glm::mat4_cast(rot), glm::vec3(obj.animation.scale()));
+}
+
+void Simulation::bounds(const Object &obj, glm::vec3 &min, glm::vec3 &max) const {
+    const glm::vec3 radius(bounding_radius(obj));
+    const glm::vec3 pos(obj.model[3]);
+
+    min = pos - radius;
+    max = pos + radius;
+
+    // transform is only kept when interpolating; see interpolated_model for
+    // the jumps
+    if (interpolate_ && glm::distance(obj.prev_transform.position, obj.transform.position) <= 0.5f) {
+        min = glm::min(min, obj.prev_transform.position - radius);
+        max = glm::max(max, obj.prev_transform.position + radius);
+    }
+}
+
+void Simulation::set_frame_data_size(uint32_t size, uint32_t objects_per_chunk) {
+    assert(objects_per_chunk > 0 && uint64_t(size) * (objects_per_chunk - 1) <= UINT32_MAX);
+
+    for (size_t i = 0; i < objects_.size(); i++) {
+        auto &obj = objects_[i];
+        obj.frame_data_chunk = static_cast<uint32_t>(i / objects_per_chunk);
+        obj.frame_data_offset = static_cast<uint32_t>(i % objects_per_chunk) * size;
     }
 }
 
-void Simulation::update(float time, int begin, int end) {
+int Simulation::update(float time, int begin, int end) {
+    int updated = 0;
     for (int i = begin; i < end; i++) {
         auto &obj = objects_[i];
 
-        glm::vec3 pos = obj.path.position(time);
-        glm::mat4 trans = obj.animation.transformation(time);
+        // catch up on all skipped ticks at once, so that the object is where
+        // it would have been had it been updated every tick
+        if (++obj.lod_pending < obj.lod_interval) continue;
+        const float pending_time = time * obj.lod_pending;
+
+        glm::vec3 pos = obj.path.position(pending_time);
+        glm::mat4 trans = obj.animation.transformation(pending_time);
         obj.model = glm::translate(glm::mat4(1.0f), pos) * trans;
-        obj.alpha = obj.animation.transparency();
+        for (uint32_t t = 0; t < obj.lod_pending; t++) obj.alpha = obj.animation.transparency();
+        obj.lod_pending = 0;
+        updated++;
+
+        if (interpolate_) {
+            obj.prev_transform = obj.transform;
+            obj.transform.position = pos;
+            obj.transform.rotation = rotation(trans, obj.animation.scale());
+        }
     }
+
+    return updated;
+}
+
+int Simulation::update_lod(const glm::mat4 &view_projection, float pixel_scale, float min_pixels, uint32_t reduced_interval,
+                           int begin, int end) {
+    const Frustum frustum(view_projection);
+    const glm::vec4 row_w(view_projection[0][3], view_projection[1][3], view_projection[2][3], view_projection[3][3]);
+
+    int reduced = 0;
+    for (int i = begin; i < end; i++) {
+        auto &obj = objects_[i];
+
+        const glm::vec4 center(glm::vec3(obj.model[3]), 1.0f);
+        const float radius = bounding_radius(obj);
+
+        bool visible = frustum.intersects_sphere(glm::vec3(center), radius);
+        if (visible) {
+            const float w = glm::dot(row_w, center);
+            visible = (w <= 0.0f || radius * pixel_scale >= min_pixels * w);
+        }
+
+        obj.lod_interval = (visible) ? 1 : reduced_interval;
+        if (!visible) reduced++;
+    }
+
+    return reduced;
+}
+
+void Simulation::update_fused(float time, uint32_t tick_count, int begin, int end, uint8_t *const *chunk_bases, bool fade) {
+    // paths and animations advance by the total time at once; only the alpha
+    // steps once per tick
+    for (int i = begin; i < end; i++) {
+        auto &obj = objects_[i];
+
+        const glm::vec3 pos = obj.path.position(time);
+        const glm::mat4 trans = obj.animation.transformation(time);
+        for (uint32_t t = 0; t < tick_count; t++) obj.alpha = obj.animation.transparency();
+
+        FusedRecord rec;
+        for (int row = 0; row < 3; row++) {
+            rec.model[row][0] = trans[0][row];
+            rec.model[row][1] = trans[1][row];
+            rec.model[row][2] = trans[2][row];
+            rec.model[row][3] = pos[row];
+        }
+        rec.light_pos[0] = obj.light_pos.x;
+        rec.light_pos[1] = obj.light_pos.y;
+        rec.light_pos[2] = obj.light_pos.z;
+        rec.light_color = pack_unorm8(obj.light_color.r) | (pack_unorm8(obj.light_color.g) << 8) |
+                          (pack_unorm8(obj.light_color.b) << 16) | (pack_unorm8(fade ? obj.alpha : 0.5f) << 24);
+
+        uint8_t *dst = chunk_bases[obj.frame_data_chunk] + obj.frame_data_offset;
+        assert(reinterpret_cast<uintptr_t>(dst) % 16 == 0);
+        stream_record(reinterpret_cast<FusedRecord *>(dst), rec);
+    }
+
+#ifdef HAVE_SSE2
+    // streaming stores are weakly ordered
+    _mm_sfence();
+#endif
 }
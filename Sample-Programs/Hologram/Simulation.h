@@ -17,21 +17,54 @@
 #ifndef SIMULATION_H
 #define SIMULATION_H
 
-#include <memory>
+#include <cstdint>
 #include <random>
 #include <vector>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include "Meshes.h"
+#include "Scene.h"
+
+// PCG32 (XSH RR) with a fixed stream.  There is one per object, where an
+// std::mt19937 would take 5000 bytes.
+class Rng {
+   public:
+    explicit Rng(uint64_t seed) : state_(0) {
+        (*this)();
+        state_ += seed;
+        (*this)();
+    }
+
+    uint32_t operator()() {
+        const uint64_t old = state_;
+        state_ = old * 6364136223846793005ULL + 1442695040888963407ULL;
+
+        const uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        const uint32_t rot = static_cast<uint32_t>(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    // uniform in [lo, hi)
+    float uniform(float lo, float hi) { return lo + (hi - lo) * static_cast<float>((*this)() >> 8) * (1.0f / 16777216.0f); }
+    float uniform(const Scene::Range &range) { return uniform(range.min, range.max); }
+
+   private:
+    uint64_t state_;
+};
 
 class Animation {
    public:
-    Animation(unsigned rng_seed, float scale);
+    Animation(unsigned rng_seed, float scale, const Scene::Range &speed);
 
     glm::mat4 transformation(float t);
     float transparency();
 
+    const glm::vec3 &axis() const { return current_.axis; }
+    float speed() const { return current_.speed; }
+    float scale() const { return current_.scale; }
+
    private:
     struct Data {
         glm::vec3 axis;
@@ -44,21 +77,44 @@ class Animation {
         float alpha_inc;
     };
 
-    std::mt19937 rng_;
-    std::uniform_real_distribution<float> dir_;
-    std::uniform_real_distribution<float> speed_;
-
     Data current_;
 };
 
-class Curve;
+// A random or a circle curve of a Path, by value.  Random curves draw their
+// segments from the path's Rng as they are evaluated.
+class Curve {
+   public:
+    Curve() : type_(Scene::CURVE_COUNT), v0_(0.0f), v1_(0.0f), segment_start_(0.0f), segment_duration_(0.0f) {}
+
+    static Curve random();
+    static Curve circle(float radius, const glm::vec3 &axis);
+
+    bool empty() const { return type_ == Scene::CURVE_COUNT; }
+
+    glm::vec3 evaluate(float t, Rng &rng, const Scene::PathParams &params);
+
+   private:
+    explicit Curve(Scene::CurveType type) : Curve() { type_ = type; }
+
+    Scene::CurveType type_;
+    // random: the start and the direction of the current segment
+    // circle: a and b, scaled by the radius
+    glm::vec3 v0_;
+    glm::vec3 v1_;
+    // random only
+    float segment_start_;
+    float segment_duration_;
+};
 
 class Path {
    public:
-    Path(unsigned rng_seed);
+    // params must outlive the path
+    Path(unsigned rng_seed, const Scene::PathParams &params);
 
     glm::vec3 position(float t);
 
+    const Scene::PathParams &params() const { return *params_; }
+
    private:
     struct Subpath {
         glm::vec3 origin;
@@ -66,21 +122,27 @@ class Path {
         float end;
         float now;
 
-        std::shared_ptr<Curve> curve;
+        Curve curve;
     };
 
     void generate_subpath();
 
-    std::mt19937 rng_;
-    std::uniform_int_distribution<> type_;
-    std::uniform_real_distribution<float> duration_;
+    Rng rng_;
+    const Scene::PathParams *params_;
 
     Subpath current_;
 };
 
 class Simulation {
    public:
-    Simulation(int object_count);
+    // the objects are reproducible when scene has a seed
+    explicit Simulation(const Scene &scene);
+
+    // the rigid part of Object::model
+    struct Transform {
+        glm::vec3 position;
+        glm::quat rotation;
+    };
 
     struct Object {
         Meshes::Type mesh;
@@ -90,22 +152,75 @@ class Simulation {
         Animation animation;
         Path path;
 
+        // which frame data buffer holds the object, and where
+        uint32_t frame_data_chunk;
         uint32_t frame_data_offset;
 
         glm::mat4 model;
         float alpha;
+
+        // at the last two ticks, when interpolation is enabled
+        Transform prev_transform;
+        Transform transform;
+
+        // the object is advanced once every lod_interval ticks, by the time of
+        // the lod_pending ticks since its last update
+        uint32_t lod_interval;
+        uint32_t lod_pending;
     };
 
-    const std::vector<Object> &objects() const { return objects_; }
+    // std140 layout of param_block in Hologram.fused.vert; one cache line
+    struct FusedRecord {
+        // rows of the affine model matrix
+        float model[3][4];
+        float light_pos[3];
+        // RGBA8, the light color and alpha
+        uint32_t light_color;
+    };
 
-    unsigned int rng_seed() { return random_dev_(); }
+    const std::vector<Object> &objects() const { return objects_; }
 
-    void set_frame_data_size(uint32_t size);
-    void update(float time, int begin, int end);
+    unsigned int rng_seed() { return seed_rng_(); }
+    // the scene seed, or a random one when the scene has none
+    unsigned int seed() const { return seed_; }
+
+    // keep the transforms of the last two ticks for interpolated_model
+    void set_interpolation(bool enabled) { interpolate_ = enabled; }
+    // the model matrix at t between the last two ticks, where t is in [0, 1]
+    glm::mat4 interpolated_model(const Object &obj, float t) const;
+
+    // the radius of a world space sphere around obj, centered at its
+    // position; the meshes fit in a cube of half extent 1 before scaling
+    static float bounding_radius(const Object &obj) { return 1.74f * obj.animation.scale(); }
+    // world space bounds of obj, covering the last two ticks when
+    // interpolating
+    void bounds(const Object &obj, glm::vec3 &min, glm::vec3 &max) const;
+
+    // objects_per_chunk objects are packed into each frame data buffer
+    void set_frame_data_size(uint32_t size, uint32_t objects_per_chunk);
+    // returns the number of objects that were not skipped by their lod_interval
+    int update(float time, int begin, int end);
+
+    // Pick Object::lod_interval from the visibility of the objects at their
+    // current model matrices.  Objects outside of view_projection, or whose
+    // bounding sphere projects to fewer than min_pixels pixels of radius, are
+    // updated every reduced_interval ticks.  pixel_scale converts radius / w
+    // in clip space to pixels.  Returns the number of reduced objects.
+    int update_lod(const glm::mat4 &view_projection, float pixel_scale, float min_pixels, uint32_t reduced_interval,
+                   int begin, int end);
+
+    // Advance objects by time seconds, over which alpha steps tick_count
+    // times, and write their FusedRecords to chunk_bases[obj.frame_data_chunk]
+    // + obj.frame_data_offset with streaming stores.  Object::model is not
+    // updated.  The objects are drawn with a constant alpha unless fade is set.
+    void update_fused(float time, uint32_t tick_count, int begin, int end, uint8_t *const *chunk_bases, bool fade);
 
    private:
-    std::random_device random_dev_;
+    unsigned int seed_;
+    std::mt19937 seed_rng_;
+    std::vector<Scene::Group> groups_;
     std::vector<Object> objects_;
+    bool interpolate_;
 };
 
 #endif  // SIMULATION_H
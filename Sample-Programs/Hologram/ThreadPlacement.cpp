@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "ThreadPlacement.h"
+
+namespace placement {
+
+std::vector<int> parse_cpu_list(const std::string &list) {
+    std::vector<int> cpus;
+
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+
+        const std::string range = list.substr(pos, end - pos);
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+        if (first < 0 || last < first) throw std::invalid_argument("bad cpu range " + range);
+
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+
+        pos = end + 1;
+    }
+
+    return cpus;
+}
+
+#if defined(__linux__)
+
+bool pin_current_thread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return (sched_setaffinity(0, sizeof(set), &set) == 0);
+}
+
+size_t move_to_local_node(const void *addr, size_t size) {
+#ifdef SYS_move_pages
+    // from numaif.h, which is not always installed
+    const int mpol_mf_move = 1 << 1;
+
+    unsigned cpu, node;
+    if (size == 0 || syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+
+    const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const uintptr_t first = reinterpret_cast<uintptr_t>(addr) & ~(page_size - 1);
+    const uintptr_t last = (reinterpret_cast<uintptr_t>(addr) + size - 1) & ~(page_size - 1);
+    const size_t count = static_cast<size_t>((last - first) / page_size + 1);
+
+    std::vector<void *> pages(count);
+    for (size_t i = 0; i < count; i++) pages[i] = reinterpret_cast<void *>(first + i * page_size);
+    std::vector<int> nodes(count, static_cast<int>(node));
+    std::vector<int> status(count, -1);
+
+    // fails as a whole only for bad arguments; per-page failures are in status
+    if (syscall(SYS_move_pages, 0, count, pages.data(), nodes.data(), status.data(), mpol_mf_move) < 0) return 0;
+
+    size_t local = 0;
+    for (auto st : status) local += (st == static_cast<int>(node));
+
+    return local;
+#else
+    (void)addr;
+    (void)size;
+    return 0;
+#endif
+}
+
+#elif defined(_WIN32)
+
+bool pin_current_thread(int cpu) {
+    // only the first processor group
+    if (cpu < 0 || cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8)) return false;
+
+    return (SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0);
+}
+
+size_t move_to_local_node(const void *addr, size_t size) {
+    (void)addr;
+    (void)size;
+    return 0;
+}
+
+#else
+
+bool pin_current_thread(int cpu) {
+    (void)cpu;
+    return false;
+}
+
+size_t move_to_local_node(const void *addr, size_t size) {
+    (void)addr;
+    (void)size;
+    return 0;
+}
+
+#endif
+
+}  // namespace placement
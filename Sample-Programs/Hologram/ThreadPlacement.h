@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef THREAD_PLACEMENT_H
+#define THREAD_PLACEMENT_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Best-effort control over where threads run and where their data lives.
+// Everything here is a no-op on platforms that do not support it.
+namespace placement {
+
+// parse a list such as "0-3,8,10-11"; throws std::invalid_argument or
+// std::out_of_range when the list is malformed
+std::vector<int> parse_cpu_list(const std::string &list);
+
+// restrict the calling thread to cpu
+bool pin_current_thread(int cpu);
+
+// Move the pages overlapping [addr, addr + size) to the NUMA node the
+// calling thread runs on, as if the thread had touched them first.  Returns
+// the number of pages that are on that node afterwards.  Pages pinned by a
+// driver usually cannot move.
+size_t move_to_local_node(const void *addr, size_t size);
+
+}  // namespace placement
+
+#endif  // THREAD_PLACEMENT_H